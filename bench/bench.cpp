@@ -0,0 +1,82 @@
+#include "bench.h"
+
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+
+#include <cstdio>
+#include <cstring>
+
+using namespace brgb;
+
+namespace brgb::bench {
+
+auto load_rom(const char *file_name) -> std::optional<std::vector<u8>>
+{
+  if(!file_name) return std::vector<u8>(32 * 1024, 0x00);
+
+  auto fd = open(file_name, O_RDONLY);
+  if(fd < 0) return std::nullopt;
+
+  struct stat st;
+  if(fstat(fd, &st) < 0) {
+    close(fd);
+    return std::nullopt;
+  }
+
+  std::vector<u8> rom(st.st_size);
+  if(read(fd, rom.data(), rom.size()) < 0) {
+    close(fd);
+    return std::nullopt;
+  }
+
+  close(fd);
+  return rom;
+}
+
+auto seconds_since(Clock::time_point start) -> double
+{
+  std::chrono::duration<double> elapsed = Clock::now() - start;
+
+  return elapsed.count();
+}
+
+}
+
+struct Benchmark {
+  const char *name;
+  const char *usage;
+
+  int (*fn)(int argc, char *argv[]);
+};
+
+static const Benchmark p_benchmarks[] = {
+  { "runahead", "[rom]", bench::runahead },
+  { "cpu",      "[rom]", bench::cpu },
+  { "turbo",    "[rom]", bench::turbo },
+  { "disasm",   "[rom]", bench::disasm },
+};
+
+static auto usage(const char *argv0) -> int
+{
+  fprintf(stderr, "usage: %s <benchmark> [args...]\n\nbenchmarks:\n", argv0);
+  for(const auto& b : p_benchmarks) {
+    fprintf(stderr, "    %s %s\n", b.name, b.usage);
+  }
+
+  return -1;
+}
+
+int main(int argc, char *argv[])
+{
+  if(argc < 2) return usage(argv[0]);
+
+  for(const auto& b : p_benchmarks) {
+    if(strcmp(argv[1], b.name)) continue;
+
+    return b.fn(argc-2, argv+2);
+  }
+
+  return usage(argv[0]);
+}
@@ -0,0 +1,28 @@
+#pragma once
+
+#include <types.h>
+
+#include <vector>
+#include <string>
+#include <optional>
+#include <chrono>
+
+namespace brgb::bench {
+
+using Clock = std::chrono::steady_clock;
+
+// Returns the contents of the ROM at 'file_name' or, when
+//   'file_name' is nullptr, a blank 32KiB ROM
+auto load_rom(const char *file_name) -> std::optional<std::vector<u8>>;
+
+// Returns the number of seconds elapsed since 'start'
+auto seconds_since(Clock::time_point start) -> double;
+
+// Entry-points of the individual benchmarks
+//   - 'argc' and 'argv' exclude the benchmark's name
+auto runahead(int argc, char *argv[]) -> int;
+auto cpu(int argc, char *argv[]) -> int;
+auto turbo(int argc, char *argv[]) -> int;
+auto disasm(int argc, char *argv[]) -> int;
+
+}
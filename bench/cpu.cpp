@@ -0,0 +1,111 @@
+#include "bench.h"
+
+#include <flat.h>
+
+#include <memory>
+
+#include <cstdio>
+#include <cstring>
+
+namespace brgb::bench {
+
+using Engine = sm83::Processor::Engine;
+
+enum : unsigned {
+  MeasuredInstructions = 50'000'000,
+};
+
+// Loop over a buffer in WRAM mixing loads/stores, ALU ops, branches
+//   and calls, which is run when no ROM is given
+static const u8 p_workload[] = {
+  /* 0x0100 */ 0x31, 0xFE, 0xFF,     // ld sp, 0xFFFE
+  /* 0x0103 */ 0x21, 0x00, 0xC0,     // ld hl, 0xC000
+  /* 0x0106 */ 0x01, 0x00, 0x01,     // ld bc, 0x0100
+  /* 0x0109 */ 0x7E,                 // ld a, (hl)
+  /* 0x010A */ 0x81,                 // add a, c
+  /* 0x010B */ 0xA8,                 // xor b
+  /* 0x010C */ 0x07,                 // rlca
+  /* 0x010D */ 0x22,                 // ld (hl+), a
+  /* 0x010E */ 0x0B,                 // dec bc
+  /* 0x010F */ 0x78,                 // ld a, b
+  /* 0x0110 */ 0xB1,                 // or c
+  /* 0x0111 */ 0x20, 0xF6,           // jr nz, 0x0109
+  /* 0x0113 */ 0xCD, 0x19, 0x01,     // call 0x0119
+  /* 0x0116 */ 0xC3, 0x03, 0x01,     // jp 0x0103
+  /* 0x0119 */ 0xC5,                 // push bc
+  /* 0x011A */ 0xCB, 0x37,           //   swap a
+  /* 0x011C */ 0xC1,                 // pop bc
+  /* 0x011D */ 0xC9,                 // ret
+};
+
+// Measures the instructions per second reached by each
+//   sm83::Processor::Engine on a FlatProcessor
+auto cpu(int argc, char *argv[]) -> int
+{
+  std::vector<u8> program(p_workload, p_workload + sizeof(p_workload));
+  unsigned load_addr = 0x0100;
+
+  if(argc > 0) {
+    auto rom = load_rom(argv[0]);
+    if(!rom) {
+      fprintf(stderr, "couldn't load ROM `%s'!\n", argv[0]);
+      return -1;
+    }
+
+    program = std::move(*rom);
+    program.resize(std::min<size_t>(program.size(), 0x8000));
+
+    load_addr = 0x0000;
+  }
+
+  struct Config {
+    const char *name;
+
+    Engine engine;
+    unsigned slice;
+  };
+
+  static const Config configs[] = {
+    { "table/1",     Engine::Table,    1  },
+    { "table/64",    Engine::Table,    64 },
+    { "threaded/1",  Engine::Threaded, 1  },
+    { "threaded/64", Engine::Threaded, 64 },
+    { "cached/1",    Engine::Cached,   1  },
+    { "cached/64",   Engine::Cached,   64 },
+    { "jit/1",       Engine::Jit,      1  },
+    { "jit/64",      Engine::Jit,      64 },
+  };
+
+  printf("%-12s %14s %10s\n", "engine/slice", "instructions/s", "cycles/s");
+
+  for(const auto& config : configs) {
+    auto cpu = std::make_unique<tools::FlatProcessor>();
+
+    memcpy(cpu->memory().data() + load_addr, program.data(), program.size());
+
+    sm83::Processor::State s = { };
+    s.sp = 0xFFFE; s.pc = 0x0100;
+
+    cpu->power();
+    cpu->loadState(s);
+    cpu->engine(config.engine);
+
+    unsigned long long executed = 0;
+
+    auto start = Clock::now();
+    while(executed < MeasuredInstructions) {
+      executed += cpu->execute(config.slice);
+
+      if(cpu->runState() != sm83::Processor::RunState::Running) break;
+    }
+
+    double elapsed = seconds_since(start);
+
+    printf("%-12s %13.1fM %9.1fM\n", config.name,
+        executed / elapsed / 1e6, cpu->cycles()*4 / elapsed / 1e6);
+  }
+
+  return 0;
+}
+
+}
@@ -0,0 +1,361 @@
+#include "bench.h"
+
+#include <device/sm83/disassembler.h>
+#include <device/sm83/disasmcache.h>
+#include <device/sm83/opcodes.h>
+
+#include <flat.h>
+
+#include <exception>
+#include <memory>
+
+#include <cstdio>
+#include <cstring>
+
+namespace brgb::bench {
+
+enum : unsigned {
+  MeasuredInstructions = 20'000'000,
+
+  // Minimum size of the disassembled program
+  ProgramSize = 32 * 1024,
+
+  // Size of the random ROM swept when one isn't given
+  SweepSize = 1024 * 1024,
+
+  // Lines of disassembly shown by a (simulated) debugger
+  //   pane, which get refreshed every frame
+  PaneLines  = 32,
+  PaneFrames = 500'000,
+};
+
+// Every opcode the disassembler accepts (with arbitrary
+//   operands), repeated to fill at least ProgramSize bytes
+struct Program {
+  std::vector<u8> code;
+  unsigned num_instructions = 0;
+};
+
+static auto synthetic_program() -> Program
+{
+  Program program;
+
+  u8 operand = 0x5A;
+  while(program.code.size() < ProgramSize) {
+    for(unsigned op = 0; op < 0x100; op++) {
+      const auto& info = sm83::opcode_info(op);
+      if(info.mnemonic == sm83::Mnemonic::Invalid || info.is(sm83::OpPrefix)) continue;
+
+      program.code.push_back(op);
+      for(unsigned i = 1; i < info.length; i++) program.code.push_back(operand++);
+
+      program.num_instructions++;
+    }
+
+    for(unsigned op = 0; op < 0x100; op++) {
+      program.code.push_back(sm83disasm::Instruction::CB_prefix);
+      program.code.push_back(op);
+
+      program.num_instructions++;
+    }
+  }
+
+  return program;
+}
+
+// Disassembles the whole 'program' over and over, until at least
+//   MeasuredInstructions were, and returns the instructions/s
+//   - 'step' returns the length of the line it disassembled
+template <typename Fn>
+static auto measure(Program& program, Fn step) -> double
+{
+  sm83disasm::Disassembler disasm;
+
+  unsigned long long disassembled = 0;
+  size_t total_length = 0;
+
+  auto start = Clock::now();
+  while(disassembled < MeasuredInstructions) {
+    disasm.begin(program.code.data());
+
+    for(unsigned i = 0; i < program.num_instructions; i++) total_length += step(disasm);
+
+    disassembled += program.num_instructions;
+  }
+
+  double elapsed = seconds_since(start);
+
+  // Keeps the lines from getting optimized out
+  if(!total_length) printf("no output?!\n");
+
+  return disassembled / elapsed;
+}
+
+// Sweeps over all of 'rom' linearly, over and over until at least
+//   MeasuredInstructions were decoded, and returns the decoded
+//   instructions (or 'db' bytes) per second
+//   - 'step' decodes the instruction at 'ptr' and advances it
+template <typename Fn>
+static auto sweep(std::vector<u8>& rom, Fn step) -> double
+{
+  // Decoding (with disassemble()) can read a couple bytes past the end
+  auto size = rom.size();
+  rom.resize(size + sm83disasm::Instruction::MaxLength);
+
+  unsigned long long decoded = 0;
+  size_t checksum = 0;
+
+  auto start = Clock::now();
+  while(decoded < MeasuredInstructions) {
+    u8 *ptr = rom.data(), *end = rom.data() + size;
+
+    sm83disasm::Instruction instruction(rom.data());
+    while(ptr < end) {
+      checksum += step(instruction, ptr, end);
+      decoded++;
+    }
+  }
+
+  double elapsed = seconds_since(start);
+
+  rom.resize(size);
+
+  if(!checksum) printf("no output?!\n");
+
+  return decoded / elapsed;
+}
+
+// Refreshes a debugger pane showing PaneLines instructions from 'pc'
+//   (which moves around a little, like when stepping through a loop)
+//   PaneFrames times and returns the frames per second
+//   - 'refresh' returns a checksum of the pane's lines
+template <typename Fn>
+static auto pane(u16 pc, Fn refresh) -> double
+{
+  size_t checksum = 0;
+
+  auto start = Clock::now();
+  for(unsigned frame = 0; frame < PaneFrames; frame++) {
+    checksum += refresh((u16)(pc + (frame & 7)));
+  }
+
+  double elapsed = seconds_since(start);
+
+  if(!checksum) printf("no output?!\n");
+
+  return PaneFrames / elapsed;
+}
+
+// Compares redisassembling the pane's lines on every frame with
+//   getting them from a DisasmCache, for code in ROM and in RAM
+//   - The code in RAM gets modified by a FlatProcessor, which
+//     executes a loop incrementing a byte shown in the pane
+//     before every frame - so the writes reach the DisasmCache
+//     through Processor::codeWritten(), like they would in
+//     a debugger, and one instruction gets invalidated
+static auto pane_benchmarks(const Program& program) -> void
+{
+  using sm83disasm::DisasmCache;
+  using sm83disasm::Instruction;
+
+  enum : u16 {
+    RomPc = 0x0150,
+    RamPc = 0xC150,
+
+    // Incremented by the loop
+    RamTarget = RamPc + 0x20,
+  };
+
+  // Executed before every frame of the pane in RAM, one
+  //   iteration of the loop below (i.e. a single write)
+  static constexpr unsigned FrameInstructions = 2;
+
+  static const u8 RamLoop[] = {
+    0x21, RamTarget & 0xFF, RamTarget >> 8,   // ld hl, RamTarget
+    0x34,                                     // inc (hl)
+    0x18, 0xFD,                               // jr <inc (hl)>
+  };
+
+  // The program in ROM (0x0000-0x7FFF) and WRAM (0xC000-0xDFFF),
+  //   with the loop at the start of the pane in WRAM
+  auto cpu = std::make_unique<tools::FlatProcessor>();
+  auto& memory = cpu->memory();
+
+  std::copy_n(program.code.begin(), std::min<size_t>(program.code.size(), 0x8000), memory.begin());
+  std::copy_n(program.code.begin(), 0x2000, memory.begin() + 0xC000);
+  std::copy_n(RamLoop, sizeof(RamLoop), memory.begin() + RamPc);
+
+  sm83::Processor::State state = { };
+  state.sp = 0xFFFE; state.pc = RamPc;
+
+  cpu->power();
+  cpu->loadState(state);
+
+  // Disassembles the line at 'addr' into 'text' and returns
+  //   the length of the instruction
+  auto line = [&](u16 addr, char *text) -> unsigned {
+    u8 bytes[Instruction::MaxLength];
+    for(unsigned i = 0; i < Instruction::MaxLength; i++) bytes[i] = memory[(u16)(addr + i)];
+
+    Instruction instruction(bytes, addr);
+
+    u8 *ptr = bytes;
+    instruction.decode(ptr, bytes + Instruction::MaxLength);
+    instruction.format(text, DisasmCache::MaxTextLength);
+
+    return ptr - bytes;
+  };
+
+  auto scratch = [&](u16 pc) -> size_t {
+    char text[DisasmCache::MaxTextLength];
+    size_t checksum = 0;
+
+    u16 addr = pc;
+    for(unsigned i = 0; i < PaneLines; i++) {
+      addr += line(addr, text);
+      checksum += text[0];
+    }
+
+    return checksum;
+  };
+
+  // The FlatProcessor's memory is all RAM, so the bank
+  //   of the ROM has to be set apart for the benchmark
+  DisasmCache rom_cache;
+  rom_cache.attach(
+      [](u16 addr) -> u32 { return addr < 0x8000 ? DisasmCache::ReadOnly | 1 : 0; },
+      [&](u16 addr) -> u8 { return memory[addr]; }
+  );
+
+  DisasmCache ram_cache;
+  cpu->disasmCache(&ram_cache);
+
+  const DisasmCache::Entry *entries[PaneLines];
+
+  auto cached = [&](DisasmCache& cache) {
+    return [&](u16 pc) -> size_t {
+      cache.window(pc, PaneLines, entries);
+
+      return entries[PaneLines-1]->length + entries[0]->text[0];
+    };
+  };
+
+  auto executed = [&](auto refresh) {
+    return [&, refresh](u16 pc) -> size_t {
+      cpu->execute(FrameInstructions);
+
+      return refresh(pc);
+    };
+  };
+
+  auto rom_scratch_fps = pane(RomPc, scratch);
+  auto rom_cached_fps = pane(RomPc, cached(rom_cache));
+
+  auto ram_scratch_fps = pane(RamPc, executed(scratch));
+  auto ram_cached_fps = pane(RamPc, executed(cached(ram_cache)));
+
+  // Whatever the loop did to the pane must've been noticed
+  bool coherent = true;
+  for(u16 pc = RamPc; pc < RamPc + 8; pc++) {
+    ram_cache.window(pc, PaneLines, entries);
+
+    for(unsigned i = 0; i < PaneLines; i++) {
+      char text[DisasmCache::MaxTextLength];
+      line(entries[i]->addr, text);
+
+      coherent = coherent && !strcmp(entries[i]->text, text);
+    }
+  }
+
+  printf("\n%-10s %14s %14s  (%u line pane)\n", "pane", "scratch", "cached", PaneLines);
+  printf("%-10s %13.0fk %13.0fk frames/s\n", "rom", rom_scratch_fps / 1e3, rom_cached_fps / 1e3);
+  printf("%-10s %13.0fk %13.0fk frames/s  (%u instructions executed per frame)\n", "ram",
+      ram_scratch_fps / 1e3, ram_cached_fps / 1e3, FrameInstructions);
+  printf("%-10s %14s %13.1f%%  (%zu instructions cached)\n", "", "ram hit rate",
+      100.0 * ram_cache.hits() / (ram_cache.hits() + ram_cache.misses()), ram_cache.size());
+
+  if(!coherent) printf("the cached pane doesn't match the memory?!\n");
+
+  cpu->disasmCache(nullptr);
+}
+
+// Compares the instructions per second reached by the std::string
+//   and the caller-provided buffer Disassembler::singleStep(), then
+//   the frames per second of a debugger pane with and without a
+//   DisasmCache (see pane_benchmarks())
+//  - Finally sweeps a ROM which mixes code and data (random bytes,
+//    4% of which aren't opcodes, when one isn't given) linearly
+//    with the throwing and the status returning decoding
+auto disasm(int argc, char *argv[]) -> int
+{
+  using sm83disasm::Instruction;
+
+  auto program = synthetic_program();
+
+  auto string_ips = measure(program, [](sm83disasm::Disassembler& disasm) {
+    return disasm.singleStep().size();
+  });
+
+  auto buffer_ips = measure(program, [](sm83disasm::Disassembler& disasm) {
+    char line[sm83disasm::Disassembler::MaxLineLength];
+
+    return disasm.singleStep(line, sizeof(line));
+  });
+
+  printf("%-10s %14s\n", "output", "instructions/s");
+  printf("%-10s %13.1fM\n", "string", string_ips / 1e6);
+  printf("%-10s %13.1fM\n", "buffer", buffer_ips / 1e6);
+
+  pane_benchmarks(program);
+
+  std::vector<u8> rom(SweepSize);
+  if(argc > 0) {
+    auto loaded = load_rom(argv[0]);
+    if(!loaded) {
+      fprintf(stderr, "couldn't load ROM `%s'!\n", argv[0]);
+      return -1;
+    }
+
+    rom = std::move(*loaded);
+  } else {
+    u32 seed = 1;
+    for(auto& b : rom) {
+      seed = seed*1103515245 + 12345;
+      b = seed >> 16;
+    }
+  }
+
+  if(rom.empty()) return 0;
+
+  // How the data got skipped over before decode() existed
+  auto exceptions_ips = sweep(rom, [](Instruction& instruction, u8 *& ptr, u8 *) -> size_t {
+    try {
+      ptr = instruction.disassemble(ptr);
+    } catch(const std::exception&) {
+      ptr++;
+    }
+
+    return 1;
+  });
+
+  auto status_ips = sweep(rom, [](Instruction& instruction, u8 *& ptr, u8 *end) -> size_t {
+    return instruction.decode(ptr, end) + 1;
+  });
+
+  auto format_ips = sweep(rom, [](Instruction& instruction, u8 *& ptr, u8 *end) -> size_t {
+    char text[sm83disasm::Disassembler::MaxLineLength];
+
+    instruction.decode(ptr, end);
+
+    return instruction.format(text, sizeof(text));
+  });
+
+  printf("\n%-10s %14s  (linear sweep of %zuKiB)\n", "decode", "instructions/s", rom.size() / 1024);
+  printf("%-10s %13.1fM\n", "exceptions", exceptions_ips / 1e6);
+  printf("%-10s %13.1fM\n", "status", status_ips / 1e6);
+  printf("%-10s %13.1fM\n", "+format", format_ips / 1e6);
+
+  return 0;
+}
+
+}
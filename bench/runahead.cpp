@@ -0,0 +1,51 @@
+#include "bench.h"
+
+#include <system/gb/gb.h>
+
+#include <cstdio>
+
+namespace brgb::bench {
+
+enum : unsigned {
+  WarmupFrames   = 60,
+  MeasuredFrames = 600,
+};
+
+// Measures the cost of Gameboy::runAhead() in terms of the
+//   frames per second the emulation is able to reach
+auto runahead(int argc, char *argv[]) -> int
+{
+  auto rom = load_rom(argc > 0 ? argv[0] : nullptr);
+  if(!rom) {
+    fprintf(stderr, "couldn't load ROM `%s'!\n", argv[0]);
+    return -1;
+  }
+
+  Gameboy gb;
+
+  gb
+    .loadCartridge(*rom)
+    .init()
+    .power();
+
+  for(unsigned i = 0; i < WarmupFrames; i++) gb.runFrame();
+
+  printf("%-10s %12s %10s\n", "run-ahead", "frames/s", "overhead");
+
+  double baseline_fps = 0.0;
+  for(unsigned run_ahead : { 0, 1, 2, 3 }) {
+    gb.runAhead(run_ahead);
+
+    auto start = Clock::now();
+    for(unsigned i = 0; i < MeasuredFrames; i++) gb.runFrame();
+
+    double fps = MeasuredFrames / seconds_since(start);
+    if(!run_ahead) baseline_fps = fps;
+
+    printf("%-10u %12.1f %9.1f%%\n", run_ahead, fps, (baseline_fps/fps - 1.0) * 100.0);
+  }
+
+  return 0;
+}
+
+}
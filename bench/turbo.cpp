@@ -0,0 +1,90 @@
+#include "bench.h"
+
+#include <system/gb/gb.h>
+#include <system/gb/governor.h>
+
+#include <cstdio>
+
+namespace brgb::bench {
+
+enum : unsigned {
+  WarmupFrames   = 60,
+  MeasuredFrames = 1200,
+};
+
+using Engine = sm83::Processor::Engine;
+
+// Measures the emulated speed reached in the Governor's
+//   Unlimited mode, with and without skipping frames,
+//   for each of the CPU's execution engines
+auto turbo(int argc, char *argv[]) -> int
+{
+  auto rom = load_rom(argc > 0 ? argv[0] : nullptr);
+  if(!rom) {
+    fprintf(stderr, "couldn't load ROM `%s'!\n", argv[0]);
+    return -1;
+  }
+
+  Gameboy gb;
+
+  gb
+    .loadCartridge(*rom)
+    .init()
+    .power();
+
+  struct Config {
+    const char *name;
+
+    Engine engine;
+    bool frameskip;
+  };
+
+  static const Config configs[] = {
+    { "table",    Engine::Table,    false },
+    { "table",    Engine::Table,    true  },
+    { "threaded", Engine::Threaded, false },
+    { "threaded", Engine::Threaded, true  },
+    { "cached",   Engine::Cached,   false },
+    { "cached",   Engine::Cached,   true  },
+    { "jit",      Engine::Jit,      false },
+    { "jit",      Engine::Jit,      true  },
+  };
+
+  printf("%-10s %-10s %12s %10s %10s %10s\n", "engine", "frameskip", "frames/s", "speed", "rendered", "idle skip");
+
+  for(const auto& config : configs) {
+    bool frameskip = config.frameskip;
+
+    gb.cpuEngine(config.engine);
+    for(unsigned i = 0; i < WarmupFrames; i++) gb.runFrame();
+
+    Governor governor;
+    governor.mode(Governor::Unlimited);
+
+    unsigned rendered = 0;
+    auto skipped = gb.cpuSkippedCycles();
+
+    auto start = Clock::now();
+    for(unsigned i = 0; i < MeasuredFrames; i++) {
+      bool render = !frameskip || governor.beginFrame();
+
+      gb.runFrame(render);
+      if(frameskip) governor.endFrame();
+
+      rendered += render;
+    }
+
+    double fps = MeasuredFrames / seconds_since(start);
+
+    // Share of the CPU's cycles fast-forwarded through idle loops
+    skipped = gb.cpuSkippedCycles() - skipped;
+    double idle = skipped * 100.0 / ((double)MeasuredFrames * gb::PPU::DotsPerFrame);
+
+    printf("%-10s %-10s %12.1f %9.0f%% %10u %9.0f%%\n", config.name, frameskip ? "on" : "off",
+        fps, fps / Governor::FrameRate * 100.0, rendered, idle);
+  }
+
+  return 0;
+}
+
+}
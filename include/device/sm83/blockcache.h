@@ -0,0 +1,126 @@
+#pragma once
+
+#include <types.h>
+
+#include <device/sm83/registers.h>
+
+#include <memory>
+#include <array>
+#include <vector>
+#include <unordered_map>
+
+namespace brgb::sm83 {
+
+class Processor;
+
+// Cache of predecoded basic blocks (straight-line runs of
+//   instructions ending at the first branch), keyed by the
+//   memory bank and address they start at
+//  - Blocks read from writable memory are tracked per page
+//    (256 bytes), so they can be dropped when written to
+class BlockCache {
+public:
+  using Handler = auto (Processor::*)(Registers& rf) -> void;
+
+  // Recompiled Block (see Processor::Engine::Jit), which executes
+  //   at most 'left' instructions and returns how many are left
+  using NativeFn = auto (*)(Processor *p, Registers *rf, unsigned left) -> unsigned;
+
+  enum : unsigned {
+    // Blocks are cut off after this many instructions
+    MaxBlockOps = 32,
+
+    PageShift = 8,
+    NumPages  = 0x10000 >> PageShift,
+  };
+
+  struct Op {
+    Handler handler;
+
+    // The first byte of the instruction and it's length
+    u8 opcode, length;
+
+    // Number of opcode bytes (memory cycles spent fetching
+    //   them), which is 2 for 0xCB-prefixed instructions
+    u8 fetches;
+
+    // Memory cycles spent by the Block's preceding instructions,
+    //   which are exact as only the last one can branch
+    u8 start_cycle;
+
+    // The instruction's immediate operands (if it has any)
+    u8 operands[2];
+  };
+
+  struct Block {
+    u32 bank;
+    u16 pc;
+
+    // Number of bytes the Block's instructions take up
+    u16 size;
+
+    std::vector<Op> ops;
+
+    // Number of times the Block was entered - used to
+    //   find the ones worth recompiling
+    unsigned hits;
+
+    // nullptr until the Block gets recompiled
+    NativeFn native;
+  };
+
+  BlockCache();
+
+  // Returns nullptr when there's no Block starting at 'pc' in 'bank'
+  auto lookup(u32 bank, u16 pc) -> Block *;
+
+  // Adds 'block' to the cache, when 'writable' == true it will
+  //   be dropped by any invalidate() of one of it's bytes
+  auto insert(std::unique_ptr<Block> block, bool writable) -> Block *;
+
+  // Returns 'true' when the page containing 'addr' has any
+  //   writable Blocks overlapping it - meant to be a cheap
+  //   check done before invalidate()
+  inline auto watched(u16 addr) const -> bool
+  {
+    return !pages_[addr >> PageShift].empty();
+  }
+
+  // Drops all the writable Blocks containing 'addr' and
+  //   returns 'true' if there were any
+  auto invalidate(u16 addr) -> bool;
+
+  // Drops all of the Blocks
+  auto clear() -> void;
+
+  // Returns the number of cached Blocks
+  auto size() const -> size_t;
+
+private:
+  static auto key(u32 bank, u16 pc) -> u64;
+
+  // Calls 'fn' with the 'pages_' entry of every
+  //   page 'block' overlaps
+  template <typename Fn>
+  auto eachPage(const Block *block, Fn fn) -> void;
+
+  // Removes 'block' from 'blocks_', 'recent_' and 'pages_'
+  //   and retires it to 'dropped_'
+  auto drop(Block *block) -> void;
+
+  std::unordered_map<u64, std::unique_ptr<Block>> blocks_;
+
+  // The most recently used Block for every address, which
+  //   spares the hashing when the bank doesn't change
+  std::vector<Block *> recent_;
+
+  // Writable Blocks overlapping each page
+  std::array<std::vector<Block *>, NumPages> pages_;
+
+  // Blocks are dropped from within the writes of a Block
+  //   (possibly the same one) which is still executing, so
+  //   they're only freed by the next insert() or clear()
+  std::vector<std::unique_ptr<Block>> dropped_;
+};
+
+}
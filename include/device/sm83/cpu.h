@@ -6,8 +6,17 @@
 
 #include <device/sm83/registers.h>
 #include <device/sm83/instruction.h>
+#include <device/sm83/blockcache.h>
+#include <device/sm83/jit.h>
+#include <device/sm83/profiler.h>
+#include <device/sm83/trace.h>
+#include <device/sm83/disasmcache.h>
+#include <util/compiler.h>
 
 #include <memory>
+#include <array>
+#include <bitset>
+#include <utility>
 
 namespace brgb::sm83 {
 
@@ -15,6 +24,69 @@ class Processor : public IBusDevice, public ISchedDevice {
 public:
   using ProcessorBus = Bus<16>;
 
+  enum class RunState : u8 {
+    Running,
+    Halted,    // After 'halt' - until an interrupt is requested
+    HaltBug,   // After 'halt' with IME == 0 and an interrupt already
+               //   requested, which doesn't halt - instead the next
+               //   opcode is fetched without incrementing PC
+    Stopped,   // After 'stop' - until resume()
+    Locked,    // After an illegal opcode - for good
+  };
+
+  enum class Engine : u8 {
+    // Dispatches each instruction through OpTable
+    Table,
+
+    // Threads the instruction handlers together with computed
+    //   goto's (GCC's labels-as-values) and keeps the registers
+    //   in locals for the duration of an execute() call
+    //  - Considerably faster when executing many instructions
+    //    per call, as 'r' is written back only at the end
+    Threaded,
+
+    // Executes predecoded basic blocks from a BlockCache, which
+    //   spares re-reading and re-decoding the opcodes/operands
+    //  - Requires the memoryBank() and peek() hooks, without
+    //    them it falls back to the same dispatch as Table
+    Cached,
+
+    // Recompiles the hot Blocks of Cached into x86-64 code,
+    //   which calls the instruction handlers directly (or does
+    //   their work inline for the simplest ones) - all other
+    //   Blocks are executed like in Cached
+    //  - Only available when BRGB_SM83_JIT is defined,
+    //    otherwise it's the same as Cached
+    Jit,
+  };
+
+  enum : u32 {
+    // Returned by memoryBank() for memory which code must
+    //   never be cached from (its contents can change without
+    //   the Processor writing to it, ex. I/O registers)
+    Uncacheable = ~0u,
+
+    // Set in memoryBank()'s return value for memory which
+    //   can't be modified by writes (ex. ROM)
+    ReadOnly = 1u<<31,
+  };
+
+  enum : unsigned {
+    NumInterrupts = 5,
+
+    // Returned by interrupt() when no interrupt was dispatched
+    NoInterrupt = ~0u,
+  };
+
+  // Plain data snapshot of the Processor's registers
+  struct State {
+    u16 af, bc, de, hl;
+    u16 sp, pc;
+
+    u8 ime, ei_delay;
+    RunState run_state;
+  };
+
   auto connect(SystemBus *sys_bus) -> void;
 
   auto bus() -> ProcessorBus&;
@@ -27,41 +99,456 @@ public:
   virtual auto power() -> void;
   virtual auto main() -> void = 0;
 
+  auto saveState(State& state) -> void;
+  auto loadState(const State& state) -> void;
+
+  auto runState() const -> RunState;
+
+  // Sets the interrupt lines (bit N = interrupt N, where 0 has the
+  //   highest priority) which are both requested and enabled i.e.
+  //   IF & IE, must be called whenever either of them changes
+  auto interruptLines(u8 lines) -> Processor&;
+
+  // Wakes the Processor up from STOP (when it's RunState::Stopped),
+  //   what does so is up to the system - on the Game Boy it's
+  //   a button press (see gb::Joypad)
+  auto resume() -> Processor&;
+
+  // Selects the implementation used by execute()
+  auto engine() const -> Engine;
+  auto engine(Engine e) -> Processor&;
+
+  // Drops all of the cached Blocks (see Engine::Cached)
+  //   - Must be called whenever cacheable memory gets modified
+  //     behind the Processor's back, ex. by loading a save state
+  auto flushBlocks() -> void;
+
+  // Attaches a Profiler, which from then on gets fed every
+  //   instruction executed (nullptr detaches it)
+  //  - While attached all engines execute like Engine::Table
+  //  - Detached (the default) it doesn't cost anything
+  auto profiler(Profiler *profiler) -> Processor&;
+  auto profiler() const -> Profiler *;
+
+  // Attaches a TraceWriter, which from then on gets a TraceRecord
+  //   of every instruction executed (nullptr detaches it)
+  //  - Just like with a Profiler, all engines execute like
+  //    Engine::Table while it's attached
+  auto tracer(TraceWriter *tracer) -> Processor&;
+  auto tracer() const -> TraceWriter *;
+
+  // Attaches a DisasmCache (nullptr detaches it), which gets filled
+  //   through memoryBank() and peek() - so the same requirements
+  //   as for Engine::Cached apply - and gets every codeWritten()
+  //  - loadState() and flushBlocks() clear it as well
+  auto disasmCache(sm83disasm::DisasmCache *cache) -> Processor&;
+  auto disasmCache() const -> sm83disasm::DisasmCache *;
+
+  // Breakpoints stop execute() right before the instruction at 'addr'
+  //   (in whichever memory bank) would be executed, which is then
+  //   reported by breakpointHit() - calling execute() again
+  //   resumes with that instruction
+  //  - Blocks (see Engine::Cached) are cut short of breakpoints,
+  //    which only get checked outside of them, so with none set
+  //    there's no overhead at all - Table and Threaded have no
+  //    Blocks, so they execute like while a Profiler is attached
+  //    whenever any breakpoints are set
+  auto addBreakpoint(u16 addr) -> Processor&;
+  auto removeBreakpoint(u16 addr) -> Processor&;
+  auto clearBreakpoints() -> Processor&;
+
+  // Returns 'true' when the last execute() stopped at a breakpoint
+  auto breakpointHit() const -> bool;
+
+  // Returns the number of memory cycles (4 t-cycles each)
+  //   spent since power()
+  auto cycles() const -> u64;
+
+  // Returns the number of write()s made since power()
+  auto writes() const -> u64;
+
 protected:
-  virtual auto read(u16 addr) -> u8 = 0;
-  virtual auto write(u16 addr, u8 data) -> void = 0;
+  // Called by read() and write() for memory which isn't mapped
+  //   with mapReadPage()/mapWritePage() (ex. I/O registers)
+  //  - The memory cycle itself is accounted for by the caller
+  virtual auto busRead(u16 addr) -> u8 = 0;
+  virtual auto busWrite(u16 addr, u8 data) -> void = 0;
+
+  // Make read()s and write()s of the 256 byte 'page' (i.e. the
+  //   addresses page<<8 - page<<8 | 0xFF) go straight to 'data',
+  //   bypassing busRead()/busWrite() and with them any indirect
+  //   calls - meant for plain memory like ROM or RAM
+  //  - nullptr unmaps the page
+  //  - Directly mapped writes call codeWritten() by themselves
+  auto mapReadPage(u8 page, const u8 *data) -> void;
+  auto mapWritePage(u8 page, u8 *data) -> void;
+
+  // Every memory access takes a single memory cycle, which
+  //   the Processor only counts in cycles() - it's up to the
+  //   system to advance it's clock accordingly
+  auto read(u16 addr) -> u8;
+  auto write(u16 addr, u8 data) -> void;
+
+  // Called for every memory cycle during which
+  //   the Processor doesn't access the bus
+  auto idle() -> void;
 
+  // Equivalent to 'cycles' consecutive idle() calls
+  auto stall(unsigned cycles) -> void;
+
+  // Block cache hooks, the defaults make all memory Uncacheable
+  //   - memoryBank() returns an identifier of the memory mapped
+  //     at 'addr' (ex. the ROM bank), which together with the
+  //     address is what Blocks are keyed by
+  //   - peek() must return the byte at 'addr' without any side
+  //     effects and without spending any cycles
+  virtual auto memoryBank(u16 addr) -> u32;
+  virtual auto peek(u16 addr) -> u8;
+
+  // Write hooks for the block cache, which busWrite() must call
+  //   when memoryBank() doesn't return Uncacheable
+  //  - codeWritten() for every write which could've modified
+  //    (cacheable) memory, with the address it ended up at
+  //  - codeRemapped() whenever the memory mapped anywhere
+  //    changes (ex. on bank switches)
+  auto codeWritten(u16 addr) -> void;
+  auto codeRemapped() -> void;
+
+  // Fetch, decode and execute a single instruction
+  //   - When the Processor isn't RunState::Running a
+  //     single idle() memory cycle is spent instead
   auto instruction() -> void;
 
-  // ops.cpp
+  // Execute (at most) 'instructions' instructions with the
+  //   selected engine() and return how many were executed
+  //  - Returns early, right after an instruction which changed
+  //    the RunState, IME or interruptPending() (i.e. at the points
+  //    where interrupts have to be checked), so all engines stop
+  //    at exactly the same instructions
+  //  - No instruction but the first one gets started once the
+  //    cycles() go past 'until', which lets the caller run up
+  //    to a point in time instead of counting instructions
+  //  - A Processor which isn't RunState::Running spends a single
+  //    idle() memory cycle instead, which counts as 1 instruction
+  auto execute(unsigned instructions, u64 until = ~0ull) -> unsigned;
+
+  // Returns the address of the next instruction
+  //   to be executed
+  auto pc() const -> u16;
+
+  // Returns the address of the last instruction executed by
+  //   execute(), ex. the branch a slice of instructions ended on
+  auto lastPc() const -> u16;
+
+  // Returns 'true' when interrupt() has to be called before
+  //   the next instruction, which is kept up to date as the
+  //   interruptLines(), IME and the RunState change
+  //  - Meant to be the only check made for interrupts
+  //    in-between execute() calls
+  auto interruptPending() const -> bool;
+
+  // Wakes the Processor up from HALT and, when IME is set, dispatches
+  //   the highest priority interrupt - returns it's number, which
+  //   the caller must then acknowledge (clear in IF), or NoInterrupt
+  //  - Must only be called when interruptPending() == true
+  auto interrupt() -> unsigned;
+
+  // ops.h
   auto opHALT() -> void;
 
   std::unique_ptr<ProcessorBus> bus_;
 
 private:
-  auto opcode() -> u8;
+  using OpHandler = BlockCache::Handler;
+
+  // Where the instruction handlers take immediate operands from
+  enum class Fetch {
+    Bus,          // read() at PC
+    Predecoded,   // 'operands_', spending a memory cycle on each byte
+  };
+
+  // ops.h
+  //   - Every opcode gets a handler specialized for it's
+  //     bits (see Instruction), so all of the decoding
+  //     happens at compile time
+  template <u8 Op, Fetch F = Fetch::Bus> auto op(Registers& rf) -> void;
+  template <u8 Op> auto opCB(Registers& rf) -> void;
+
+  template <Fetch F, size_t... Ops>
+  static constexpr auto opTable(std::index_sequence<Ops...>) -> std::array<OpHandler, sizeof...(Ops)>;
+  template <size_t... Ops>
+  static constexpr auto opTableCB(std::index_sequence<Ops...>) -> std::array<OpHandler, sizeof...(Ops)>;
+
+  // Indexed by the opcode (or the byte following the 0xCB prefix)
+  static const std::array<OpHandler, 256> OpTable;
+  static const std::array<OpHandler, 256> OpTableCB;
+  // Handlers which take their operands from a BlockCache::Op
+  static const std::array<OpHandler, 256> OpTablePredecoded;
+
+  // Both return the number of instructions executed, and
+  //   must only be called after a successful prologue()
+  auto executeTable(unsigned instructions) -> unsigned;
+  // threaded.cpp
+  auto executeThreaded(unsigned instructions) -> unsigned;
+  // blocks.cpp
+  auto executeCached(unsigned instructions) -> unsigned;
+
+  // jit.cpp
+  auto executeJit(unsigned instructions) -> unsigned;
+
+  // instrumented.cpp
+  //   - Used instead of the selected engine while a
+  //     Profiler or a TraceWriter is attached
+  auto executeInstrumented(unsigned instructions) -> unsigned;
+
+  // Executes (at most 'left' of) the Block's instructions starting
+  //   with ops[first], returns the number of instructions left
+  //  - Leaves the rest of the Block to the next execute() when
+  //    it runs out of instructions, see 'partial_block_'
+  auto runBlock(BlockCache::Block *block, Registers& rf, unsigned left, unsigned first = 0) -> unsigned;
+
+  // Returns the number of the Block's instructions (starting with
+  //   ops[first]) which start before the cycles() go past 'until_'
+  //   (and always at least the first one)
+  auto blockOps(const BlockCache::Block *block, unsigned first = 0) const -> unsigned;
+
+  // Returns the address of the Block's ops[op]
+  static auto opAddress(const BlockCache::Block *block, unsigned op) -> u16;
+
+  // Returns the Block to continue with at 'pc' along with the index
+  //   of it's first instruction to execute, which is non-zero only
+  //   when resuming the 'partial_block_'
+  auto enterBlock(u16 pc, unsigned& first) -> BlockCache::Block *;
+
+  // Returns the Block starting at 'pc', compiling it on a miss,
+  //   or nullptr when the code there can't be cached
+  auto block(u16 pc) -> BlockCache::Block *;
+  auto compileBlock(u32 bank, u16 pc) -> std::unique_ptr<BlockCache::Block>;
+
+  // Must be called before executing an instruction, returns
+  //   'false' if the Processor isn't RunState::Running
+  auto prologue() -> bool;
+
+  // Returns a value which changes whenever IME, the RunState
+  //   or interruptPending() do
+  //   - Used by the engines to find where they must stop
+  auto interruptState() const -> unsigned;
+
+  // Recomputes interruptPending(), called whenever
+  //   it's inputs (see interruptLines()) change
+  auto updateInterrupts() -> void;
+
+  // Executes the instruction following a RunState::HaltBug 'halt'
+  auto haltBug() -> void;
+
+  auto opcode(Registers& rf) -> u8;
+
+  template <Fetch F = Fetch::Bus> auto operand8(Registers& rf) -> u8;
+  template <Fetch F = Fetch::Bus> auto operand16(Registers& rf) -> u16;
 
-  auto operand8() -> u8;
-  auto operand16() -> u16;
+  auto push16(Registers& rf, u16 data) -> void;
+  auto pop16(Registers& rf) -> u16;
 
-  auto push16(u16 data) -> void;
-  auto pop16() -> u16;
+  // Return the value of the register encoded as 'Which'
+  //   (Reg8, Reg16_rp and Reg16_rp2 respectively)
+  template <u8 Which> auto reg8(Registers& rf) -> u8;
+  template <u8 Which> auto reg16rp(Registers& rf) -> u16;
+  template <u8 Which> auto reg16rp2(Registers& rf) -> u16;
 
-  // Return the value of the register specified by 'which'
-  auto reg(Reg8 which) -> u8;
-  auto reg(Reg16_rp which) -> u16;
-  auto reg(Reg16_rp2 which) -> u16;
+  // Set the register encoded as 'Which' to 'val'
+  template <u8 Which> auto reg8(Registers& rf, u8 val) -> void;
+  template <u8 Which> auto reg16rp(Registers& rf, u16 val) -> void;
+  template <u8 Which> auto reg16rp2(Registers& rf, u16 val) -> void;
 
-  // Set the register specified by 'which' to 'val'
-  auto reg(Reg8 which, u8 val) -> void;
-  auto reg(Reg16_rp which, u16 val) -> void;
-  auto reg(Reg16_rp2 which, u16 val) -> void;
+  // Returns 'true' when the ConditionCode 'Which' is met
+  template <u8 Which> auto cond(Registers& rf) -> bool;
 
-  auto alu(AluOp op, u8 val) -> void;
-  auto rot(RotOp op, u8 val) -> void;
-  auto akku(AkkuOp op) -> void;
+  auto alu(Registers& rf, AluOp op, u8 val) -> void;
+  auto rot(Registers& rf, RotOp op, u8 val) -> u8;
+  auto akku(Registers& rf, AkkuOp op) -> void;
+
+  // add hl, <reg16>
+  auto addHL(Registers& rf, u16 val) -> void;
+  // Returns sp+<imm8> and sets the flags like 'add sp, <imm8>'
+  auto addSP(Registers& rf, u8 val) -> u16;
 
   Registers r;
+
+  Engine engine_ = Engine::Table;
+
+  // Interrupt master enable
+  bool ime_ = false;
+  // 'ei' sets IME only after the instruction which follows it
+  bool ei_delay_ = false;
+
+  RunState run_state_ = RunState::Running;
+
+  // See interruptLines() and interruptPending()
+  u8 irq_lines_ = 0;
+  bool irq_pending_ = false;
+
+  BlockCache blocks_;
+
+  // Set when the Block being executed might've been
+  //   modified (or remapped) by one of it's instructions,
+  //   or when one of them changed interruptPending()
+  bool block_break_ = false;
+
+  // The Block the previous execute() stopped in the middle of
+  //   (at 'partial_pc_', with ops[partial_op_] up next), which
+  //   the next one finishes instead of starting a new Block
+  //   there - otherwise every address a slice happens to end
+  //   at would get a Block of it's own
+  //  - Forgotten whenever the Block could've been dropped or
+  //    the memory remapped, and checked against PC when
+  //    resuming, as it could've been changed in between
+  BlockCache::Block *partial_block_ = nullptr;
+  unsigned partial_op_ = 0;
+  u16 partial_pc_ = 0;
+
+  // See lastPc()
+  u16 last_pc_ = 0;
+
+  // The 'until' passed to execute(), which updateInterrupts()
+  //   zeroes to make the engines stop right after the
+  //   instruction being executed
+  u64 until_ = ~0ull;
+
+  // Operands of the BlockCache::Op being executed
+  const u8 *operands_ = nullptr;
+
+  u64 cycles_ = 0;
+  u64 writes_ = 0;
+
+  // Pages mapped with mapReadPage() and mapWritePage(),
+  //   nullptr for the ones which go through the bus
+  std::array<const u8 *, 256> read_pages_ = { };
+  std::array<u8 *, 256> write_pages_ = { };
+
+  // jit.cpp
+  //   - Returns 'false' when the CodeArena is full
+  auto recompile(BlockCache::Block *block) -> bool;
+
+  // Allocated on first use of Engine::Jit
+  std::unique_ptr<CodeArena> jit_code_;
+
+  // instrumented.cpp
+  //   - Recomputes 'instrumented_'
+  auto updateInstrumented() -> void;
+
+  // instrumented.cpp
+  //   - Return the Profiler's counters for the memory
+  //     currently mapped at 'addr'
+  auto profilePage(u16 addr) -> Profiler::Page *;
+  auto profileEntry(u16 addr) -> Profiler::Entry&;
+
+  // Returns 'true' (and records the hit) when there's a breakpoint
+  //   at 'pc' - which must be checked before every instruction
+  //   but the first one executed by an execute() call
+  auto breakpointAt(u16 pc) -> bool;
+
+  // Set when execute() has to use executeInstrumented()
+  bool instrumented_ = false;
+
+  std::bitset<0x10000> breakpoints_;
+  unsigned num_breakpoints_ = 0;
+
+  // Where the last execute() stopped, when it hit a breakpoint
+  bool break_hit_ = false;
+  u16 break_pc_ = 0;
+
+  Profiler *profiler_ = nullptr;
+  TraceWriter *tracer_ = nullptr;
+
+  sm83disasm::DisasmCache *disasm_cache_ = nullptr;
+
+  // Cache of profilePage() for each page of the address
+  //   space, cleared whenever it's mapping changes
+  std::array<Profiler::Page *, 256> profile_pages_ = { };
 };
 
+inline auto Processor::pc() const -> u16
+{
+  return r.pc;
+}
+
+inline auto Processor::lastPc() const -> u16
+{
+  return last_pc_;
+}
+
+inline auto Processor::read(u16 addr) -> u8
+{
+  auto page = read_pages_[addr >> 8];
+  u8 data = BRGB_LIKELY(page != nullptr) ? page[addr & 0xFF] : busRead(addr);
+
+  cycles_++;
+
+  return data;
+}
+
+inline auto Processor::write(u16 addr, u8 data) -> void
+{
+  if(auto page = write_pages_[addr >> 8]; BRGB_LIKELY(page != nullptr)) {
+    page[addr & 0xFF] = data;
+    codeWritten(addr);
+  } else {
+    busWrite(addr, data);
+  }
+
+  cycles_++;
+  writes_++;
+}
+
+inline auto Processor::idle() -> void
+{
+  cycles_++;
+}
+
+inline auto Processor::stall(unsigned cycles) -> void
+{
+  cycles_ += cycles;
+}
+
+inline auto Processor::interruptPending() const -> bool
+{
+  return irq_pending_;
+}
+
+inline auto Processor::updateInterrupts() -> void
+{
+  // A halted Processor wakes up regardless of IME
+  bool pending = irq_lines_ && (ime_ || run_state_ == RunState::Halted);
+
+  // Writes to IF or IE can happen in the middle of a Block (or
+  //   a run of threaded instructions), after which the interrupt
+  //   has to be serviced before any further instruction
+  if(pending != irq_pending_) {
+    block_break_ = true;
+    until_ = 0;
+  }
+
+  irq_pending_ = pending;
+}
+
+inline auto Processor::codeWritten(u16 addr) -> void
+{
+  if(BRGB_UNLIKELY(disasm_cache_ != nullptr)) disasm_cache_->written(addr);
+
+  if(BRGB_LIKELY(!blocks_.watched(addr))) return;
+
+  if(blocks_.invalidate(addr)) {
+    block_break_ = true;
+    partial_block_ = nullptr;
+  }
+}
+
+inline auto Processor::codeRemapped() -> void
+{
+  block_break_ = true;
+  partial_block_ = nullptr;
+
+  if(BRGB_UNLIKELY(profiler_ != nullptr)) profile_pages_.fill(nullptr);
+}
+
 }
@@ -0,0 +1,157 @@
+#pragma once
+
+#include <types.h>
+
+#include <device/sm83/disassembler.h>
+
+#include <memory>
+#include <array>
+#include <vector>
+#include <unordered_map>
+#include <functional>
+
+namespace brgb::sm83disasm {
+
+// Cache of disassembled instructions keyed by the memory bank and
+//   address they start at, meant for views which show the code
+//   around PC over and over (ex. a debugger's disassembly pane,
+//   which only has to render the lines visible in it)
+//  - Filled lazily - an instruction is disassembled the first
+//    time it's looked up and then served from the cache
+//  - Attached to a Processor with sm83::Processor::disasmCache(),
+//    which reads the memory through it's memoryBank() and peek()
+//    hooks, and forwards every codeWritten() to written()
+//  - Instructions from ReadOnly banks (ex. ROM) stay cached for
+//    good, the ones from writable memory are tracked per page
+//    (256 bytes) and dropped as soon as any of their bytes gets
+//    written to, while the ones in Uncacheable memory (or which
+//    span two banks) are disassembled anew on every lookup
+//  - The memory banks are assumed to be mapped in whole pages
+//    (just like sm83::Processor::mapReadPage() maps them)
+class DisasmCache {
+public:
+  // See sm83::Processor::memoryBank() and peek()
+  using BankFn = std::function<u32(u16 /* addr */)>;
+  using PeekFn = std::function<u8(u16 /* addr */)>;
+
+  enum : u32 {
+    // Same as sm83::Processor's
+    Uncacheable = ~0u,
+    ReadOnly    = 1u<<31,
+  };
+
+  enum : unsigned {
+    PageShift = 8,
+    NumPages  = 0x10000 >> PageShift,
+
+    // Upper bound on the length of Entry::text, including
+    //   the NUL terminator
+    MaxTextLength = 32,
+  };
+
+  struct Entry {
+    u32 bank;
+    u16 addr;
+
+    // Number of bytes the instruction takes up
+    u8 length;
+
+    // 'true' when the byte at 'addr' isn't an
+    //   opcode, see Instruction::isData()
+    bool data;
+
+    u8 bytes[Instruction::MaxLength];
+
+    // Ex. "ld a, ($FF44)"
+    char text[MaxTextLength];
+  };
+
+  DisasmCache();
+  DisasmCache(const DisasmCache&) = delete;
+
+  // Called by sm83::Processor::disasmCache(), a detached DisasmCache
+  //   is empty and can't be looked up in
+  auto attach(BankFn bank, PeekFn peek) -> void;
+  auto detach() -> void;
+
+  auto attached() const -> bool;
+
+  // Fills 'entries' with the 'count' instructions which come one after
+  //   another starting at 'addr' (disassembling the ones which
+  //   aren't cached) and returns how many there were
+  //  - The Entries stay valid until the next window(), written()
+  //    or clear(), so they're meant to be rendered right away
+  //  - Every instruction is disassembled from the memory mapped at
+  //    the moment, so when walking into another bank the following
+  //    instructions come from it
+  auto window(u16 addr, unsigned count, const Entry **entries) -> unsigned;
+
+  // Returns 'true' when the page containing 'addr' has
+  //   any cached instructions from writable memory
+  inline auto watched(u16 addr) const -> bool
+  {
+    return !pages_[addr >> PageShift].empty();
+  }
+
+  // Drops the cached instructions from writable memory containing
+  //   'addr' and returns 'true' if there were any
+  auto invalidate(u16 addr) -> bool;
+
+  // Must be called for every write to cacheable memory (which
+  //   sm83::Processor::codeWritten() does for an attached one)
+  inline auto written(u16 addr) -> void
+  {
+    if(watched(addr)) invalidate(addr);
+  }
+
+  // Drops all of the cached instructions
+  auto clear() -> void;
+
+  // Returns the number of cached instructions
+  auto size() const -> size_t;
+
+  // Returns the number of lookups done by window() which were
+  //   served from the cache and which had to disassemble
+  auto hits() const -> u64;
+  auto misses() const -> u64;
+
+private:
+  static auto key(u32 bank, u16 addr) -> u64;
+
+  // Disassembles the instruction at 'addr' into 'entry' and returns
+  //   'true' when it can be cached, i.e. all of it's bytes come
+  //   from the same (cacheable) bank
+  auto disassemble(u16 addr, Entry& entry) -> bool;
+
+  // Returns the (possibly just disassembled) instruction
+  //   at 'addr', which is in 'bank'
+  auto lookup(u32 bank, u16 addr) -> const Entry *;
+
+  // Calls 'fn' with the 'pages_' entry of every
+  //   page 'entry' overlaps
+  template <typename Fn>
+  auto eachPage(const Entry *entry, Fn fn) -> void;
+
+  // Removes 'entry' from 'entries_', 'recent_' and 'pages_'
+  auto drop(const Entry *entry) -> void;
+
+  BankFn bank_;
+  PeekFn peek_;
+
+  std::unordered_map<u64, Entry> entries_;
+
+  // The most recently looked up Entry for every address, which
+  //   spares the hashing when the bank doesn't change
+  std::vector<const Entry *> recent_;
+
+  // Cached instructions from writable memory overlapping each page
+  std::array<std::vector<const Entry *>, NumPages> pages_;
+
+  // The instructions which couldn't be cached, disassembled
+  //   during the last window()
+  std::vector<std::unique_ptr<Entry>> uncached_;
+
+  u64 hits_ = 0, misses_ = 0;
+};
+
+}
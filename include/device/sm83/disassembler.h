@@ -4,6 +4,7 @@
 #include <util/format.h>
 #include <util/natural.h>
 #include <util/bit.h>
+#include <device/sm83/opcodes.h>
 
 #include <limits>
 #include <utility>
@@ -17,33 +18,12 @@
 
 namespace brgb::sm83disasm {
 
-enum OpcodeMnemonic : u8 {
-  op_Invalid,
-
-  op_nop,
-  op_stop, op_halt,
-  op_jp, op_jr,
-  op_ld, op_ldh,
-  op_inc, op_dec,
-  op_rlca, op_rla, op_rrca, op_rra,
-  op_daa,
-  op_cpl,
-  op_scf, op_ccf,
-  op_add, op_adc, op_sub, op_sbc,
-  op_and, op_or, op_xor,
-  op_cp,
-  op_call,
-  op_ret, op_reti,
-  op_push, op_pop,
-  op_ei, op_di,
-  op_rst,
-
-  // CB-prefixed opcodes
-  op_rlc, op_rl, op_rrc, op_rr,
-  op_sla, op_sra, op_srl,
-  op_swap,
-  op_bit, op_res, op_set,
-};
+// See disassembler.cpp
+class LineWriter;
+struct OpcodeText;
+
+// The mnemonics are shared with the Processor, see sm83::OpcodeTable
+using OpcodeMnemonic = sm83::Mnemonic;
 
 using Opcode = Natural<8>;
 
@@ -61,6 +41,8 @@ public:
     OperandReg8, OperandReg16,
     OperandImm8, OperandImm16,
     OperandRelOffset8,
+    OperandOffset8,     // Signed, add sp, <offset>
+    OperandSPOffset8,   // ld hl, sp+<offset>
     OperandAddress16,
     OperandReg16Indirect, OperandPtr16,
 
@@ -104,22 +86,50 @@ public:
 
   static constexpr u8 CB_prefix = 0xCB;
 
-  static auto OperandReg_to_str(OperandReg reg) -> std::string;
-  static auto OperandCondition_to_str(OperandCondition cond) -> std::string;
+  // Length of the longest instruction in bytes
+  static constexpr unsigned MaxLength = 3;
+
+  enum DecodeStatus {
+    DecodeOk,
+    DecodeIllegalOpcode,    // The byte isn't an opcode
+    DecodeTruncated,        // The instruction doesn't fit before the end
+  };
+
+  static auto OperandReg_to_str(OperandReg reg) -> const char *;
+  static auto OperandCondition_to_str(OperandCondition cond) -> const char *;
 
   // Returns an opcode's mnemonic
-  static auto op_mnem_to_str(OpcodeMnemonic op) -> std::string;
+  static auto op_mnem_to_str(OpcodeMnemonic op) -> const char *;
   // Returns the mnemonic for a CB-prefixed opcode
-  static auto op_0xCB_mnem_to_str(OpcodeMnemonic op) -> std::string;
+  static auto op_0xCB_mnem_to_str(OpcodeMnemonic op) -> const char *;
 
   // 'mem' is a pointer to the base of the binary being diassembled
   Instruction(u8 *mem);
+  // Same as above for bytes which are found at address 'base' (ex. a
+  //   copy of them or a ROM bank), so the offsets are addresses -
+  //   which wrap around the 16-bit address space like PC does
+  Instruction(u8 *mem, u16 base);
 
   // Populates the Instruction object with data at 'ptr'
   //   and returns 'ptr' advanced appropriately i.e. by
   //   the width of the opcode and it's operands (if any)
+  //   - Throws Disassembler::IllegalOpcodeError for the bytes
+  //     which aren't an opcode
   auto disassemble(u8 *ptr) -> u8 *;
 
+  // Same as disassemble(), except the bytes from 'end' on are never
+  //   read and failures are returned instead of thrown - with the
+  //   Instruction becoming a 'db' of the single byte at 'ptr' (see
+  //   isData()), which is what 'ptr' gets advanced past
+  //   - Meant for sweeping over binaries which mix code and data,
+  //     where unwinding an exception for every data byte ends up
+  //     costing more than the disassembly itself
+  auto decode(u8 *& ptr, const u8 *end) -> DecodeStatus;
+
+  // Returns 'true' when the last decode() failed, in which case the
+  //   Instruction has no operands and formats as 'db   $XX'
+  auto isData() const -> bool;
+
   // Returns the number of operands for the Instruction's opcode
   auto numOperands() -> unsigned;
 
@@ -138,67 +148,64 @@ public:
 
   auto toStr() -> std::string;
 
+  // Writes the same text as toStr() to 'buf', without any heap
+  //   allocations, and returns it's length
+  //   - The text is always NUL-terminated and gets truncated
+  //     when it doesn't fit into 'size' bytes
+  auto format(char *buf, size_t size) -> size_t;
+
 private:
-  auto disassemble0x00_0x30(u8 *ptr) -> u8 *;
-  auto disassemble0x80_0xB0(u8 *ptr) -> u8 *;
-  auto disassemble0xC0_0xF0(u8 *ptr) -> u8 *;
-  auto disassembleCBPrefixed(u8 *ptr) -> u8 *;
-
-  auto opcodeToStr() -> std::string;
-
-  auto operandsToStr() -> std::string;
-
-  // 'op_' MUST have been assigned before calling this method!
-  //
-  //   Usage:
-  //      dispatchOnLoNibble(
-  //          std::make_pair(0x0, []() { puts("lo nibble is 0x0!"); }),
-  //          std::make_pair(0x2, []() { puts("lo nibble is 0x2!"); }),
-  //          std::make_pair(0x8, []() { puts("lo nibble is 0x8!"); })
-  //      );
-  template <typename... Fn>
-  auto dispatchOnLoNibble(std::pair<u8 /* lo_nibble */, Fn>... handlers) -> void
-  {
-    u8 op = op_;
-
-    // This expression matches op against each pair in 'handlers'
-    //   and by short-circuiting calls the pair's Fn (handlers.second)
-    //
-    //  - The handler's Fn return type is void which would disallow
-    //    the usage of &&, so the comma operator is used to coerce
-    //    it into int (the 0 in the marked expession below)
-    //                                  vvvvvvvvvvvvvvvvvvvv
-    ( ((op & 0x0F) == handlers.first && (handlers.second(), 0)), ... );
-  }
-
-  template <typename... Fn>
-  auto dispatchOnHiNibble(std::pair<u8 /* hi_nibble */, Fn>... handlers) -> void
-  {
-    u8 op = op_;
-
-    ( ((op & 0xF0) == handlers.first && (handlers.second(), 0)), ... );
-  }
+  // Disassembler::singleStep() writes the text straight into it's line
+  friend class Disassembler;
+
+  // Makes the Instruction a 'db' of the byte at 'ptr' and advances it
+  auto decodeData(u8 *& ptr, DecodeStatus status) -> DecodeStatus;
+
+  auto write(LineWriter& out) -> void;
+  auto writeOpcode(LineWriter& out) -> void;
+  auto writeOperand(LineWriter& out, unsigned which) -> void;
+
+  // Returns the text of every opcode in sm83::OpcodeTable order,
+  //   formatted once on first use
+  static auto opcode_texts() -> const OpcodeText *;
+
+  // Returns which operand's text depends on the instruction's
+  //   bytes rather than only on it's opcode, or -1 if none does
+  auto variableOperand() -> int;
+
+  // Returns the Instruction's 'which' operand
+  auto operand(unsigned which) -> sm83::Operand;
 
   // Base address of the binary being diassembled
   u8 *mem_ = nullptr;
   // Offset of this instruction in the binary
   uintptr_t offset_ = std::numeric_limits<uintptr_t>::max();
 
+  // Added to the offsets when 'addresses_' == true, see
+  //   Instruction(u8 *, u16)
+  uintptr_t base_ = 0;
+  bool addresses_ = false;
+
   bool op_CB_prefixed_ = false;
+  // See isData()
+  bool data_ = false;
+
   Opcode op_;
-  OpcodeMnemonic op_mnem_ = op_Invalid;
+  OpcodeMnemonic op_mnem_ = OpcodeMnemonic::Invalid;
+
+  // Points into sm83::OpcodeTable after disassemble()
+  const sm83::OpcodeInfo *info_ = nullptr;
 
   Natural<16> operand_ = 0;
   BitRange<16, 0, 7> operand_lo_{ operand_.ptr() };
   BitRange<16, 8, 15> operand_hi_{ operand_.ptr() };
 };
 
-// TODO:
-//   - Output non-instruction bytes in their raw form (using
-//     a 'db' directive) instead of throwing an exception
-//   - Scan the instruction stream in begin() for branch
-//     targets and output labels appropriately during
-//     actual disassembly
+// Disassembles a binary linearly, one instruction after another
+//   - The bytes which aren't an opcode are output in their raw
+//     form, as a 'db' directive
+//   - See RomDisassembler for one which follows the control flow
+//     and outputs labels
 class Disassembler {
 public:
   struct IllegalOpcodeError final : public std::runtime_error {
@@ -224,14 +231,37 @@ public:
   // Begin disassembling of a binary at the given address
   //   - Resets the internal cursor to 'mem' (i.e. the beginning of the binary)
   auto begin(u8 *mem) -> Disassembler&;
+  // Same as above for a binary of known 'size', the bytes past
+  //   which are never read (see done())
+  auto begin(u8 *mem, size_t size) -> Disassembler&;
+
+  // Returns 'true' once the cursor reached the end of a binary
+  //   of known size, always 'false' for ones of unknown size
+  auto done() const -> bool;
+
+  // Returns the cursor's offset from the beginning of the binary
+  auto offset() const -> size_t;
+
+  enum : size_t {
+    // Upper bound on the length of a line written by
+    //   singleStep(), including the NUL terminator
+    MaxLineLength = 64,
+  };
 
   // Disassemble a single instruction and advance the internal cursor
   auto singleStep() -> std::string;
 
+  // Same as singleStep(), except the line is written to 'buf' (see
+  //   Instruction::format()) and it's length is returned
+  //   - Doesn't allocate, so 'buf' can be reused for every line
+  auto singleStep(char *buf, size_t size) -> size_t;
+
 private:
 
   u8 *mem_ = nullptr;
   u8 *cursor_ = nullptr;
+  // nullptr when the binary's size isn't known
+  u8 *end_ = nullptr;
 };
 
 }
@@ -0,0 +1,193 @@
+#pragma once
+
+#include <types.h>
+
+namespace brgb::sm83 {
+
+// The Z/N/H/C flags as seen by the instruction handlers
+//   - Each kind of operation has it's own setter, which takes
+//     the operation's inputs/result, so how (and when) the
+//     flags get computed is up to the implementation
+//  - By default the setters only record the values the flags
+//    are derived from and the flags are materialized when read
+//    (most flag updates are overwritten before being looked at),
+//    defining BRGB_SM83_EAGER_FLAGS computes them right away
+#if !defined(BRGB_SM83_EAGER_FLAGS)
+class Flags {
+public:
+  // Z is set when the low byte of 'zr_' is 0
+  // N is 'n_'
+  // H is bit 4 of 'hr_'
+  // C is bit 8 of 'cr_'
+  //  - Bit 4 of 'a ^ b ^ (a +/- b)' is the carry/borrow
+  //    from bit 3, and bit 8 of the 9-bit (a +/- b) the
+  //    carry/borrow from bit 7, so arithmetic only ever
+  //    has to store it's operands and result
+  inline auto z() const -> bool { return !zr_; }
+  inline auto n() const -> bool { return n_; }
+  inline auto h() const -> bool { return hr_ & 0x10; }
+  inline auto c() const -> bool { return cr_ & 0x100; }
+
+  // The flags as stored in the F register
+  inline auto byte() const -> u8
+  {
+    return z() << 7 | n() << 6 | h() << 5 | c() << 4;
+  }
+
+  inline auto byte(u8 f) -> void
+  {
+    zr_ = ~f & 0x80;
+    n_  = f & 0x40;
+    hr_ = (f & 0x20) >> 1;
+    cr_ = (f & 0x10) << 4;
+  }
+
+  // add, adc, sub, sbc, cp
+  //   - 'result' must be computed in (at least) 16-bits
+  inline auto arith(u8 a, u8 b, u16 result, bool n) -> void
+  {
+    zr_ = (u8)result;
+    n_  = n;
+    hr_ = a ^ b ^ result;
+    cr_ = result;
+  }
+
+  // inc, dec - C is left unchanged
+  inline auto incdec(u8 a, u8 result, bool n) -> void
+  {
+    zr_ = result;
+    n_  = n;
+    hr_ = a ^ 1 ^ result;
+  }
+
+  // and, xor, or
+  inline auto logic(u8 result, bool h) -> void
+  {
+    zr_ = result;
+    n_  = false;
+    hr_ = h << 4;
+    cr_ = 0;
+  }
+
+  // Rotates and shifts, when '!z' Z is always cleared
+  inline auto shift(u8 result, bool carry, bool z = true) -> void
+  {
+    zr_ = z ? result : 1;
+    n_  = false;
+    hr_ = 0;
+    cr_ = carry << 8;
+  }
+
+  // add hl, <reg16> - Z is left unchanged
+  inline auto add16(u16 a, u16 b, u32 result) -> void
+  {
+    n_  = false;
+    hr_ = (a ^ b ^ result) >> 8;
+    cr_ = result >> 8;
+  }
+
+  // add sp, imm8 and ld hl, sp+imm8
+  //   - 'lo' is the low byte of sp, 'result' is 'lo + b'
+  inline auto addSP(u8 lo, u8 b, u16 result) -> void
+  {
+    zr_ = 1;
+    n_  = false;
+    hr_ = lo ^ b ^ result;
+    cr_ = result;
+  }
+
+  // bit <n>, <reg8> - C is left unchanged
+  inline auto bit(bool set) -> void
+  {
+    zr_ = set;
+    n_  = false;
+    hr_ = 0x10;
+  }
+
+  // daa - N is left unchanged
+  inline auto daa(u8 result, bool carry) -> void
+  {
+    zr_ = result;
+    hr_ = 0;
+    cr_ = carry << 8;
+  }
+
+  inline auto cpl() -> void { n_ = true; hr_ = 0x10; }
+  inline auto scf() -> void { n_ = false; hr_ = 0; cr_ = 0x100; }
+  inline auto ccf() -> void { n_ = false; hr_ = 0; cr_ ^= 0x100; }
+
+private:
+  // Initialized to the equivalent of F=0
+  u8 zr_ = 1, n_ = 0, hr_ = 0;
+  u16 cr_ = 0;
+};
+#else
+class Flags {
+public:
+  enum : u8 {
+    Z = 1<<7, N = 1<<6, H = 1<<5, C = 1<<4,
+  };
+
+  inline auto z() const -> bool { return f_ & Z; }
+  inline auto n() const -> bool { return f_ & N; }
+  inline auto h() const -> bool { return f_ & H; }
+  inline auto c() const -> bool { return f_ & C; }
+
+  inline auto byte() const -> u8 { return f_; }
+  inline auto byte(u8 f) -> void { f_ = f & 0xF0; }
+
+  inline auto arith(u8 a, u8 b, u16 result, bool n) -> void
+  {
+    set(!(u8)result, n, (a ^ b ^ result) & 0x10, result & 0x100);
+  }
+
+  inline auto incdec(u8 a, u8 result, bool n) -> void
+  {
+    set(!result, n, (a ^ 1 ^ result) & 0x10, c());
+  }
+
+  inline auto logic(u8 result, bool h) -> void
+  {
+    set(!result, false, h, false);
+  }
+
+  inline auto shift(u8 result, bool carry, bool z = true) -> void
+  {
+    set(z && !result, false, false, carry);
+  }
+
+  inline auto add16(u16 a, u16 b, u32 result) -> void
+  {
+    set(z(), false, (a ^ b ^ result) & 0x1000, result & 0x10000);
+  }
+
+  inline auto addSP(u8 lo, u8 b, u16 result) -> void
+  {
+    set(false, false, (lo ^ b ^ result) & 0x10, result & 0x100);
+  }
+
+  inline auto bit(bool set_) -> void
+  {
+    set(!set_, false, true, c());
+  }
+
+  inline auto daa(u8 result, bool carry) -> void
+  {
+    set(!result, n(), false, carry);
+  }
+
+  inline auto cpl() -> void { set(z(), true, true, c()); }
+  inline auto scf() -> void { set(z(), false, false, true); }
+  inline auto ccf() -> void { set(z(), false, false, !c()); }
+
+private:
+  inline auto set(bool z, bool n, bool h, bool c) -> void
+  {
+    f_ = z << 7 | n << 6 | h << 5 | c << 4;
+  }
+
+  u8 f_ = 0;
+};
+#endif
+
+}
@@ -0,0 +1,138 @@
+#pragma once
+
+#include <types.h>
+
+#include <vector>
+#include <initializer_list>
+
+#include <cstddef>
+
+// The recompiler emits x86-64 code which follows the System V
+//   calling convention, so it's only available on such hosts
+//  - Elsewhere Processor::Engine::Jit behaves like Engine::Cached
+#if defined(__x86_64__) && defined(__unix__)
+#  define BRGB_SM83_JIT 1
+#endif
+
+namespace brgb::sm83 {
+
+// Fixed-size region of executable memory which recompiled
+//   code is bump-allocated from
+//  - Individual allocations are never freed, once the
+//    CodeArena is full it has to be reset() as a whole
+class CodeArena {
+public:
+  enum : size_t {
+    DefaultSize = 8 * 1024*1024,
+  };
+
+  CodeArena(size_t size = DefaultSize);
+  CodeArena(const CodeArena&) = delete;
+  ~CodeArena();
+
+  // Copies 'code' into the arena and returns a pointer to
+  //   it, or nullptr when there isn't enough space left
+  auto commit(const std::vector<u8>& code) -> void *;
+
+  // Discards all of the code committed so far
+  auto reset() -> void;
+
+  // Returns the number of bytes used up
+  auto used() const -> size_t;
+
+private:
+  u8 *base_ = nullptr;
+
+  size_t size_ = 0;
+  size_t used_ = 0;
+};
+
+// Encodes the handful of x86-64 instructions needed
+//   by the recompiler into a byte buffer
+//  - Memory operands always use a 32-bit displacement
+class X64Emitter {
+public:
+  enum Reg : u8 {
+    rax = 0, rcx = 1, rdx = 2, rbx = 3, rsp = 4, rbp = 5, rsi = 6, rdi = 7,
+    r8 = 8, r9 = 9, r10 = 10, r11 = 11, r12 = 12, r13 = 13, r14 = 14, r15 = 15,
+  };
+
+  enum Cond : u8 {
+    Zero = 0x4, NotZero = 0x5,
+  };
+
+  // Position in the buffer a jump can later be bound to
+  using Label = size_t;
+
+  auto code() const -> const std::vector<u8>&;
+  auto size() const -> size_t;
+
+  auto push(Reg r) -> X64Emitter&;
+  auto pop(Reg r) -> X64Emitter&;
+  auto ret() -> X64Emitter&;
+
+  // mov <dst>, <src> (64-bit)
+  auto mov64(Reg dst, Reg src) -> X64Emitter&;
+  // mov <dst>, <src> (32-bit)
+  auto mov32(Reg dst, Reg src) -> X64Emitter&;
+  // mov <dst>, imm32 (zero-extended)
+  auto mov32(Reg dst, u32 imm) -> X64Emitter&;
+  // mov rax, imm64
+  auto movRaxImm64(u64 imm) -> X64Emitter&;
+
+  // mov [<base>+disp], rax
+  auto storeRax(Reg base, i32 disp) -> X64Emitter&;
+  // movzx eax, byte [<base>+disp]
+  auto loadZxAl(Reg base, i32 disp) -> X64Emitter&;
+  // mov al, byte [<base>+disp]
+  auto loadAl(Reg base, i32 disp) -> X64Emitter&;
+  // mov byte [<base>+disp], al
+  auto storeAl(Reg base, i32 disp) -> X64Emitter&;
+  // mov byte [<base>+disp], imm8
+  auto store8(Reg base, i32 disp, u8 imm) -> X64Emitter&;
+  // mov word [<base>+disp], imm16
+  auto store16(Reg base, i32 disp, u16 imm) -> X64Emitter&;
+  // inc/dec word [<base>+disp]
+  auto incdec16(Reg base, i32 disp, bool dec) -> X64Emitter&;
+  // add qword [<base>+disp], imm32
+  auto add64(Reg base, i32 disp, u32 imm) -> X64Emitter&;
+  // cmp byte [<base>+disp], 0
+  auto cmpZero8(Reg base, i32 disp) -> X64Emitter&;
+
+  // inc/dec ax
+  auto incdecAx(bool dec) -> X64Emitter&;
+  // shl eax, imm8    shr eax, imm8
+  auto shlEax(u8 imm) -> X64Emitter&;
+  auto shrEax(u8 imm) -> X64Emitter&;
+  // dec <r> (32-bit)
+  auto dec32(Reg r) -> X64Emitter&;
+
+  // call rax
+  auto callRax() -> X64Emitter&;
+
+  // Emit a jump with a yet unknown target, and later point it
+  //   at the current position (see bind())
+  auto jmp() -> Label;
+  auto jcc(Cond cc) -> Label;
+  auto bind(Label jump) -> X64Emitter&;
+
+private:
+  auto byte(u8 b) -> X64Emitter&;
+  auto imm16(u16 v) -> X64Emitter&;
+  auto imm32(u32 v) -> X64Emitter&;
+  auto imm64(u64 v) -> X64Emitter&;
+
+  enum OpSize {
+    Op8_32,   // The opcode's default operand size
+    Op16,     // 0x66 prefix
+    Op64,     // REX.W
+  };
+
+  // Emits the prefixes (when needed) followed by 'opcode' and
+  //   a ModRM (+SIB) byte encoding [<base>+disp32]
+  auto memOp(std::initializer_list<u8> opcode, u8 reg, Reg base, i32 disp, OpSize size = Op8_32) -> X64Emitter&;
+
+  std::vector<u8> code_;
+};
+
+}
@@ -0,0 +1,403 @@
+#pragma once
+
+#include <types.h>
+
+#include <array>
+
+namespace brgb::sm83 {
+
+enum class Mnemonic : u8 {
+  Invalid,    // The illegal opcodes (and the 0xCB prefix itself)
+
+  Nop,
+  Stop, Halt,
+  Jp, Jr,
+  Ld, Ldh,
+  Inc, Dec,
+  Rlca, Rla, Rrca, Rra,
+  Daa,
+  Cpl,
+  Scf, Ccf,
+  Add, Adc, Sub, Sbc,
+  And, Or, Xor,
+  Cp,
+  Call,
+  Ret, Reti,
+  Push, Pop,
+  Ei, Di,
+  Rst,
+
+  // CB-prefixed opcodes
+  Rlc, Rl, Rrc, Rr,
+  Sla, Sra, Srl,
+  Swap,
+  Bit, Res, Set,
+
+  NumMnemonics,
+};
+
+// An instruction's operand as it appears in the
+//   disassembly, in the order they're listed
+enum class Operand : u8 {
+  None,
+
+  A, B, C, D, E, H, L,
+  AF, BC, DE, HL, SP,
+
+  BCInd, DEInd, HLInd,    // (bc), (de), (hl)
+  HLIInd, HLDInd,         // (hl+), (hl-)
+  HighC,                  // ($FF00+c)
+
+  NZ, Z, NC, CarrySet,    // Conditions, 'c' as 'CarrySet' as
+                          //   not to collide with register C
+
+  // Read from the bytes following the opcode
+  Imm8, Imm16,
+  Rel8,                   // jr's target, relative to the next instruction
+  Offset8,                // Signed offset of add sp
+  SPOffset8,              // sp+<signed offset> of ld hl
+  Ptr16,                  // (<imm16>)
+  HighPtr8,               // ($FF00+<imm8>)
+
+  // Encoded in the opcode
+  RSTVector,              // 'y'*8
+  BitIndex,               // 'y'
+};
+
+// OpcodeInfo::attributes
+enum OpcodeAttribute : u8 {
+  // Can change PC other than by moving on to the next instruction
+  OpBranch = 1<<0,
+  // The branch depends on a condition (see OpcodeInfo::cycles_taken)
+  OpConditional = 1<<1,
+  // Pushes the return address - call and rst
+  OpCall = 1<<2,
+  // Pops the return address - ret and reti
+  OpReturn = 1<<3,
+  // Can change IME or the RunState (including the illegal
+  //   opcodes, which lock up the Processor)
+  OpInterruptState = 1<<4,
+  // The 0xCB prefix, described by the second half of OpcodeTable
+  OpPrefix = 1<<5,
+  // Leaves a (possibly) different value in A, wherever A appears
+  //   among the operands (or when it's only implied, ex. 'or b')
+  OpWritesA = 1<<6,
+};
+
+// OpcodeInfo::flags, the same bits as in the F register
+enum OpcodeFlag : u8 {
+  FlagZ = 1<<7, FlagN = 1<<6, FlagH = 1<<5, FlagC = 1<<4,
+};
+
+struct OpcodeInfo {
+  Mnemonic mnemonic;
+  Operand operands[2];
+
+  // Bytes taken up by the instruction, including
+  //   the 0xCB prefix and the operands
+  u8 length;
+
+  // Memory cycles spent, when a conditional branch isn't and is taken
+  //   (both are the same for all the other instructions)
+  u8 cycles, cycles_taken;
+
+  // Flags (OpcodeFlag) the instruction can modify
+  u8 flags;
+
+  // OpcodeAttribute
+  u8 attributes;
+
+  constexpr auto numOperands() const -> unsigned
+  {
+    return (operands[0] != Operand::None) + (operands[1] != Operand::None);
+  }
+
+  constexpr auto is(u8 attribute) const -> bool { return attributes & attribute; }
+};
+
+namespace opcodes_detail {
+
+constexpr auto info(Mnemonic mnemonic, Operand a, Operand b, u8 length,
+    u8 cycles, u8 cycles_taken, u8 flags, u8 attributes) -> OpcodeInfo
+{
+  OpcodeInfo info = { };
+
+  info.mnemonic = mnemonic;
+  info.operands[0] = a; info.operands[1] = b;
+  info.length = length;
+  info.cycles = cycles; info.cycles_taken = cycles_taken;
+  info.flags = flags;
+  info.attributes = attributes;
+
+  return info;
+}
+
+// Instructions without a conditional branch
+constexpr auto info(Mnemonic mnemonic, Operand a, Operand b, u8 length,
+    u8 cycles, u8 flags = 0, u8 attributes = 0) -> OpcodeInfo
+{
+  return info(mnemonic, a, b, length, cycles, cycles, flags, attributes);
+}
+
+// See Instruction for the meaning of 'x', 'y', 'z', 'p' and 'q'
+constexpr auto decode(u8 op) -> OpcodeInfo
+{
+  using M = Mnemonic;
+  using O = Operand;
+
+  constexpr O Reg8[]   = { O::B, O::C, O::D, O::E, O::H, O::L, O::HLInd, O::A };
+  constexpr O Reg16[]  = { O::BC, O::DE, O::HL, O::SP };
+  constexpr O Reg16S[] = { O::BC, O::DE, O::HL, O::AF };    // push, pop
+  constexpr O Ind[]    = { O::BCInd, O::DEInd, O::HLIInd, O::HLDInd };
+  constexpr O Cond[]   = { O::NZ, O::Z, O::NC, O::CarrySet };
+  constexpr M Alu[]    = { M::Add, M::Adc, M::Sub, M::Sbc, M::And, M::Xor, M::Or, M::Cp };
+  constexpr M Akku[]   = { M::Rlca, M::Rrca, M::Rla, M::Rra, M::Daa, M::Cpl, M::Scf, M::Ccf };
+
+  constexpr u8 AluFlags = FlagZ|FlagN|FlagH|FlagC;
+  constexpr u8 AkkuFlags[] = {
+    FlagZ|FlagN|FlagH|FlagC, FlagZ|FlagN|FlagH|FlagC, FlagZ|FlagN|FlagH|FlagC, FlagZ|FlagN|FlagH|FlagC,
+    FlagZ|FlagH|FlagC, FlagN|FlagH, FlagN|FlagH|FlagC, FlagN|FlagH|FlagC,
+  };
+
+  constexpr u8 Branch = OpBranch;
+  constexpr u8 BranchIf = OpBranch|OpConditional;
+
+  // Illegal opcodes
+  constexpr auto illegal = info(M::Invalid, O::None, O::None, 1, 1, 0, OpInterruptState);
+
+  u8 x = op >> 6, y = (op >> 3) & 7, z = op & 7;
+  u8 p = y >> 1, q = y & 1;
+
+  // Memory cycles of an access to (hl) in place of a register
+  u8 hl_z = z == 6, hl_y = y == 6;
+
+  // OpWritesA when the register written to is A
+  u8 a_y = y == 7 ? OpWritesA : 0;
+
+  // The accumulator is explicit for add, adc and sbc, while
+  //   cp is the only one which doesn't write to it
+  auto alu = [&](O operand, u8 length, u8 cycles) {
+    bool explicit_a = y == 0 || y == 1 || y == 3;
+    u8 writes_a = y != 7 ? OpWritesA : 0;
+
+    return explicit_a ?
+      info(Alu[y], O::A, operand, length, cycles, AluFlags, writes_a) :
+      info(Alu[y], operand, O::None, length, cycles, AluFlags, writes_a);
+  };
+
+  switch(x) {
+  case 0:
+    switch(z) {
+    case 0:
+      switch(y) {
+      case 0: return info(M::Nop, O::None, O::None, 1, 1);
+      case 1: return info(M::Ld, O::Ptr16, O::SP, 3, 5);
+      case 2: return info(M::Stop, O::None, O::None, 2, 2, 0, OpInterruptState);
+      case 3: return info(M::Jr, O::Rel8, O::None, 2, 3, 0, Branch);
+      }
+
+      return info(M::Jr, Cond[y-4], O::Rel8, 2, 2, 3, 0, BranchIf);
+
+    case 1:
+      if(!q) return info(M::Ld, Reg16[p], O::Imm16, 3, 3);
+
+      return info(M::Add, O::HL, Reg16[p], 1, 2, FlagN|FlagH|FlagC);
+
+    case 2:
+      if(!q) return info(M::Ld, Ind[p], O::A, 1, 2);
+
+      return info(M::Ld, O::A, Ind[p], 1, 2, 0, OpWritesA);
+
+    case 3: return info(q ? M::Dec : M::Inc, Reg16[p], O::None, 1, 2);
+
+    case 4: return info(M::Inc, Reg8[y], O::None, 1, 1 + 2*hl_y, FlagZ|FlagN|FlagH, a_y);
+    case 5: return info(M::Dec, Reg8[y], O::None, 1, 1 + 2*hl_y, FlagZ|FlagN|FlagH, a_y);
+    case 6: return info(M::Ld, Reg8[y], O::Imm8, 2, 2 + hl_y, 0, a_y);
+
+    // All of them except for scf and ccf modify A
+    case 7: return info(Akku[y], O::None, O::None, 1, 1, AkkuFlags[y], y < 6 ? OpWritesA : 0);
+    }
+    break;
+
+  case 1:
+    if(op == 0x76) return info(M::Halt, O::None, O::None, 1, 1, 0, OpInterruptState);
+
+    return info(M::Ld, Reg8[y], Reg8[z], 1, 1 + (hl_y || hl_z), 0, a_y);
+
+  case 2: return alu(Reg8[z], 1, 1 + hl_z);
+
+  case 3:
+    switch(z) {
+    case 0:
+      switch(y) {
+      case 4: return info(M::Ldh, O::HighPtr8, O::A, 2, 3);
+      case 5: return info(M::Add, O::SP, O::Offset8, 2, 4, AluFlags);
+      case 6: return info(M::Ldh, O::A, O::HighPtr8, 2, 3, 0, OpWritesA);
+      case 7: return info(M::Ld, O::HL, O::SPOffset8, 2, 3, AluFlags);
+      }
+
+      return info(M::Ret, Cond[y], O::None, 1, 2, 5, 0, BranchIf|OpReturn);
+
+    case 1:
+      if(!q && p == 3) return info(M::Pop, O::AF, O::None, 1, 3, AluFlags, OpWritesA);
+      if(!q) return info(M::Pop, Reg16S[p], O::None, 1, 3);
+
+      switch(p) {
+      case 0: return info(M::Ret, O::None, O::None, 1, 4, 0, Branch|OpReturn);
+      case 1: return info(M::Reti, O::None, O::None, 1, 4, 0, Branch|OpReturn|OpInterruptState);
+      case 2: return info(M::Jp, O::HL, O::None, 1, 1, 0, Branch);
+      }
+
+      return info(M::Ld, O::SP, O::HL, 1, 2);
+
+    case 2:
+      switch(y) {
+      case 4: return info(M::Ldh, O::HighC, O::A, 1, 2);
+      case 5: return info(M::Ld, O::Ptr16, O::A, 3, 4);
+      case 6: return info(M::Ldh, O::A, O::HighC, 1, 2, 0, OpWritesA);
+      case 7: return info(M::Ld, O::A, O::Ptr16, 3, 4, 0, OpWritesA);
+      }
+
+      return info(M::Jp, Cond[y], O::Imm16, 3, 3, 4, 0, BranchIf);
+
+    case 3:
+      switch(y) {
+      case 0: return info(M::Jp, O::Imm16, O::None, 3, 4, 0, Branch);
+      case 1: return info(M::Invalid, O::None, O::None, 2, 0, 0, OpPrefix);
+      case 6: return info(M::Di, O::None, O::None, 1, 1, 0, OpInterruptState);
+      case 7: return info(M::Ei, O::None, O::None, 1, 1, 0, OpInterruptState);
+      }
+
+      return illegal;
+
+    case 4:
+      if(y < 4) return info(M::Call, Cond[y], O::Imm16, 3, 3, 6, 0, BranchIf|OpCall);
+
+      return illegal;
+
+    case 5:
+      if(!q) return info(M::Push, Reg16S[p], O::None, 1, 4);
+      if(p == 0) return info(M::Call, O::Imm16, O::None, 3, 6, 0, Branch|OpCall);
+
+      return illegal;
+
+    case 6: return alu(O::Imm8, 2, 2);
+    case 7: return info(M::Rst, O::RSTVector, O::None, 1, 4, 0, Branch|OpCall);
+    }
+    break;
+  }
+
+  return illegal;
+}
+
+constexpr auto decode_cb(u8 op) -> OpcodeInfo
+{
+  using M = Mnemonic;
+  using O = Operand;
+
+  constexpr O Reg8[] = { O::B, O::C, O::D, O::E, O::H, O::L, O::HLInd, O::A };
+  constexpr M Rot[]  = { M::Rlc, M::Rrc, M::Rl, M::Rr, M::Sla, M::Sra, M::Swap, M::Srl };
+
+  u8 x = op >> 6, y = (op >> 3) & 7, z = op & 7;
+
+  // (hl) takes an extra read, and another cycle for the
+  //   write back - which bit doesn't do
+  u8 hl = z == 6;
+
+  // Everything but bit writes the result back to the register
+  u8 a_z = z == 7 ? OpWritesA : 0;
+
+  switch(x) {
+  case 0: return info(Rot[y], Reg8[z], O::None, 2, 2 + 2*hl, FlagZ|FlagN|FlagH|FlagC, a_z);
+  case 1: return info(M::Bit, O::BitIndex, Reg8[z], 2, 2 + hl, FlagZ|FlagN|FlagH);
+  case 2: return info(M::Res, O::BitIndex, Reg8[z], 2, 2 + 2*hl, 0, a_z);
+  }
+
+  return info(M::Set, O::BitIndex, Reg8[z], 2, 2 + 2*hl, 0, a_z);
+}
+
+constexpr auto make_opcode_table() -> std::array<OpcodeInfo, 512>
+{
+  std::array<OpcodeInfo, 512> table = { };
+  for(unsigned op = 0; op < 256; op++) {
+    table[op] = decode(op);
+    table[0x100 | op] = decode_cb(op);
+  }
+
+  return table;
+}
+
+}
+
+// Metadata of every opcode, shared by the Processor's engines and
+//   the disassembler - the first 256 entries are indexed by the
+//   opcode, the rest by the opcode following a 0xCB prefix
+inline constexpr std::array<OpcodeInfo, 512> OpcodeTable = opcodes_detail::make_opcode_table();
+
+constexpr auto opcode_info(u8 op) -> const OpcodeInfo&
+{
+  return OpcodeTable[op];
+}
+
+constexpr auto opcode_info_cb(u8 op) -> const OpcodeInfo&
+{
+  return OpcodeTable[0x100 | op];
+}
+
+namespace opcodes_detail {
+
+// Indexed by Mnemonic, kept out of mnemonic_name() so it
+//   doesn't get rebuilt on the stack with every call
+inline constexpr const char *MnemonicNames[] = {
+  "<invalid>",
+  "nop",
+  "stop", "halt",
+  "jp", "jr",
+  "ld", "ldh",
+  "inc", "dec",
+  "rlca", "rla", "rrca", "rra",
+  "daa",
+  "cpl",
+  "scf", "ccf",
+  "add", "adc", "sub", "sbc",
+  "and", "or", "xor",
+  "cp",
+  "call",
+  "ret", "reti",
+  "push", "pop",
+  "ei", "di",
+  "rst",
+  "rlc", "rl", "rrc", "rr",
+  "sla", "sra", "srl",
+  "swap",
+  "bit", "res", "set",
+};
+
+static_assert(sizeof(MnemonicNames)/sizeof(MnemonicNames[0]) == (size_t)Mnemonic::NumMnemonics,
+    "MnemonicNames is missing some of the Mnemonics!");
+
+}
+
+// Returns the mnemonic as written in the disassembly
+constexpr auto mnemonic_name(Mnemonic mnemonic) -> const char *
+{
+  return mnemonic < Mnemonic::NumMnemonics ?
+    opcodes_detail::MnemonicNames[(size_t)mnemonic] : "<unknown>";
+}
+
+static_assert(opcode_info(0x00).cycles == 1 && opcode_info(0x20).cycles_taken == 3 && opcode_info(0xCD).cycles == 6 &&
+    opcode_info_cb(0x46).cycles == 3 && opcode_info_cb(0x86).cycles == 4,
+    "OpcodeTable has the wrong cycle counts!");
+
+// The forms which don't name A as their first operand, which
+//   RomDisassembler relies on to forget the bank number in A
+static_assert(opcode_info(0xB0).is(OpWritesA) && opcode_info(0xF6).is(OpWritesA) &&     // or b, or <n>
+    opcode_info(0x90).is(OpWritesA) && opcode_info(0xAF).is(OpWritesA) &&                // sub b, xor a
+    opcode_info(0x3C).is(OpWritesA) && opcode_info(0x2F).is(OpWritesA) &&                // inc a, cpl
+    opcode_info(0xF1).is(OpWritesA) && opcode_info_cb(0x37).is(OpWritesA) &&             // pop af, swap a
+    opcode_info_cb(0x87).is(OpWritesA) && opcode_info_cb(0xFF).is(OpWritesA) &&          // res 0, a, set 7, a
+    !opcode_info(0xFE).is(OpWritesA) && !opcode_info(0x37).is(OpWritesA) &&              // cp <n>, scf
+    !opcode_info(0x47).is(OpWritesA) && !opcode_info_cb(0x7F).is(OpWritesA),             // ld b, a, bit 7, a
+    "OpcodeTable has the wrong OpWritesA attributes!");
+
+}
@@ -0,0 +1,602 @@
+#pragma once
+
+// Definitions of the instruction handlers shared by all of the
+//   Processor's execution engines
+//  - Only meant to be included by the engines' sources
+
+#include <device/sm83/cpu.h>
+#include <device/sm83/instruction.h>
+#include <util/compiler.h>
+
+#define A rf.a
+#define B rf.b
+#define C rf.c
+#define D rf.d
+#define E rf.e
+#define H rf.h
+#define L rf.l
+
+#define ZF rf.f.z()
+#define NF rf.f.n()
+#define HF rf.f.h()
+#define CF rf.f.c()
+
+#define PC rf.pc
+#define SP rf.sp
+
+namespace brgb::sm83 {
+
+inline auto Processor::prologue() -> bool
+{
+  if(BRGB_UNLIKELY(run_state_ != RunState::Running)) {
+    if(run_state_ == RunState::HaltBug) {
+      haltBug();
+    } else {
+      idle();
+    }
+
+    return false;
+  }
+
+  // Interrupts get enabled right before the instruction
+  //   following 'ei' is executed, so they can only
+  //   be serviced after it
+  if(BRGB_UNLIKELY(ei_delay_)) {
+    ime_ = true;
+    ei_delay_ = false;
+
+    updateInterrupts();
+  }
+
+  return true;
+}
+
+inline auto Processor::breakpointAt(u16 pc) -> bool
+{
+  if(BRGB_LIKELY(!num_breakpoints_) || !breakpoints_[pc]) return false;
+
+  break_hit_ = true;
+  break_pc_ = pc;
+
+  return true;
+}
+
+inline auto Processor::interruptState() const -> unsigned
+{
+  return ime_ | ei_delay_ << 1 | irq_pending_ << 2 | (unsigned)run_state_ << 3;
+}
+
+inline auto Processor::opHALT() -> void
+{
+  // With IME == 0 and an interrupt already requested the
+  //   Processor doesn't halt, but the next opcode's byte
+  //   ends up being read twice (see haltBug())
+  if(!ime_ && irq_lines_) {
+    run_state_ = RunState::HaltBug;
+    return;
+  }
+
+  run_state_ = RunState::Halted;
+  updateInterrupts();
+}
+
+inline auto Processor::opcode(Registers& rf) -> u8
+{
+  return read(PC++);
+}
+
+template <Processor::Fetch F>
+inline auto Processor::operand8(Registers& rf) -> u8
+{
+  if constexpr(F == Fetch::Predecoded) {
+    idle();
+    PC++;
+
+    return *operands_++;
+  } else {
+    return read(PC++);
+  }
+}
+
+template <Processor::Fetch F>
+inline auto Processor::operand16(Registers& rf) -> u16
+{
+  u16 lo = operand8<F>(rf);
+  u16 hi = operand8<F>(rf);
+
+  return hi << 8 | lo;
+}
+
+inline auto Processor::push16(Registers& rf, u16 data) -> void
+{
+  write(--SP, data >> 8);
+  write(--SP, data & 0xFF);
+}
+
+inline auto Processor::pop16(Registers& rf) -> u16
+{
+  u16 lo = read(SP++);
+  u16 hi = read(SP++);
+
+  return hi << 8 | lo;
+}
+
+template <u8 Which>
+inline auto Processor::reg8(Registers& rf) -> u8
+{
+  static_assert(Which < 8);
+
+  if constexpr(Which == (u8)Reg8::b) return B;
+  else if constexpr(Which == (u8)Reg8::c) return C;
+  else if constexpr(Which == (u8)Reg8::d) return D;
+  else if constexpr(Which == (u8)Reg8::e) return E;
+  else if constexpr(Which == (u8)Reg8::h) return H;
+  else if constexpr(Which == (u8)Reg8::l) return L;
+  else if constexpr(Which == (u8)Reg8::HLIndirect) return read(rf.hl());
+  else return A;
+}
+
+template <u8 Which>
+inline auto Processor::reg8(Registers& rf, u8 val) -> void
+{
+  static_assert(Which < 8);
+
+  if constexpr(Which == (u8)Reg8::b) B = val;
+  else if constexpr(Which == (u8)Reg8::c) C = val;
+  else if constexpr(Which == (u8)Reg8::d) D = val;
+  else if constexpr(Which == (u8)Reg8::e) E = val;
+  else if constexpr(Which == (u8)Reg8::h) H = val;
+  else if constexpr(Which == (u8)Reg8::l) L = val;
+  else if constexpr(Which == (u8)Reg8::HLIndirect) write(rf.hl(), val);
+  else A = val;
+}
+
+template <u8 Which>
+inline auto Processor::reg16rp(Registers& rf) -> u16
+{
+  static_assert(Which < 4);
+
+  if constexpr(Which == (u8)Reg16_rp::bc) return rf.bc();
+  else if constexpr(Which == (u8)Reg16_rp::de) return rf.de();
+  else if constexpr(Which == (u8)Reg16_rp::hl) return rf.hl();
+  else return SP;
+}
+
+template <u8 Which>
+inline auto Processor::reg16rp(Registers& rf, u16 val) -> void
+{
+  static_assert(Which < 4);
+
+  if constexpr(Which == (u8)Reg16_rp::bc) rf.bc(val);
+  else if constexpr(Which == (u8)Reg16_rp::de) rf.de(val);
+  else if constexpr(Which == (u8)Reg16_rp::hl) rf.hl(val);
+  else SP = val;
+}
+
+template <u8 Which>
+inline auto Processor::reg16rp2(Registers& rf) -> u16
+{
+  static_assert(Which < 4);
+
+  if constexpr(Which == (u8)Reg16_rp2::af) return rf.af();
+  else return reg16rp<Which>(rf);
+}
+
+template <u8 Which>
+inline auto Processor::reg16rp2(Registers& rf, u16 val) -> void
+{
+  static_assert(Which < 4);
+
+  // The low nibble of F is hardwired to 0 (see Registers::af())
+  if constexpr(Which == (u8)Reg16_rp2::af) rf.af(val);
+  else reg16rp<Which>(rf, val);
+}
+
+template <u8 Which>
+inline auto Processor::cond(Registers& rf) -> bool
+{
+  static_assert(Which < 4);
+
+  if constexpr(Which == (u8)ConditionCode::nz) return !ZF;
+  else if constexpr(Which == (u8)ConditionCode::z) return ZF;
+  else if constexpr(Which == (u8)ConditionCode::nc) return !CF;
+  else return CF;
+}
+
+inline auto Processor::alu(Registers& rf, AluOp op, u8 val) -> void
+{
+  u8 a = A;
+  u8 carry = CF;
+
+  switch(op) {
+  case AluOp::Add: {
+    u16 result = a + val;
+
+    A = (u8)result;
+    rf.f.arith(a, val, result, false);
+    break;
+  }
+
+  case AluOp::Adc: {
+    u16 result = a + val + carry;
+
+    A = (u8)result;
+    rf.f.arith(a, val, result, false);
+    break;
+  }
+
+  case AluOp::Sub:
+  case AluOp::Cp: {
+    u16 result = a - val;
+
+    if(op == AluOp::Sub) A = (u8)result;
+    rf.f.arith(a, val, result, true);
+    break;
+  }
+
+  case AluOp::Sbc: {
+    u16 result = a - val - carry;
+
+    A = (u8)result;
+    rf.f.arith(a, val, result, true);
+    break;
+  }
+
+  case AluOp::And: A = a & val; rf.f.logic(a & val, true);  break;
+  case AluOp::Xor: A = a ^ val; rf.f.logic(a ^ val, false); break;
+  case AluOp::Or:  A = a | val; rf.f.logic(a | val, false); break;
+  }
+}
+
+inline auto Processor::rot(Registers& rf, RotOp op, u8 val) -> u8
+{
+  u8 carry = CF;
+
+  u8 result = 0;
+  bool carry_out = false;
+
+  switch(op) {
+  case RotOp::Rlc:  result = val << 1 | val >> 7;     carry_out = val & 0x80; break;
+  case RotOp::Rrc:  result = val >> 1 | val << 7;     carry_out = val & 0x01; break;
+  case RotOp::Rl:   result = val << 1 | carry;        carry_out = val & 0x80; break;
+  case RotOp::Rr:   result = val >> 1 | carry << 7;   carry_out = val & 0x01; break;
+  case RotOp::Sla:  result = val << 1;                carry_out = val & 0x80; break;
+  case RotOp::Sra:  result = val >> 1 | (val & 0x80); carry_out = val & 0x01; break;
+  case RotOp::Swap: result = val << 4 | val >> 4;     carry_out = false;      break;
+  case RotOp::Srl:  result = val >> 1;                carry_out = val & 0x01; break;
+  }
+
+  rf.f.shift(result, carry_out);
+
+  return result;
+}
+
+inline auto Processor::akku(Registers& rf, AkkuOp op) -> void
+{
+  u8 a = A;
+
+  switch(op) {
+  // Unlike their 0xCB-prefixed counterparts these always clear Z
+  case AkkuOp::Rlca: A = a << 1 | a >> 7;      rf.f.shift(A, a & 0x80, false); break;
+  case AkkuOp::Rrca: A = a >> 1 | a << 7;      rf.f.shift(A, a & 0x01, false); break;
+  case AkkuOp::Rla:  A = a << 1 | CF;          rf.f.shift(A, a & 0x80, false); break;
+  case AkkuOp::Rra:  A = a >> 1 | CF << 7;     rf.f.shift(A, a & 0x01, false); break;
+
+  case AkkuOp::Daa: {
+    bool carry = CF;
+
+    u8 adjust = 0;
+    if(!NF) {
+      if(HF || (a & 0x0F) > 0x09) adjust |= 0x06;
+      if(CF || a > 0x99) {
+        adjust |= 0x60;
+        carry = true;
+      }
+
+      a += adjust;
+    } else {
+      if(HF) adjust |= 0x06;
+      if(CF) adjust |= 0x60;
+
+      a -= adjust;
+    }
+
+    A = a;
+    rf.f.daa(a, carry);
+    break;
+  }
+
+  case AkkuOp::Cpl: A = ~a; rf.f.cpl(); break;
+  case AkkuOp::Scf: rf.f.scf(); break;
+  case AkkuOp::Ccf: rf.f.ccf(); break;
+  }
+}
+
+inline auto Processor::addHL(Registers& rf, u16 val) -> void
+{
+  u16 hl = rf.hl();
+  u32 result = hl + val;
+
+  rf.hl((u16)result);
+  rf.f.add16(hl, val, result);
+}
+
+inline auto Processor::addSP(Registers& rf, u8 val) -> u16
+{
+  u16 sp = SP;
+
+  // The flags are computed as if the addition was unsigned
+  //   and done on the low byte of sp only
+  rf.f.addSP(sp & 0xFF, val, (sp & 0xFF) + val);
+
+  return sp + (i8)val;
+}
+
+template <u8 Op, Processor::Fetch F>
+inline auto Processor::op(Registers& rf) -> void
+{
+  // See Instruction for the meaning of these
+  constexpr u8 x = Op >> 6;
+  constexpr u8 y = (Op >> 3) & 7;
+  constexpr u8 z = Op & 7;
+  constexpr u8 p = y >> 1;
+  constexpr u8 q = y & 1;
+
+  //  x=0
+  if constexpr(x == 0) {
+    if constexpr(z == 0) {
+      if constexpr(y == 0) {
+        //  nop
+      } else if constexpr(y == 1) {
+        //  ld (imm16), sp
+        u16 addr = operand16<F>(rf);
+
+        write(addr+0, SP & 0xFF);
+        write(addr+1, SP >> 8);
+      } else if constexpr(y == 2) {
+        //  stop
+        //   - Stays Stopped until resume()
+        operand8<F>(rf);
+        run_state_ = RunState::Stopped;
+      } else {
+        //  jr imm8
+        //  jr <cc>, imm8
+        i8 offset = operand8<F>(rf);
+
+        bool taken;
+        if constexpr(y == 3) taken = true;
+        else                 taken = cond<y-4>(rf);
+
+        if(taken) {
+          idle();
+          PC += offset;
+        }
+      }
+    } else if constexpr(z == 1) {
+      if constexpr(q == 0) {
+        //  ld <reg16>, imm16
+        reg16rp<p>(rf, operand16<F>(rf));
+      } else {
+        //  add hl, <reg16>
+        addHL(rf, reg16rp<p>(rf));
+        idle();
+      }
+    } else if constexpr(z == 2) {
+      //  ld (bc), a   ld (de), a   ld (hl+), a   ld (hl-), a
+      //  ld a, (bc)   ld a, (de)   ld a, (hl+)   ld a, (hl-)
+      u16 addr = p < 2 ? reg16rp<p>(rf) : rf.hl();
+
+      if constexpr(q == 0) write(addr, A);
+      else                 A = read(addr);
+
+      if constexpr(p == 2) rf.hl(addr + 1);
+      if constexpr(p == 3) rf.hl(addr - 1);
+    } else if constexpr(z == 3) {
+      //  inc <reg16>
+      //  dec <reg16>
+      if constexpr(q == 0) reg16rp<p>(rf, reg16rp<p>(rf) + 1);
+      else                 reg16rp<p>(rf, reg16rp<p>(rf) - 1);
+
+      idle();
+    } else if constexpr(z == 4) {
+      //  inc <reg8>
+      u8 val    = reg8<y>(rf);
+      u8 result = val + 1;
+
+      reg8<y>(rf, result);
+      rf.f.incdec(val, result, false);
+    } else if constexpr(z == 5) {
+      //  dec <reg8>
+      u8 val    = reg8<y>(rf);
+      u8 result = val - 1;
+
+      reg8<y>(rf, result);
+      rf.f.incdec(val, result, true);
+    } else if constexpr(z == 6) {
+      //  ld <reg8>, imm8
+      reg8<y>(rf, operand8<F>(rf));
+    } else {
+      //  rlca, rrca, rla, rra, daa, cpl, scf, ccf
+      akku(rf, (AkkuOp)y);
+    }
+
+  //  x=1
+  } else if constexpr(x == 1) {
+    if constexpr(y == 6 && z == 6) {
+      //  halt
+      opHALT();
+    } else {
+      //  ld <reg8>, <reg8>
+      reg8<y>(rf, reg8<z>(rf));
+    }
+
+  //  x=2
+  } else if constexpr(x == 2) {
+    //  add a, <reg8>   adc a, <reg8>   sub <reg8>   sbc a, <reg8>
+    //  and <reg8>      xor <reg8>      or <reg8>    cp <reg8>
+    alu(rf, (AluOp)y, reg8<z>(rf));
+
+  //  x=3
+  } else {
+    if constexpr(z == 0) {
+      if constexpr(y < 4) {
+        //  ret <cc>
+        idle();
+
+        if(cond<y>(rf)) {
+          PC = pop16(rf);
+          idle();
+        }
+      } else if constexpr(y == 4) {
+        //  ldh (0xFF00+imm8), a
+        write(0xFF00 | operand8<F>(rf), A);
+      } else if constexpr(y == 5) {
+        //  add sp, imm8
+        SP = addSP(rf, operand8<F>(rf));
+        idle(); idle();
+      } else if constexpr(y == 6) {
+        //  ldh a, (0xFF00+imm8)
+        A = read(0xFF00 | operand8<F>(rf));
+      } else {
+        //  ld hl, sp+imm8
+        rf.hl(addSP(rf, operand8<F>(rf)));
+        idle();
+      }
+    } else if constexpr(z == 1) {
+      if constexpr(q == 0) {
+        //  pop <reg16>
+        reg16rp2<p>(rf, pop16(rf));
+      } else if constexpr(p == 0 || p == 1) {
+        //  ret
+        //  reti
+        PC = pop16(rf);
+        idle();
+
+        if constexpr(p == 1) {
+          ime_ = true;
+          updateInterrupts();
+        }
+      } else if constexpr(p == 2) {
+        //  jp hl
+        PC = rf.hl();
+      } else {
+        //  ld sp, hl
+        SP = rf.hl();
+        idle();
+      }
+    } else if constexpr(z == 2) {
+      if constexpr(y < 4) {
+        //  jp <cc>, imm16
+        u16 addr = operand16<F>(rf);
+
+        if(cond<y>(rf)) {
+          idle();
+          PC = addr;
+        }
+      } else if constexpr(y == 4) {
+        //  ld (0xFF00+c), a
+        write(0xFF00 | C, A);
+      } else if constexpr(y == 5) {
+        //  ld (imm16), a
+        write(operand16<F>(rf), A);
+      } else if constexpr(y == 6) {
+        //  ld a, (0xFF00+c)
+        A = read(0xFF00 | C);
+      } else {
+        //  ld a, (imm16)
+        A = read(operand16<F>(rf));
+      }
+    } else if constexpr(z == 3 && y == 0) {
+      //  jp imm16
+      u16 addr = operand16<F>(rf);
+
+      idle();
+      PC = addr;
+    } else if constexpr(z == 3 && y == 1) {
+      //  0xCB prefix
+      (this->*OpTableCB[opcode(rf)])(rf);
+    } else if constexpr(z == 3 && y == 6) {
+      //  di
+      ime_ = ei_delay_ = false;
+      updateInterrupts();
+    } else if constexpr(z == 3 && y == 7) {
+      //  ei
+      ei_delay_ = !ime_;
+    } else if constexpr(z == 4 && y < 4) {
+      //  call <cc>, imm16
+      u16 addr = operand16<F>(rf);
+
+      if(cond<y>(rf)) {
+        idle();
+        push16(rf, PC);
+        PC = addr;
+      }
+    } else if constexpr(z == 5 && q == 0) {
+      //  push <reg16>
+      idle();
+      push16(rf, reg16rp2<p>(rf));
+    } else if constexpr(z == 5 && p == 0) {
+      //  call imm16
+      u16 addr = operand16<F>(rf);
+
+      idle();
+      push16(rf, PC);
+      PC = addr;
+    } else if constexpr(z == 6) {
+      //  add a, imm8   adc a, imm8   sub imm8   sbc a, imm8
+      //  and imm8      xor imm8      or imm8    cp imm8
+      alu(rf, (AluOp)y, operand8<F>(rf));
+    } else if constexpr(z == 7) {
+      //  rst <y*8>
+      idle();
+      push16(rf, PC);
+      PC = y*8;
+    } else {
+      //  ILLEGAL
+      //   - Locks up the Processor on real hardware
+      run_state_ = RunState::Locked;
+    }
+  }
+}
+
+template <u8 Op>
+inline auto Processor::opCB(Registers& rf) -> void
+{
+  constexpr u8 x = Op >> 6;
+  constexpr u8 y = (Op >> 3) & 7;
+  constexpr u8 z = Op & 7;
+
+  if constexpr(x == 0) {
+    //  rlc, rrc, rl, rr, sla, sra, swap, srl <reg8>
+    reg8<z>(rf, rot(rf, (RotOp)y, reg8<z>(rf)));
+  } else if constexpr(x == 1) {
+    //  bit <y>, <reg8>
+    u8 val = reg8<z>(rf);
+
+    rf.f.bit(val & (1<<y));
+  } else if constexpr(x == 2) {
+    //  res <y>, <reg8>
+    reg8<z>(rf, reg8<z>(rf) & ~(1<<y));
+  } else {
+    //  set <y>, <reg8>
+    reg8<z>(rf, reg8<z>(rf) | (1<<y));
+  }
+}
+
+}
+
+#undef SP
+#undef PC
+
+#undef CF
+#undef HF
+#undef NF
+#undef ZF
+
+#undef L
+#undef H
+#undef E
+#undef D
+#undef C
+#undef B
+#undef A
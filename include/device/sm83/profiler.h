@@ -0,0 +1,149 @@
+#pragma once
+
+#include <types.h>
+
+#include <memory>
+#include <array>
+#include <vector>
+#include <map>
+#include <unordered_map>
+#include <utility>
+#include <string>
+
+#include <cstdio>
+
+namespace brgb::sm83 {
+
+// Counts how many times (and for how many memory cycles) the
+//   instruction at every (memory bank, address) gets executed,
+//   and aggregates them into functions by following CALL/RST,
+//   interrupt dispatches and RET/RETI
+//  - Attached to a Processor with Processor::profiler(), which
+//    then feeds it every executed instruction - while none is
+//    attached profiling costs nothing
+//  - The memory banks are the ones returned by
+//    Processor::memoryBank(), code in Uncacheable memory
+//    is lumped together into a single bank
+class Profiler {
+public:
+  enum : unsigned {
+    PageSize = 256,
+
+    // Number of lines report() prints in each of it's sections
+    DefaultReportLines = 32,
+  };
+
+  // Counters of a single address
+  struct Entry {
+    u64 count;
+    u64 cycles;
+
+    // The instruction's bytes as seen on it's first execution,
+    //   valid only when 'known' == true (it's never set for
+    //   Uncacheable memory, as reading it could have side effects)
+    u8 code[3];
+    bool known;
+  };
+
+  // Counters of PageSize consecutive addresses of one memory bank,
+  //   indexed by the low bits of the address
+  struct Page {
+    u32 bank;
+    u16 base;
+
+    std::array<Entry, PageSize> entries;
+  };
+
+  Profiler();
+
+  // Drops all of the collected data and starts profiling over at
+  //   'cycles', called by Processor::profiler() when the Profiler
+  //   gets attached with the Processor's cycles() at that point
+  auto begin(u64 cycles) -> void;
+
+  // Returns the counters for the page of 'bank' starting at 'base'
+  //   (a multiple of PageSize), allocating them on first use
+  //  - The pointer stays valid until begin()
+  auto page(u32 bank, u16 base) -> Page *;
+
+  // Called right after a CALL/RST or an interrupt dispatch jumped
+  //   to 'addr' in 'bank', with 'sp' being the stack pointer before
+  //   the return address was pushed and 'cycles' the Processor's
+  //   cycles() at that point
+  auto call(u32 bank, u16 addr, u16 sp, u64 cycles) -> void;
+
+  // Called right after a RET/RETI popped the return address,
+  //   with 'sp' being the stack pointer after the pop
+  //  - Returns which don't match any of the calls (ex. ones used
+  //    as an indirect jump) are ignored
+  auto ret(u16 sp, u64 cycles) -> void;
+
+  // Prints a flat profile of the hottest instructions (disassembled)
+  //   and functions, followed by the call graph of the latter
+  //  - 'cycles' is the Processor's cycles() at the end of profiling,
+  //    which closes all of the calls which haven't returned yet
+  auto report(FILE *out, u64 cycles, unsigned lines = DefaultReportLines) const -> void;
+
+private:
+  // Functions are identified by the bank and address of their entry point
+  using FunctionKey = u64;
+
+  static auto key(u32 bank, u16 addr) -> u64;
+
+  // Returned by key() for the code which runs outside of any call
+  static constexpr FunctionKey RootFunction = ~0ull;
+
+  struct Function {
+    u64 calls;
+
+    // Cycles spent in the function's own instructions and in
+    //   total - including everything it called
+    //  - Recursive calls are only counted once towards 'inclusive'
+    u64 self, inclusive;
+
+    // Number of calls to the function which haven't returned yet
+    unsigned active;
+  };
+
+  struct Edge {
+    u64 calls, cycles;
+  };
+
+  struct Frame {
+    FunctionKey function;
+
+    // The stack pointer once the call returns
+    u16 sp;
+
+    // cycles() when the function was called and the ones spent
+    //   in the calls it made (which don't count towards 'self')
+    u64 start, children;
+  };
+
+  // Everything call()/ret() keep track of, copyable
+  //   so report() can close the calls on a copy
+  struct CallGraph {
+    std::unordered_map<FunctionKey, Function> functions;
+    std::map<std::pair<FunctionKey, FunctionKey>, Edge> edges;
+
+    // The calls which haven't returned yet, innermost last
+    std::vector<Frame> stack;
+
+    // Sum of the durations of the calls made from the RootFunction
+    u64 root_children;
+
+    // Closes the innermost call at 'cycles'
+    auto pop(u64 cycles) -> void;
+  };
+
+  auto functionName(FunctionKey function) const -> std::string;
+
+  std::unordered_map<u64, std::unique_ptr<Page>> pages_;
+
+  CallGraph graph_ = { };
+
+  // cycles() passed to begin(), i.e. when the RootFunction was entered
+  u64 start_ = 0;
+};
+
+}
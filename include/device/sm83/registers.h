@@ -1,57 +1,42 @@
 #pragma once
 
-#include <util/natural.h>
-#include <util/integer.h>
-#include <util/bit.h>
+#include <types.h>
+
+#include <device/sm83/flags.h>
+
+#include <type_traits>
 
 namespace brgb::sm83 {
 
-class Registers {
-public:
-  Natural<16> af;
-  Natural<16> bc;
-  Natural<16> de;
-  Natural<16> hl;
-
-  Natural<16> sp;
-  Natural<16> pc;
-
-  // AF
-  BitRange<16, 8, 15> a;
-  BitRange<16, 0, 7> f;
-
-  // BC
-  BitRange<16, 8, 15> b;
-  BitRange<16, 0, 7> c;
-
-  // DE
-  BitRange<16, 8, 15> d;
-  BitRange<16, 0, 7> e;
-
-  // HL
-  BitRange<16, 8, 15> h;
-  BitRange<16, 0, 7> l;
-
-  struct Flags {
-    Bit<16, 4> c;
-    Bit<16, 5> h;
-    Bit<16, 6> n;
-    Bit<16, 7> z;
-
-    Flags(Natural<16>& af) :
-      c(af.ptr()), h(af.ptr()), n(af.ptr()), z(af.ptr())
-    { }
-  } flags;
-
-  Registers() :
-    a(af.ptr()), f(af.ptr()),
-    b(bc.ptr()), c(bc.ptr()),
-    d(de.ptr()), e(de.ptr()),
-    h(hl.ptr()), l(hl.ptr()),
-    flags(af)
-  { }
-
-private:
+// The Processor's registers
+//   - Plain data (trivially copyable), so the execution
+//     engines can keep a copy in locals (leaving the host
+//     compiler free to allocate them to host registers),
+//     and snapshotting them is a memcpy()
+//   - The 8-bit registers are separate bytes, the 16-bit
+//     pairs are assembled by the accessors
+struct Registers {
+  u8 a;
+  Flags f;
+
+  u8 b, c;
+  u8 d, e;
+  u8 h, l;
+
+  u16 sp, pc;
+
+  inline auto af() const -> u16 { return a << 8 | f.byte(); }
+  inline auto bc() const -> u16 { return b << 8 | c; }
+  inline auto de() const -> u16 { return d << 8 | e; }
+  inline auto hl() const -> u16 { return h << 8 | l; }
+
+  inline auto af(u16 v) -> void { a = v >> 8; f.byte((u8)v); }
+  inline auto bc(u16 v) -> void { b = v >> 8; c = (u8)v; }
+  inline auto de(u16 v) -> void { d = v >> 8; e = (u8)v; }
+  inline auto hl(u16 v) -> void { h = v >> 8; l = (u8)v; }
 };
 
+static_assert(std::is_trivially_copyable_v<Registers>,
+    "sm83::Registers must be trivially copyable!");
+
 }
@@ -0,0 +1,143 @@
+#pragma once
+
+#include <types.h>
+
+#include <vector>
+#include <string>
+
+#include <cstddef>
+
+namespace brgb::sm83disasm {
+
+// Disassembles a whole cartridge ROM by following it's control flow
+//   from the entry points (0x0100, the rst and interrupt vectors),
+//   instead of sweeping over it linearly, so the data in between
+//   the code is told apart from it and comes out as 'db' directives
+//   - Every branch, call and rst target gets a label along with a
+//     list of the instructions which reference it (cross-references)
+//   - Bank 0 is mapped at 0x0000-0x3FFF and every other bank at
+//     0x4000-0x7FFF, which one is tracked through the 'ld a, <bank>'
+//     followed by 'ld (<0x2000-0x3FFF>), a' idiom - jumps into the
+//     switchable range without a known bank aren't followed
+//   - The banks are traversed in rounds, each one of which walks every
+//     bank with pending entry points on it's own thread, with the
+//     references between banks handed over in between the rounds
+//   - Computed jumps (ex. 'jp hl' through a table) aren't followed,
+//     which can be made up for with entryPoint()
+class RomDisassembler {
+public:
+  static constexpr unsigned BankSize = 16 * 1024;
+
+  // Base address of every bank except for bank 0
+  static constexpr u16 SwitchableBase = 0x4000;
+
+  // The bank isn't known
+  static constexpr unsigned UnknownBank = ~0u;
+
+  // Per-byte flags
+  enum : u8 {
+    ByteCode       = 1<<0,    // The first byte of an instruction
+    ByteOperand    = 1<<1,    // Any other byte of an instruction
+    ByteLabel      = 1<<2,    // The target of a branch (or an entry point)
+    ByteCallTarget = 1<<3,    // The target of a call or rst
+    ByteEntryPoint = 1<<4,
+  };
+
+  // An instruction at 'from' which branches to (or calls) 'to'
+  struct XRef {
+    unsigned to_bank;
+    u16 to;
+
+    unsigned from_bank;
+    u16 from;
+
+    bool call;
+  };
+
+  // 'rom' has to stay valid for as long as the RomDisassembler
+  //   is used, it's size is rounded down to whole banks
+  RomDisassembler(const u8 *rom, size_t size);
+
+  // Adds an entry point on top of the default ones, must
+  //   be called before analyze()
+  auto entryPoint(unsigned bank, u16 addr) -> RomDisassembler&;
+
+  // Traverses the code reachable from the entry points, on up
+  //   to 'num_threads' threads (all of the cores by default)
+  auto analyze(unsigned num_threads = 0) -> RomDisassembler&;
+
+  auto numBanks() const -> unsigned;
+
+  // Returns the address bank 'bank' is mapped at
+  static auto bankBase(unsigned bank) -> u16;
+
+  // Returns a combination of Byte* flags of the byte at 'addr' (which
+  //   must be inside of the bank's address range) after analyze()
+  auto flags(unsigned bank, u16 addr) const -> u8;
+
+  // Returns the references to instructions of 'bank', sorted
+  //   by their targets (and then the referencing instruction)
+  auto xrefs(unsigned bank) const -> const std::vector<XRef>&;
+
+  // Returns the references into the switchable bank range
+  //   which were made while the mapped bank wasn't known
+  auto unresolvedXRefs() const -> const std::vector<XRef>&;
+
+  // Returns the number of instructions found
+  auto numInstructions() const -> size_t;
+
+  // Writes the name of the label at 'addr' in 'bank' to 'buf'
+  //   and returns it's length (see Instruction::format())
+  static auto labelName(char *buf, size_t size, unsigned bank, u16 addr) -> size_t;
+
+  // Appends the listing of 'bank' to 'out', the code with labels and
+  //   cross-references as comments, and the data as 'db' directives
+  auto listBank(unsigned bank, std::string& out) const -> void;
+
+private:
+  // An address to start walking code from, along with
+  //   the bank mapped at 0x4000-0x7FFF at that point
+  struct Seed {
+    u16 addr;
+    unsigned mapped_bank;
+  };
+
+  struct Bank {
+    std::vector<u8> flags;
+
+    // Entry points waiting for the next round
+    std::vector<Seed> seeds;
+
+    // References made by the code in this bank, in the order the
+    //   instructions were found in and then (after analyze())
+    //   sorted by the referencing instruction
+    std::vector<XRef> refs;
+
+    // References to instructions in this bank, see xrefs()
+    std::vector<XRef> xrefs;
+
+    size_t instructions = 0;
+  };
+
+  // Walks all of the code reachable from the bank's seeds
+  auto walk(unsigned bank) -> void;
+
+  // Hands the references made during the last round to the banks
+  //   they point into as seeds for the next one
+  auto distribute() -> void;
+
+  auto offset(unsigned bank, u16 addr) const -> size_t;
+
+  const u8 *rom_;
+  unsigned num_banks_ = 0;
+
+  std::vector<Bank> banks_;
+
+  // How far into each Bank::refs the references were already
+  //   handed over by distribute()
+  std::vector<size_t> distributed_;
+
+  std::vector<XRef> unresolved_;
+};
+
+}
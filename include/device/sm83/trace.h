@@ -0,0 +1,140 @@
+#pragma once
+
+#include <types.h>
+#include <util/compiler.h>
+
+#include <array>
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+
+#include <cstdio>
+#include <cassert>
+
+namespace brgb::sm83 {
+
+// A single executed instruction, captured right before it's execution
+//  - Fixed-size, so the emulation thread only has to copy it into
+//    a buffer - the compression happens on another thread
+struct TraceRecord {
+  u64 cycle;    // Processor::cycles()
+
+  u16 pc, sp;
+  u16 af, bc, de, hl;
+
+  u8 opcode;
+  u8 ime;
+
+  u16 reserved;
+};
+
+static_assert(sizeof(TraceRecord) == 24, "sm83::TraceRecord must be 24 bytes!");
+
+// Writes the TraceRecords fed to it by a Processor (see Processor::tracer())
+//   to a file, compressed with a delta encoding which brings the ~24 bytes
+//   of a record down to ~5 on average
+//  - The records are collected into one of NumBuffers buffers, which once
+//    full gets handed off to a background thread for compression, while
+//    the next free one is filled - the emulation thread only ever waits
+//    when the background thread falls behind by all of them
+//  - Never drops records, a trace is either complete or failed
+class TraceWriter {
+public:
+  enum : size_t {
+    BufferRecords = 16*1024,
+    NumBuffers    = 4,
+  };
+
+  TraceWriter();
+  TraceWriter(const TraceWriter&) = delete;
+  ~TraceWriter();
+
+  // Creates (or truncates) the file and starts the background
+  //   thread, returns 'false' when the file couldn't be created
+  auto open(const char *file_name) -> bool;
+
+  // Writes out all the remaining records and closes the file, returns
+  //   'false' if any of the writes failed (ex. the disk is full)
+  //  - The writer has to be detached first (Processor::tracer(nullptr)),
+  //    as record() mustn't be called on a closed TraceWriter
+  auto close() -> bool;
+
+  auto record(const TraceRecord& record) -> void;
+
+  // Returns the number of records written since open()
+  auto records() const -> u64;
+
+private:
+  using Buffer = std::vector<TraceRecord>;
+
+  // Hands the current buffer off to the background
+  //   thread and switches to a free one
+  auto submit() -> void;
+
+  // Main function of the background thread
+  auto compressor() -> void;
+
+  FILE *file_ = nullptr;
+
+  std::thread thread_;
+
+  std::mutex mutex_;
+  std::condition_variable cv_;
+
+  std::array<Buffer, NumBuffers> buffers_;
+
+  // Buffers waiting to be compressed (in order) and the
+  //   ones free for writing (both guarded by 'mutex_')
+  std::vector<Buffer *> filled_, free_;
+
+  // Set by close() to stop the background thread
+  bool closing_ = false;
+  // Set by the background thread when a write failed
+  bool failed_ = false;
+
+  // The buffer currently being filled
+  Buffer *current_ = nullptr;
+  TraceRecord *cursor_ = nullptr, *end_ = nullptr;
+
+  u64 records_ = 0;
+};
+
+// Decodes the files written by a TraceWriter
+class TraceReader {
+public:
+  TraceReader() = default;
+  TraceReader(const TraceReader&) = delete;
+  ~TraceReader();
+
+  // Returns 'false' when the file couldn't be opened
+  //   or it isn't a trace
+  auto open(const char *file_name) -> bool;
+  auto close() -> void;
+
+  // Decodes the next record into 'record', returns 'false'
+  //   at the end of the trace (or if it's truncated)
+  auto next(TraceRecord& record) -> bool;
+
+private:
+  auto byte(u8& b) -> bool;
+  auto varint(u64& v) -> bool;
+  auto u16le(u16& v) -> bool;
+
+  FILE *file_ = nullptr;
+
+  // The previously decoded record, which
+  //   the next one is a delta of
+  TraceRecord last_ = { };
+};
+
+inline auto TraceWriter::record(const TraceRecord& record) -> void
+{
+  assert(file_ && "TraceWriter::record() called on a closed TraceWriter!");
+
+  *cursor_++ = record;
+
+  if(BRGB_UNLIKELY(cursor_ == end_)) submit();
+}
+
+}
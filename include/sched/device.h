@@ -22,6 +22,7 @@ public:
     Power,
     Tick, VideoFrame,
     Sync,
+    Breakpoint,
   };
 
   // Returns the number of clock ticks elapsed since
@@ -33,6 +34,10 @@ public:
   // Increments the clock()
   auto tick(Clock ticks = 1) -> ISchedDevice&;
 
+  // Converts a span of clock() into the number of ticks
+  //   it amounts to (i.e. the inverse of tick())
+  auto ticksIn(Clock clk) -> Clock;
+
   // Sets the device's clock frequency
   auto frequency(double freq) -> ISchedDevice&;
 
@@ -31,6 +31,11 @@ public:
 
   using DeviceEvent = ISchedDevice::Event;
 
+  enum : ISchedDevice::Clock {
+    // Returned by nextEvent() when there's only a single device
+    NoEvent = ~(ISchedDevice::Clock)0,
+  };
+
   auto threadById(Thread::Id id) -> Thread::Ptr;
 
   // Returns 'true' if the thread was successfully
@@ -65,6 +70,13 @@ public:
   auto syncWithAll() -> void;
   auto syncWith(ISchedDevice *device) -> void;
 
+  // Returns the clock of the device which will run next, after
+  //   the one currently running (the minimum of their clocks)
+  //  - None of the other devices can change their state before
+  //    the current device's clock goes past this point, as
+  //    they're only ever switched to once they're behind it
+  auto nextEvent() -> ISchedDevice::Clock;
+
 private:
   // If two threads have a clock of 0, it is ambiguous which one to
   //   select first, to resolve this an integer unique for each
@@ -0,0 +1,84 @@
+#pragma once
+
+#include <bus/bus.h>
+#include <bus/device.h>
+#include <bus/memorymap.h>
+#include <bus/mappedrange.h>
+
+#include <vector>
+#include <array>
+
+namespace brgb::gb {
+
+class Cartridge final : public IBusDevice {
+public:
+  static constexpr DeviceToken GameboyCartridgeDeviceToken = 0x0000'3000;
+
+  enum : unsigned {
+    RomBankSize = 16 * 1024,
+    RamBankSize = 8 * 1024,
+
+    MaxRamSize = 4 * RamBankSize,
+  };
+
+  // Memory bank controller types, as stored in the
+  //   header at 0x0147
+  enum Mapper : u8 {
+    RomOnly = 0x00,
+    MBC1 = 0x01, MBC1_Ram = 0x02, MBC1_RamBattery = 0x03,
+  };
+
+  // Everything which must be captured to later
+  //   restore the Cartridge to the exact same point
+  //  - The ROM itself is left out, as it never changes
+  struct State {
+    u8 rom_bank_lo, bank_hi;
+    u8 ram_enable, banking_mode;
+
+    std::array<u8, MaxRamSize> ram;
+  };
+
+  // Replaces the currently inserted ROM (if any)
+  auto load(std::vector<u8> rom) -> Cartridge&;
+
+  auto loaded() const -> bool;
+
+  virtual auto deviceToken() -> DeviceToken final;
+
+  // Maps the ROM, the external RAM and the mapper's
+  //   registers into the address space of 'target'
+  virtual auto attach(SystemBus *sys_bus, IBusDevice *target) -> DeviceMemoryMap* final;
+  virtual auto detach(DeviceMemoryMap *map) -> void final;
+
+  auto power() -> void;
+
+  // Returns the ROM bank currently mapped at 'addr'
+  //   (which must be in the 0x0000-0x7FFF range)
+  auto romBank(u16 addr) const -> unsigned;
+
+  // Returns a pointer to the ROM byte currently mapped at 'addr'
+  //   (0x0000-0x7FFF), which stays valid until the next load()
+  //  - Returns nullptr when no ROM has been loaded
+  auto romData(u16 addr) const -> const u8 *;
+
+  auto saveState(State& state) -> void;
+  auto loadState(const State& state) -> void;
+
+private:
+  auto mapper() const -> Mapper;
+
+  auto numRomBanks() const -> unsigned;
+  auto ramSize() const -> unsigned;
+
+  auto romReadHandler() -> BusReadHandler::ByteHandler;
+  auto mapperWriteHandler() -> BusWriteHandler::ByteHandler;
+
+  auto ramReadHandler() -> BusReadHandler::ByteHandler;
+  auto ramWriteHandler() -> BusWriteHandler::ByteHandler;
+
+  std::vector<u8> rom_;
+
+  State s_ = { };
+};
+
+}
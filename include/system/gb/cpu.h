@@ -1,16 +1,32 @@
 #pragma once
 
 #include <device/sm83/cpu.h>
+#include <system/gb/interrupts.h>
 
 #include <bus/bus.h>
 #include <bus/memorymap.h>
 
+#include <functional>
+
 namespace brgb::gb {
 
 class CPU final : public sm83::Processor {
 public:
   static constexpr DeviceToken GameboyCPUDeviceToken = 0x0000'1000;
 
+  // Returns the ROM bank mapped at 'addr' (0x0000-0x7FFF)
+  using RomBankFn = std::function<unsigned(u16 /* addr */)>;
+
+  // Returns a pointer to the ROM's 256 bytes currently mapped
+  //   at 'addr' (0x0000-0x7FFF, a multiple of 256) or nullptr
+  using RomDataFn = std::function<const u8 *(u16 /* addr */)>;
+
+  enum : unsigned {
+    // Only backward branches over at most this many bytes
+    //   are considered as possibly closing an idle loop
+    MaxIdleLoopBytes = 16,
+  };
+
   virtual auto deviceToken() -> DeviceToken final;
 
   virtual auto attach(SystemBus *sys_bus, IBusDevice *target = nullptr) -> DeviceMemoryMap* final;
@@ -19,12 +35,92 @@ public:
   virtual auto power() -> void final;
   virtual auto main() -> void final;
 
+  // Sets the interrupt controller, which must be done before
+  //   power() - dispatched interrupts get acknowledged there
+  auto interrupts(Interrupts *interrupts) -> CPU&;
+
+  // Lets the block cache tell apart code from different ROM
+  //   banks - without it the ROM is never cached
+  auto romBank(RomBankFn fn) -> CPU&;
+
+  // Lets the CPU read the ROM directly instead of through the
+  //   SystemBus, see remapRom()
+  auto romData(RomDataFn fn) -> CPU&;
+
+  // Maps 'size' bytes of plain RAM at 'addr' (both multiples of
+  //   256) straight to 'data', bypassing the SystemBus
+  auto mapRam(u16 addr, size_t size, u8 *data) -> CPU&;
+
+  // Must be called whenever the ROM banks mapped could've changed
+  //   without the CPU writing to the mapper (ex. on loadState())
+  auto remapRom() -> void;
+
+  // Hides sm83::Processor::loadState(), as the
+  //   idle loop being watched has to be forgotten
+  auto loadState(const State& state) -> void;
+
+  // When enabled (the default) idle loops - short loops which
+  //   only poll memory (ex. LY or an interrupt flag) without
+  //   writing anything - and HALT/STOP are fast-forwarded
+  //   up to the point where another device runs next
+  //  - Doesn't change the emulation's outcome in any way,
+  //    it can be disabled to make sure that's the case
+  auto idleSkip(bool enabled) -> CPU&;
+  auto idleSkip() const -> bool;
+
+  // Returns the number of t-cycles fast-forwarded through
+  //   idle loops and HALT/STOP since power()
+  auto skippedCycles() const -> u64;
+
 protected:
-  virtual auto read(u16 addr) -> u8 final;
-  virtual auto write(u16 addr, u8 data) -> void final;
+  virtual auto busRead(u16 addr) -> u8 final;
+  virtual auto busWrite(u16 addr, u8 data) -> void final;
+
+  virtual auto memoryBank(u16 addr) -> u32 final;
+  virtual auto peek(u16 addr) -> u8 final;
 
 private:
+  // Services a pending interrupt (if there is one), executes the
+  //   instructions up to 'next_event' and accounts for them in
+  //   the clock()
+  auto step(Clock next_event) -> void;
+
+  // Called after a short backward branch to 'pc()', does
+  //   the fast-forwarding when it closes an idle loop
+  auto idleLoop() -> void;
+
+  // Called after each instruction (or idle() memory cycle)
+  //   executed while the CPU isn't RunState::Running
+  auto haltSkip() -> void;
+
+  // Advances the clock() by the memory cycles the
+  //   Processor spent since the last call
+  auto catchUp() -> void;
+
+  Interrupts *interrupts_ = nullptr;
+
+  RomBankFn rom_bank_;
+  RomDataFn rom_data_;
+
+  // The cycles() already accounted for in the clock()
+  u64 ticked_ = 0;
+
+  bool idle_skip_ = true;
+
+  // The state at the (possible) idle loop's last iteration
+  struct IdleLoop {
+    // Cleared when the loop has to be forgotten
+    bool valid;
+
+    State state;
+    u64 writes;
+
+    Clock clock, next_event;
+  };
+
+  IdleLoop idle_loop_ = { };
 
+  u64 skipped_cycles_ = 0;
 };
 
 }
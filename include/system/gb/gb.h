@@ -6,9 +6,14 @@
 #include <sched/scheduler.h>
 
 #include <system/gb/cpu.h>
+#include <system/gb/ppu.h>
+#include <system/gb/cartridge.h>
+#include <system/gb/joypad.h>
+#include <system/gb/interrupts.h>
 
 #include <memory>
 #include <array>
+#include <vector>
 
 namespace brgb {
 
@@ -16,6 +21,22 @@ class Gameboy {
 public:
   static constexpr double SystemClock = 4.0 * 1024*1024;   // ~4MHz
 
+  // Plain data snapshot of the whole system
+  //  - Has a fixed size, which allows snapshots to be
+  //    cheaply diffed against each other (see Rewind)
+  struct State {
+    sm83::Processor::State cpu;
+    gb::PPU::State ppu;
+    gb::Cartridge::State cartridge;
+    gb::Joypad::State joypad;
+    gb::Interrupts::State interrupts;
+
+    std::array<u8, 8192> wram;
+    std::array<u8, 128>  hram;
+
+    ISchedDevice::Clock cpu_clock, ppu_clock;
+  };
+
   Gameboy();
 
   // Connects all the devices to the SystemBus and
@@ -24,10 +45,97 @@ public:
 
   auto power() -> void;
 
+  // Insert a cartridge with the given ROM image
+  //   - Must be called before power()
+  auto loadCartridge(std::vector<u8> rom) -> Gameboy&;
+
+  // Run the emulation until the PPU finishes drawing a frame
+  //   and then bring all the devices to a sync point, so
+  //   the system's state can be safely saved/restored
+  //  - With run-ahead enabled the framebuffer() will show
+  //    the frame 'runAhead()' frames in the future, though
+  //    the emulation itself still advances by a single frame
+  //  - When 'render' == false the framebuffer() is left untouched,
+  //    which makes skipping frames (ex. when running faster
+  //    than real-time) considerably cheaper
+  auto runFrame(bool render = true) -> void;
+
+  // Set the number of frames the displayed frame is ahead of
+  //   the emulation, which cuts the perceived input latency
+  //   by as many frames (0 disables run-ahead)
+  //  - Every run-ahead frame costs a whole emulated frame
+  auto runAhead(unsigned frames) -> Gameboy&;
+
+  // Set the currently pressed buttons (a bitmask of gb::Joypad::Button),
+  //   which will be used until the next call
+  auto input(u8 buttons) -> Gameboy&;
+
+  // Selects the CPU's execution engine (see sm83::Processor::Engine)
+  auto cpuEngine(sm83::Processor::Engine engine) -> Gameboy&;
+
+  // Enables/disables fast-forwarding through the CPU's idle
+  //   loops and HALT/STOP (see gb::CPU::idleSkip()), enabled
+  //   by default
+  auto cpuIdleSkip(bool enabled) -> Gameboy&;
+
+  // Returns the number of CPU t-cycles which were fast-forwarded
+  //   through idle loops and HALT/STOP since power()
+  auto cpuSkippedCycles() -> u64;
+
+  // Attaches a Profiler to the CPU (see sm83::Processor::profiler()),
+  //   nullptr detaches it
+  //  - Run-ahead frames are profiled as well, so it's best
+  //    disabled while profiling
+  auto cpuProfiler(sm83::Profiler *profiler) -> Gameboy&;
+
+  // Attaches a TraceWriter to the CPU (see sm83::Processor::tracer()),
+  //   nullptr detaches it
+  //  - As with cpuProfiler() run-ahead frames get traced too
+  auto cpuTracer(sm83::TraceWriter *tracer) -> Gameboy&;
+
+  // Breakpoints stop the emulation right before the CPU executes the
+  //   instruction at 'addr' (in any ROM/RAM bank), which makes
+  //   runFrame() return early with breakpointHit() == true
+  //  - The next runFrame() resumes the frame from that point,
+  //    though saveState() can't be used until it's finished
+  //  - Can't be used together with run-ahead
+  //  - See sm83::Processor::addBreakpoint() for the
+  //    performance implications
+  auto addBreakpoint(u16 addr) -> Gameboy&;
+  auto removeBreakpoint(u16 addr) -> Gameboy&;
+  auto clearBreakpoints() -> Gameboy&;
+
+  // Returns 'true' when the last runFrame() was
+  //   stopped short by a breakpoint
+  auto breakpointHit() -> bool;
+
+  // Returns the CPU's registers, which unlike saveState()
+  //   can also be done when stopped at a breakpoint
+  auto cpuState() -> sm83::Processor::State;
+
+  // Returns the number of CPU memory cycles (4 t-cycles
+  //   each) since power(), ex. for Profiler::report()
+  auto cpuCycles() -> u64;
+
+  auto framebuffer() -> const gb::PPU::Framebuffer&;
+
+  // Both of these can ONLY be called in-between frames
+  //   i.e. after power() or runFrame()
+  auto saveState(State& state) -> void;
+  auto loadState(const State& state) -> void;
+
 private:
+  // Run until the next VideoFrame and a sync point after it
+  //   - The framebuffer is only drawn to when 'render' == true
+  auto emulateFrame(bool render) -> void;
+
   auto sysBus() -> SystemBus&;
 
   auto cpu() -> gb::CPU&;
+  auto ppu() -> gb::PPU&;
+  auto cartridge() -> gb::Cartridge&;
+  auto joypad() -> gb::Joypad&;
+  auto interrupts() -> gb::Interrupts&;
 
   auto wramReadHandler() -> BusReadHandler::ByteHandler;
   auto wramWriteHandler() -> BusWriteHandler::ByteHandler;
@@ -45,6 +153,16 @@ private:
 
   // All the system's devices
   std::unique_ptr<gb::CPU> cpu_;
+  std::unique_ptr<gb::PPU> ppu_;
+  std::unique_ptr<gb::Cartridge> cartridge_;
+  std::unique_ptr<gb::Joypad> joypad_;
+  std::unique_ptr<gb::Interrupts> interrupts_;
+
+  unsigned run_ahead_ = 0;
+
+  // The state to roll back to after running ahead, allocated
+  //   up front to keep runFrame() allocation-free
+  std::unique_ptr<State> run_ahead_state_;
 
   std::array<u8, 8192> wram_;
   std::array<u8, 128>  hram_;
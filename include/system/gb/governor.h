@@ -0,0 +1,88 @@
+#pragma once
+
+#include <types.h>
+
+#include <chrono>
+
+namespace brgb {
+
+// Paces the emulation to the host's wall clock and decides
+//   which of the emulated frames are worth rendering
+//  - In the fast modes (Nx and Unlimited) most frames are
+//    only emulated, as the host can't display them anyway,
+//    which leaves more time for the emulation itself
+//  - Skipped frames still go through the whole PPU timing,
+//    so the registers observed by games (LY, STAT...)
+//    behave as usual
+class Governor {
+public:
+  using Clock = std::chrono::steady_clock;
+
+  enum Mode {
+    RealTime,   // Run at the Gameboy's native speed (1x)
+    Fast,       // Run at multiplier() times the native speed
+    Unlimited,  // Run as fast as the host allows
+  };
+
+  // Native frame rate of the Gameboy ~59.73Hz
+  static constexpr double FrameRate = (4.0 * 1024*1024) / 70224.0;
+
+  // Frame rate at which frames are presented in the
+  //   Unlimited mode
+  static constexpr double PresentRate = 60.0;
+
+  // Interval between updates of fps() and speed()
+  static constexpr double StatsInterval = 0.5;
+
+  Governor();
+
+  auto mode() const -> Mode;
+  auto mode(Mode m) -> Governor&;
+
+  auto multiplier() const -> unsigned;
+  // Sets the speed multiplier used in the Fast mode
+  auto multiplier(unsigned m) -> Governor&;
+
+  // Must be called before emulating each frame, returns
+  //   'true' if the frame should be rendered and presented
+  auto beginFrame() -> bool;
+
+  // Must be called after emulating each frame - blocks
+  //   until it's time to emulate the next one
+  auto endFrame() -> void;
+
+  // Frames presented to the host per second
+  auto fps() const -> double;
+
+  // The emulated speed as a percentage of the Gameboy's
+  //   native speed (i.e. 100.0 at 1x)
+  auto speed() const -> double;
+
+private:
+  // Duration of a single emulated frame at the current speed
+  auto framePeriod() const -> Clock::duration;
+
+  // Restart pacing from the current point in time
+  auto resync() -> void;
+
+  auto updateStats(Clock::time_point now) -> void;
+
+  Mode mode_ = RealTime;
+  unsigned multiplier_ = 4;
+
+  // When the next frame is due to begin
+  Clock::time_point deadline_;
+  Clock::time_point last_present_;
+
+  bool present_ = true;
+
+  // Counters since 'stats_start_'
+  Clock::time_point stats_start_;
+  unsigned emulated_frames_ = 0;
+  unsigned presented_frames_ = 0;
+
+  double fps_ = 0.0;
+  double speed_ = 0.0;
+};
+
+}
@@ -0,0 +1,68 @@
+#pragma once
+
+#include <bus/bus.h>
+#include <bus/device.h>
+#include <bus/memorymap.h>
+#include <bus/mappedrange.h>
+
+#include <device/sm83/cpu.h>
+
+namespace brgb::gb {
+
+// Holds the IF (requested) and IE (enabled) registers and keeps the
+//   Processor's interruptLines() in sync with them, which is all
+//   the CPU needs to check for interrupts once per instruction
+//  - IME and the EI delay are a part of the sm83::Processor
+class Interrupts final : public IBusDevice {
+public:
+  static constexpr DeviceToken GameboyInterruptsDeviceToken = 0x0000'5000;
+
+  // The bit of each source in IF/IE, ordered by priority
+  enum Source : u8 {
+    VBlank = 0, Stat = 1, Timer = 2, Serial = 3, Joypad = 4,
+  };
+
+  // Everything which must be captured to later
+  //   restore the Interrupts to the exact same point
+  struct State {
+    u8 requested, enabled;
+  };
+
+  virtual auto deviceToken() -> DeviceToken final;
+
+  // Maps IF (0xFF0F) and IE (0xFFFF) into the address space of 'target'
+  virtual auto attach(SystemBus *sys_bus, IBusDevice *target) -> DeviceMemoryMap* final;
+  virtual auto detach(DeviceMemoryMap *map) -> void final;
+
+  // Sets the Processor which gets it's interruptLines() updated
+  auto processor(sm83::Processor *processor) -> Interrupts&;
+
+  auto power() -> void;
+
+  // Requests the interrupt (sets it's bit in IF), which is how
+  //   the other devices raise their interrupt lines
+  auto raise(Source source) -> void;
+
+  // Clears the interrupt's bit in IF, after the
+  //   Processor has dispatched it
+  auto acknowledge(unsigned irq) -> void;
+
+  auto saveState(State& state) -> void;
+  auto loadState(const State& state) -> void;
+
+private:
+  // Passes IF & IE on to the Processor
+  auto update() -> void;
+
+  auto ifReadHandler() -> BusReadHandler::ByteHandler;
+  auto ifWriteHandler() -> BusWriteHandler::ByteHandler;
+
+  auto ieReadHandler() -> BusReadHandler::ByteHandler;
+  auto ieWriteHandler() -> BusWriteHandler::ByteHandler;
+
+  sm83::Processor *processor_ = nullptr;
+
+  State s_ = { };
+};
+
+}
@@ -0,0 +1,73 @@
+#pragma once
+
+#include <bus/bus.h>
+#include <bus/device.h>
+#include <bus/memorymap.h>
+#include <bus/mappedrange.h>
+
+#include <device/sm83/cpu.h>
+#include <system/gb/interrupts.h>
+
+namespace brgb::gb {
+
+class Joypad final : public IBusDevice {
+public:
+  static constexpr DeviceToken GameboyJoypadDeviceToken = 0x0000'4000;
+
+  // Bitmask of pressed buttons passed to buttons()
+  enum Button : u8 {
+    Right  = 1<<0, Left = 1<<1, Up     = 1<<2, Down  = 1<<3,
+    A      = 1<<4, B    = 1<<5, Select = 1<<6, Start = 1<<7,
+  };
+
+  // Everything which must be captured to later
+  //   restore the Joypad to the exact same point
+  //  - The pressed buttons are left out, as they're
+  //    an input rather than a part of the system
+  struct State {
+    u8 select;
+  };
+
+  virtual auto deviceToken() -> DeviceToken final;
+
+  // Maps the P1 register into the address space of 'target'
+  virtual auto attach(SystemBus *sys_bus, IBusDevice *target) -> DeviceMemoryMap* final;
+  virtual auto detach(DeviceMemoryMap *map) -> void final;
+
+  // Sets the interrupt controller, which gets the Joypad interrupt
+  //   requested whenever one of the selected lines goes low
+  auto interrupts(Interrupts *interrupts) -> Joypad&;
+
+  // Sets the Processor which gets woken up from STOP by
+  //   a button press (see sm83::Processor::resume())
+  auto processor(sm83::Processor *processor) -> Joypad&;
+
+  auto power() -> void;
+
+  // Set the currently pressed buttons (a bitmask of Button)
+  auto buttons(u8 pressed) -> Joypad&;
+
+  auto saveState(State& state) -> void;
+  auto loadState(const State& state) -> void;
+
+private:
+  // Returns the P10-P13 lines pulled low by the pressed
+  //   buttons of the selected groups (as set bits)
+  auto lines() const -> u8;
+
+  // Requests the interrupt and wakes the Processor up from STOP
+  //   when any of the lines went low since 'last_lines'
+  auto update(u8 last_lines) -> void;
+
+  auto regReadHandler() -> BusReadHandler::ByteHandler;
+  auto regWriteHandler() -> BusWriteHandler::ByteHandler;
+
+  Interrupts *interrupts_ = nullptr;
+  sm83::Processor *processor_ = nullptr;
+
+  u8 pressed_ = 0;
+
+  State s_ = { };
+};
+
+}
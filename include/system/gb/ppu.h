@@ -0,0 +1,120 @@
+#pragma once
+
+#include <bus/bus.h>
+#include <bus/device.h>
+#include <bus/memorymap.h>
+#include <bus/mappedrange.h>
+#include <sched/device.h>
+
+#include <system/gb/interrupts.h>
+
+#include <array>
+
+namespace brgb::gb {
+
+// The PPU yields an ISchedDevice::VideoFrame at the
+//   start of each VBlank, which gives the emulation
+//   a notion of a video frame
+//  - Only the background layer is rendered for now
+class PPU final : public IBusDevice, public ISchedDevice {
+public:
+  static constexpr DeviceToken GameboyPPUDeviceToken = 0x0000'2000;
+
+  enum : unsigned {
+    ScreenWidth  = 160,
+    ScreenHeight = 144,
+
+    DotsPerLine   = 456,
+    LinesPerFrame = 154,
+
+    DotsPerFrame = DotsPerLine * LinesPerFrame,
+
+    // Length (in dots) of each of the visible line's phases
+    OAMSearchDots = 80,
+    TransferDots  = 172,
+    HBlankDots    = DotsPerLine - OAMSearchDots - TransferDots,
+  };
+
+  // Encoded in bits 0-1 of the STAT register
+  enum Mode : u8 {
+    HBlank = 0, VBlank = 1, OAMSearch = 2, Transfer = 3,
+  };
+
+  // Each pixel holds a shade (0-3) i.e. a color after
+  //   being mapped through a palette
+  using Framebuffer = std::array<u8, ScreenWidth*ScreenHeight>;
+
+  // Everything which must be captured to later
+  //   restore the PPU to the exact same point
+  //  - Plain data, so it can be freely copied around
+  struct State {
+    u8 lcdc, stat, scy, scx, ly, lyc, bgp, obp0, obp1, wy, wx;
+    u8 mode;
+
+    // The STAT interrupt is requested on it's rising edge
+    u8 stat_line;
+
+    std::array<u8, 8192> vram;
+    std::array<u8, 160> oam;
+  };
+
+  virtual auto deviceToken() -> DeviceToken final;
+
+  // Maps VRAM, OAM and the PPU's registers into
+  //   the address space of 'target'
+  virtual auto attach(SystemBus *sys_bus, IBusDevice *target) -> DeviceMemoryMap* final;
+  virtual auto detach(DeviceMemoryMap *map) -> void final;
+
+  virtual auto power() -> void final;
+  virtual auto main() -> void final;
+
+  // Sets where the VBlank and STAT interrupts are requested
+  auto interrupts(Interrupts *interrupts) -> PPU&;
+
+  // When 'false' the framebuffer isn't touched, but the
+  //   PPU's timing and registers behave as usual
+  auto render(bool enabled) -> PPU&;
+
+  auto framebuffer() const -> const Framebuffer&;
+
+  auto saveState(State& state) -> void;
+  auto loadState(const State& state) -> void;
+
+private:
+  // Advance the PPU's clock by 'dots' and allow
+  //   the other devices to catch up
+  auto step(unsigned dots) -> void;
+
+  // Switches to 'mode' and updates the STAT interrupt line
+  auto enterMode(Mode mode) -> void;
+
+  // Requests the STAT interrupt when any of it's enabled
+  //   conditions (ex. LY == LYC) became true
+  auto updateStat() -> void;
+
+  // Draws the current line (LY) into the framebuffer
+  auto renderLine() -> void;
+
+  auto readRegister(u16 reg) -> u8;
+  auto writeRegister(u16 reg, u8 data) -> void;
+
+  auto vramReadHandler() -> BusReadHandler::ByteHandler;
+  auto vramWriteHandler() -> BusWriteHandler::ByteHandler;
+
+  auto oamReadHandler() -> BusReadHandler::ByteHandler;
+  auto oamWriteHandler() -> BusWriteHandler::ByteHandler;
+
+  auto regReadHandler() -> BusReadHandler::ByteHandler;
+  auto regWriteHandler() -> BusWriteHandler::ByteHandler;
+
+  State s_ = { };
+
+  Interrupts *interrupts_ = nullptr;
+
+  bool render_ = true;
+
+  // NOT a part of the State, as it's purely an output
+  Framebuffer framebuffer_ = { };
+};
+
+}
@@ -0,0 +1,87 @@
+#pragma once
+
+#include <types.h>
+#include <system/gb/gb.h>
+
+#include <memory>
+#include <vector>
+
+namespace brgb {
+
+// Keeps a history of Gameboy::State snapshots in a ring of
+//   fixed size, which allows stepping back in time
+//  - Only the newest snapshot is kept in full, all the older
+//    ones are stored as a run-length encoded XOR of two
+//    consecutive snapshots (a delta), which is usually tiny
+//  - Stepping back a single snapshot is a matter of XOR-ing
+//    the newest delta into the full snapshot, so it's cheap
+//    enough to do multiple times per displayed frame
+class Rewind {
+public:
+  // 'buffer_size' is the amount of memory (in bytes) reserved
+  //   for the deltas, 'interval' is the number of frames
+  //   between consecutive snapshots
+  Rewind(Gameboy *gb, size_t buffer_size, unsigned interval = 4);
+
+  // Must be called after each Gameboy::runFrame(), so
+  //   snapshots can be taken every 'interval' frames
+  auto frame() -> Rewind&;
+
+  // Capture a snapshot regardless of the 'interval'
+  auto capture() -> Rewind&;
+
+  // Load the snapshot preceding the most recently loaded/captured
+  //   one into the Gameboy
+  //  - Returns 'false' when the history has been exhausted, in
+  //    which case the oldest snapshot is loaded instead
+  auto step() -> bool;
+
+  // Discards all the snapshots
+  auto reset() -> Rewind&;
+
+  // Returns the number of snapshots which can be step()-ed back to
+  auto depth() const -> size_t;
+
+private:
+  // Location of an encoded delta inside 'buffer_'
+  struct Delta {
+    size_t offset, size;
+  };
+
+  // RLE-encodes 'a' XOR 'b' into 'out' and returns the size
+  //   of the output in bytes
+  //  - 'out' must be at least MaxEncodedSize bytes long
+  static auto encode(const u8 *a, const u8 *b, u8 *out) -> size_t;
+
+  // XOR-s a delta produced by encode() into 'state'
+  static auto apply(const u8 *delta, size_t size, u8 *state) -> void;
+
+  // Reserve 'size' bytes in 'buffer_' for a new Delta,
+  //   evicting the oldest ones when needed
+  auto allocate(size_t size) -> size_t;
+
+  auto evictOldest() -> void;
+
+  Gameboy *gb_;
+
+  unsigned interval_;
+  unsigned frame_counter_ = 0;
+
+  // The newest snapshot - kept in full
+  std::unique_ptr<Gameboy::State> head_;
+  bool has_head_ = false;
+
+  // Scratch space for capture()
+  std::unique_ptr<Gameboy::State> current_;
+  std::vector<u8> scratch_;
+
+  std::vector<u8> buffer_;
+
+  // Ring of Deltas stored in 'buffer_' ordered from the
+  //   oldest one ('first_delta_') to the newest one
+  std::vector<Delta> deltas_;
+  size_t first_delta_ = 0;
+  size_t num_deltas_ = 0;
+};
+
+}
@@ -40,6 +40,7 @@
 #include <bus/memorymap.h>
 #include <sched/device.h>
 #include <system/gb/gb.h>
+#include <system/gb/governor.h>
 
 #include <unistd.h>
 #include <fcntl.h>
@@ -103,6 +104,27 @@ auto load_bootrom() -> std::optional<std::vector<uint8_t>>
   return bootrom;
 }
 
+auto load_rom(const char *file_name) -> std::optional<std::vector<uint8_t>>
+{
+  auto fd = open(file_name, O_RDONLY);
+  if(fd < 0) return std::nullopt;
+
+  struct stat st;
+  if(fstat(fd, &st) < 0) {
+    close(fd);
+    return std::nullopt;
+  }
+
+  std::vector<uint8_t> rom(st.st_size);
+  if(read(fd, rom.data(), rom.size()) < 0) {
+    close(fd);
+    return std::nullopt;
+  }
+
+  close(fd);
+  return rom;
+}
+
 auto test_system() -> void
 {
   Gameboy gb;
@@ -233,6 +255,27 @@ R"FRAG(
     .drawQuad({ 50, 35 }, { 50, 70 }, &qs, {})
     .writeString({ 0, 30 }, "hello, world!", Color::red());
 
+  OSDSurface stats_surface;
+  stats_surface
+    .create({ window_geometry.w, window_geometry.h }, &topaz);
+
+  Gameboy gb;
+  if(argc > 1) {
+    auto rom = load_rom(argv[1]);
+    if(!rom) {
+      printf("couldn't load ROM `%s'!\n", argv[1]);
+      return -1;
+    }
+
+    gb.loadCartridge(std::move(*rom));
+  }
+
+  gb
+    .init()
+    .power();
+
+  Governor governor;
+
   glViewport(0, 0, window_geometry.w, window_geometry.h);
   
   bool running = true;
@@ -255,6 +298,11 @@ R"FRAG(
       if(sym == 'q') running = false;
 
       if(sym == 'f') use_fence = !use_fence;
+
+      // Speed controls
+      if(sym == '1') governor.mode(Governor::RealTime);
+      if(sym == '2') governor.mode(Governor::Fast);
+      if(sym == '3') governor.mode(Governor::Unlimited);
       break;
     }
 
@@ -284,10 +332,27 @@ R"FRAG(
       break;
     }
 
+    // Skipped frames are still fully emulated, only
+    //   rendering and presenting them is omitted
+    bool present = governor.beginFrame();
+    gb.runFrame(present);
+
+    if(!present) {
+      governor.endFrame();
+      continue;
+    }
+
     gl_context.dbg_PushCallGroup("OSD.some_surface");
 
     glClear(GL_COLOR_BUFFER_BIT);
 
+    char stats[64];
+    snprintf(stats, sizeof(stats), "%5.1f fps %4.0f%%", governor.fps(), governor.speed());
+
+    stats_surface
+      .clear()
+      .writeString({ 0, window_geometry.h - 16 }, stats, Color::white());
+
     /*
     auto drawcall = osd_drawcall_strings(
         &vertex_array, GLType::u16, &text_index_buf, 0,
@@ -304,6 +369,10 @@ R"FRAG(
       osd_submit_drawcall(gl_context, drawcall);
     }
 
+    for(auto& drawcall : stats_surface.draw()) {
+      osd_submit_drawcall(gl_context, drawcall);
+    }
+
     std::chrono::high_resolution_clock clock;
     auto start = clock.now();
 
@@ -325,6 +394,8 @@ R"FRAG(
 
     gl_context.dbg_PopCallGroup();
 
+    governor.endFrame();
+
     if(!running) break;
   }
 
@@ -0,0 +1,125 @@
+#include <device/sm83/blockcache.h>
+#include <util/compiler.h>
+
+#include <algorithm>
+#include <utility>
+
+#include <cassert>
+
+namespace brgb::sm83 {
+
+BlockCache::BlockCache() :
+  recent_(0x10000, nullptr)
+{
+}
+
+auto BlockCache::lookup(u32 bank, u16 pc) -> Block *
+{
+  auto recent = recent_[pc];
+  if(BRGB_LIKELY(recent && recent->bank == bank)) return recent;
+
+  auto it = blocks_.find(key(bank, pc));
+  if(it == blocks_.end()) return nullptr;
+
+  recent_[pc] = it->second.get();
+
+  return it->second.get();
+}
+
+auto BlockCache::insert(std::unique_ptr<Block> block, bool writable) -> Block *
+{
+  assert(block && !block->ops.empty() && "attempted to cache an empty Block!");
+
+  // None of the dropped Blocks can be executing at this point
+  dropped_.clear();
+
+  auto ptr = block.get();
+  auto k = key(block->bank, block->pc);
+
+  // Replace any existing Block (which can only happen
+  //   when the caller didn't lookup() first)
+  if(auto it = blocks_.find(k); it != blocks_.end()) drop(it->second.get());
+
+  blocks_.emplace(k, std::move(block));
+  recent_[ptr->pc] = ptr;
+
+  if(writable) {
+    eachPage(ptr, [&](auto& page) { page.push_back(ptr); });
+  }
+
+  return ptr;
+}
+
+auto BlockCache::invalidate(u16 addr) -> bool
+{
+  auto& page = pages_[addr >> PageShift];
+
+  bool dropped = false;
+  for(size_t i = 0; i < page.size();) {
+    auto block = page[i];
+
+    // Whether 'addr' lies in [pc; pc+size), accounting for wrap-around
+    if((u16)(addr - block->pc) < block->size) {
+      drop(block);     // Removes the Block from 'page'
+      dropped = true;
+    } else {
+      i++;
+    }
+  }
+
+  return dropped;
+}
+
+auto BlockCache::clear() -> void
+{
+  blocks_.clear();
+  dropped_.clear();
+
+  std::fill(recent_.begin(), recent_.end(), nullptr);
+  for(auto& page : pages_) page.clear();
+}
+
+auto BlockCache::size() const -> size_t
+{
+  return blocks_.size();
+}
+
+auto BlockCache::key(u32 bank, u16 pc) -> u64
+{
+  return (u64)bank << 16 | pc;
+}
+
+template <typename Fn>
+auto BlockCache::eachPage(const Block *block, Fn fn) -> void
+{
+  unsigned first = block->pc >> PageShift;
+  unsigned last  = (u16)(block->pc + block->size - 1) >> PageShift;
+
+  // The last page can be < the first when the Block wraps around
+  for(unsigned page = first;; page = (page+1) % NumPages) {
+    fn(pages_[page]);
+
+    if(page == last) break;
+  }
+}
+
+auto BlockCache::drop(Block *block) -> void
+{
+  if(recent_[block->pc] == block) recent_[block->pc] = nullptr;
+
+  eachPage(block, [&](auto& page) {
+    auto it = std::find(page.begin(), page.end(), block);
+    if(it == page.end()) return;    // The Block isn't writable
+
+    *it = page.back();
+    page.pop_back();
+  });
+
+  auto it = blocks_.find(key(block->bank, block->pc));
+  assert(it != blocks_.end() && it->second.get() == block);
+
+  dropped_.push_back(std::move(it->second));
+  blocks_.erase(it);
+}
+
+}
@@ -0,0 +1,221 @@
+#include <device/sm83/cpu.h>
+#include <device/sm83/ops.h>
+#include <device/sm83/opcodes.h>
+
+#include <algorithm>
+
+#include <cassert>
+
+namespace brgb::sm83 {
+
+auto Processor::executeCached(unsigned instructions) -> unsigned
+{
+  auto interrupt_state = interruptState();
+
+  Registers rf = r;
+
+  // The last instruction executed, see lastPc()
+  const BlockCache::Block *last_block = nullptr;
+  unsigned last_op = 0;
+  u16 last_pc = rf.pc;
+
+  unsigned left = instructions;
+  while(left) {
+    // The first instruction is executed regardless of 'until_'
+    if(left != instructions && cycles_ > until_) break;
+
+    unsigned first;
+    auto block = enterBlock(rf.pc, first);
+
+    if(BRGB_UNLIKELY(!block)) {
+      // Blocks never contain breakpoints (see compileBlock()),
+      //   so this is the only place they need to be checked
+      if(left != instructions && breakpointAt(rf.pc)) break;
+
+      last_block = nullptr;
+      last_pc = rf.pc;
+
+      // The code can't be cached - interpret a single instruction
+      (this->*OpTable[opcode(rf)])(rf);
+      left--;
+    } else {
+      unsigned ops = std::min(left, blockOps(block, first));
+      unsigned executed = ops - runBlock(block, rf, ops, first);
+
+      left -= executed;
+
+      last_block = block;
+      last_op = first + executed-1;
+    }
+
+    // Only the last instruction of a Block can change the interrupt
+    //   state, or one which breaks the Block by writing to IF or IE
+    if(BRGB_UNLIKELY(interruptState() != interrupt_state)) break;
+  }
+
+  r = rf;
+  last_pc_ = last_block ? opAddress(last_block, last_op) : last_pc;
+
+  return instructions - left;
+}
+
+auto Processor::runBlock(BlockCache::Block *block, Registers& rf, unsigned left, unsigned first) -> unsigned
+{
+  block_break_ = false;
+
+  unsigned num_ops = block->ops.size();
+  for(unsigned i = first; i < num_ops; i++) {
+    const auto& op = block->ops[i];
+
+    // The opcode(s) were already fetched, but the memory
+    //   cycles still have to be spent
+    for(unsigned j = 0; j < op.fetches; j++) idle();
+    rf.pc += op.fetches;
+
+    operands_ = op.operands;
+    (this->*op.handler)(rf);
+
+    // The Block is no longer safe to continue when one of
+    //   it's instructions wrote to it (or remapped memory)
+    if(BRGB_UNLIKELY(!--left || block_break_)) {
+      // Ran out of instructions - see 'partial_block_'
+      if(!block_break_ && i+1 < num_ops) {
+        partial_block_ = block;
+        partial_op_ = i+1;
+        partial_pc_ = rf.pc;
+      }
+
+      break;
+    }
+  }
+
+  return left;
+}
+
+auto Processor::blockOps(const BlockCache::Block *block, unsigned first) const -> unsigned
+{
+  if(cycles_ > until_) return 1;
+
+  const auto& ops = block->ops;
+
+  // Checking the last instruction first spares going through all
+  //   of them in every Block but the one 'until_' falls into
+  auto cycles = until_ - cycles_ + ops[first].start_cycle;
+  if(ops.back().start_cycle <= cycles) return ops.size() - first;
+
+  unsigned num_ops = first+1;
+  while(ops[num_ops].start_cycle <= cycles) num_ops++;
+
+  return num_ops - first;
+}
+
+auto Processor::opAddress(const BlockCache::Block *block, unsigned op) -> u16
+{
+  u16 addr = block->pc;
+  for(unsigned i = 0; i < op; i++) addr += block->ops[i].length;
+
+  return addr;
+}
+
+auto Processor::enterBlock(u16 pc, unsigned& first) -> BlockCache::Block *
+{
+  first = 0;
+
+  if(BRGB_UNLIKELY(partial_block_ != nullptr)) {
+    auto block = partial_block_;
+    partial_block_ = nullptr;
+
+    if(partial_pc_ == pc) {
+      first = partial_op_;
+
+      return block;
+    }
+  }
+
+  return this->block(pc);
+}
+
+auto Processor::block(u16 pc) -> BlockCache::Block *
+{
+  // Execution has to stop right before a breakpoint,
+  //   which Blocks leave to executeCached()
+  if(BRGB_UNLIKELY(num_breakpoints_) && breakpoints_[pc]) return nullptr;
+
+  auto bank = memoryBank(pc);
+  if(bank == Uncacheable) return nullptr;
+
+  if(auto block = blocks_.lookup(bank, pc)) return block;
+
+  auto block = compileBlock(bank, pc);
+  if(!block) return nullptr;
+
+  return blocks_.insert(std::move(block), !(bank & ReadOnly));
+}
+
+auto Processor::compileBlock(u32 bank, u16 pc) -> std::unique_ptr<BlockCache::Block>
+{
+  auto block = std::make_unique<BlockCache::Block>();
+
+  block->bank = bank;
+  block->pc = pc;
+  block->hits = 0;
+  block->native = nullptr;
+
+  u16 addr = pc;
+  unsigned cycles = 0;
+  while(block->ops.size() < BlockCache::MaxBlockOps) {
+    // All of the instruction's bytes must come from the same memory,
+    //   otherwise it's left for the next Block (or to be interpreted)
+    //  - Checked before each peek(), as reading other memory
+    //    isn't guaranteed to be free of side effects
+    auto same_bank = [&](unsigned length) {
+      for(unsigned i = 0; i < length; i++) {
+        if(memoryBank(addr + i) != bank) return false;
+      }
+
+      return true;
+    };
+
+    if(!same_bank(1)) break;
+
+    // Cut the Block short of any breakpoint, see block()
+    if(num_breakpoints_ && breakpoints_[addr]) break;
+
+    u8 op = peek(addr);
+
+    const auto& info = op == 0xCB ? opcode_info_cb(peek(addr+1)) : opcode_info(op);
+
+    unsigned fetches = op == 0xCB ? 2 : 1;
+    unsigned num_operands = info.length - fetches;
+
+    if(!same_bank(fetches + num_operands)) break;
+
+    BlockCache::Op block_op = { };
+
+    block_op.handler = op == 0xCB ? OpTableCB[peek(addr+1)] : OpTablePredecoded[op];
+    block_op.opcode = op;
+    block_op.length = fetches + num_operands;
+    block_op.fetches = fetches;
+    block_op.start_cycle = cycles;
+
+    if(num_operands > 0) block_op.operands[0] = peek(addr + fetches + 0);
+    if(num_operands > 1) block_op.operands[1] = peek(addr + fetches + 1);
+
+    block->ops.push_back(block_op);
+    addr += fetches + num_operands;
+    cycles += info.cycles;
+
+    // Blocks end on everything which (possibly) changes PC other than
+    //   by moving on to the next instruction, and everything which
+    //   can change IME or the RunState
+    if(info.is(OpBranch | OpInterruptState)) break;
+  }
+
+  if(block->ops.empty()) return nullptr;
+
+  block->size = (u16)(addr - pc);
+
+  return block;
+}
+
+}
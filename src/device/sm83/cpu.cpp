@@ -3,27 +3,7 @@
 
 #include <bus/memorymap.h>
 
-#define A r.a
-#define F r.f
-#define B r.b
-#define C r.c
-#define D r.d
-#define E r.e
-#define H r.h
-#define L r.l
-
-#define ZF r.flags.z
-#define NF r.flags.n
-#define HF r.flags.h
-#define CF r.flags.c
-
-#define AF r.af
-#define BC r.bc
-#define DE r.de
-#define HL r.hl
-
-#define PC r.pc
-#define SP r.sp
+#include <cassert>
 
 namespace brgb::sm83 {
 
@@ -40,207 +20,157 @@ auto Processor::bus() -> ProcessorBus&
 auto Processor::power() -> void
 {
   r = { };
-}
 
-auto Processor::opcode() -> u8
-{
-  return read(PC++);
+  cycles_ = writes_ = 0;
+
+  ime_ = ei_delay_ = false;
+  run_state_ = RunState::Running;
+
+  break_hit_ = false;
+
+  updateInterrupts();
+
+  flushBlocks();
 }
 
-auto Processor::operand8() -> u8
+auto Processor::saveState(State& state) -> void
 {
-  return read(PC++);
+  state.af = r.af(); state.bc = r.bc();
+  state.de = r.de(); state.hl = r.hl();
+
+  state.sp = r.sp; state.pc = r.pc;
+
+  state.ime = ime_;
+  state.ei_delay = ei_delay_;
+  state.run_state = run_state_;
 }
 
-auto Processor::operand16() -> u16
+auto Processor::loadState(const State& state) -> void
 {
-  Natural<16> operand;
+  r.af(state.af); r.bc(state.bc);
+  r.de(state.de); r.hl(state.hl);
+
+  r.sp = state.sp; r.pc = state.pc;
+
+  ime_ = state.ime;
+  ei_delay_ = state.ei_delay;
+  run_state_ = state.run_state;
 
-  operand.bit(0, 7)  = read(PC++);
-  operand.bit(8, 15) = read(PC++);
+  updateInterrupts();
 
-  return operand;
+  partial_block_ = nullptr;
+
+  // The memory gets loaded along with the state, which the
+  //   cached instructions can't be kept up to date with
+  //   (unlike the Blocks, which are flushed by the system
+  //   only when it's needed)
+  if(disasm_cache_) disasm_cache_->clear();
 }
 
-auto Processor::push16(u16 data) -> void
+auto Processor::runState() const -> RunState
 {
-  write(--SP, data >> 8);
-  write(--SP, data >> 0);
+  return run_state_;
 }
 
-auto Processor::pop16() -> u16
+auto Processor::resume() -> Processor&
 {
-  Natural<16> data;
+  if(run_state_ != RunState::Stopped) return *this;
 
-  data.bit(0, 7)  = read(SP++);
-  data.bit(8, 15) = read(SP++);
+  run_state_ = RunState::Running;
+  updateInterrupts();
 
-  return data;
+  return *this;
 }
 
-auto Processor::reg(Reg8 which) -> u8
+auto Processor::interruptLines(u8 lines) -> Processor&
 {
-  switch(which) {
-  case Reg8::b:          return B;
-  case Reg8::c:          return C;
-  case Reg8::d:          return D;
-  case Reg8::e:          return E;
-  case Reg8::h:          return H;
-  case Reg8::l:          return L;
-  case Reg8::HLIndirect: return read(HL);
-  case Reg8::a:          return A;
-  }
+  irq_lines_ = lines;
+  updateInterrupts();
 
-  assert(0);   // Unreachable
-  return 0;
+  return *this;
 }
 
-auto Processor::reg(Reg8 which, u8 data) -> void
+auto Processor::engine() const -> Engine
 {
-  switch(which) {
-  case Reg8::b:          B = data; break;
-  case Reg8::c:          C = data; break;
-  case Reg8::d:          D = data; break;
-  case Reg8::e:          E = data; break;
-  case Reg8::h:          H = data; break;
-  case Reg8::l:          L = data; break;
-  case Reg8::HLIndirect: write(HL, data); break;
-  case Reg8::a:          A = data; break;
-  }
+  return engine_;
 }
 
-auto Processor::reg(Reg16_rp which) -> u16
+auto Processor::engine(Engine e) -> Processor&
 {
-  switch(which) {
-  case Reg16_rp::bc: return BC;
-  case Reg16_rp::de: return DE;
-  case Reg16_rp::hl: return HL;
-  case Reg16_rp::sp: return SP;
-  }
+  engine_ = e;
 
-  assert(0);   // Unreachable
-  return 0;
-}
+  updateInstrumented();
 
-auto Processor::reg(Reg16_rp which, u16 data) -> void
-{
-  switch(which) {
-  case Reg16_rp::bc: BC = data; break;
-  case Reg16_rp::de: DE = data; break;
-  case Reg16_rp::hl: HL = data; break;
-  case Reg16_rp::sp: SP = data; break;
-  }
+  return *this;
 }
 
-auto Processor::reg(Reg16_rp2 which) -> u16
+auto Processor::flushBlocks() -> void
 {
-  switch(which) {
-  case Reg16_rp2::bc: return BC;
-  case Reg16_rp2::de: return DE;
-  case Reg16_rp2::hl: return HL;
-  case Reg16_rp2::af: return AF;
-  }
+  blocks_.clear();
+  partial_block_ = nullptr;
+
+  // Nothing references the recompiled code anymore
+  if(jit_code_) jit_code_->reset();
 
-  assert(0);   // Unreachable
-  return 0;
+  if(disasm_cache_) disasm_cache_->clear();
 }
 
-auto Processor::reg(Reg16_rp2 which, u16 data) -> void
+auto Processor::disasmCache(sm83disasm::DisasmCache *cache) -> Processor&
 {
-  switch(which) {
-  case Reg16_rp2::bc: BC = data; break;
-  case Reg16_rp2::de: DE = data; break;
-  case Reg16_rp2::hl: HL = data; break;
-  case Reg16_rp2::af: AF = data; break;
+  static_assert((u32)sm83disasm::DisasmCache::Uncacheable == (u32)Uncacheable &&
+      (u32)sm83disasm::DisasmCache::ReadOnly == (u32)ReadOnly);
+
+  if(disasm_cache_) disasm_cache_->detach();
+
+  disasm_cache_ = cache;
+  if(disasm_cache_) {
+    disasm_cache_->attach(
+        [this](u16 addr) { return memoryBank(addr); },
+        [this](u16 addr) { return peek(addr); }
+    );
   }
+
+  return *this;
 }
 
-auto Processor::alu(AluOp op, u8 val) -> void
+auto Processor::disasmCache() const -> sm83disasm::DisasmCache *
 {
+  return disasm_cache_;
 }
 
-auto Processor::rot(RotOp op, u8 val) -> void
+auto Processor::cycles() const -> u64
 {
+  return cycles_;
 }
 
-auto Processor::akku(AkkuOp op) -> void
+auto Processor::writes() const -> u64
 {
+  return writes_;
 }
 
-auto Processor::instruction() -> void
+auto Processor::mapReadPage(u8 page, const u8 *data) -> void
 {
-  auto i = Instruction(opcode());
-
-  auto op_x0 = [this](Instruction i) {
-    switch(i.z()) {
-    case 0: switch(i.y()) {
-      case 0: /* nop */ break;
-    }
-    break;
-
-    case 1:
-      if(i.q() == 0) {
-        //  ld <reg16>, imm16
-        reg(i.reg16rp_p(), operand16());
-      } else {
-      }
-      break;
-
-    //  ld <reg8>, imm8
-    case 6: reg(i.reg8_y(), operand8()); break;
-    }
-  };
-
-  auto op_x3 = [this](Instruction i) {
-    switch(i.z()) {
-    }
-  };
-
-  switch(i.x()) {
-  case 0: op_x0(i); break;
-
-  //  ld <reg8>, <reg8>
-  //  halt
-  case 1: {
-    u8 y = i.y();
-    u8 z = i.z();
+  read_pages_[page] = data;
 
-    if(z == 6 && y == 6) return opHALT();
-
-    u8 data = reg(i.reg8_z());
-    reg(i.reg8_y(), data);
-    break;
-  }
+  // The page could now belong to a different memory bank
+  profile_pages_[page] = nullptr;
+}
 
-  //  add a, <reg8>
-  //  adc a, <reg8>
-  //  sub <reg8>
-  //  sbc a, <reg8>
-  //  and <reg8>
-  //  xor <reg8>
-  //  or <reg8>
-  //  cp <reg8>
-  case 2: alu(i.alu_y(), reg(i.reg8_z())); break;
-
-  case 3: op_x3(i); break;
-  }
+auto Processor::mapWritePage(u8 page, u8 *data) -> void
+{
+  write_pages_[page] = data;
 }
 
+auto Processor::memoryBank(u16 addr) -> u32
+{
+  return Uncacheable;
 }
 
-#undef SP
-#undef PC
+auto Processor::peek(u16 addr) -> u8
+{
+  assert(0 && "peek() called on a Processor without a block cache!");
 
-#undef HL
-#undef DE
-#undef BC
-#undef AF
+  return 0xFF;
+}
 
-#undef L
-#undef H
-#undef E
-#undef D
-#undef C
-#undef B
-#undef F
-#undef A
+}
@@ -0,0 +1,208 @@
+#include <device/sm83/disasmcache.h>
+#include <util/compiler.h>
+
+#include <algorithm>
+#include <utility>
+
+#include <cassert>
+
+namespace brgb::sm83disasm {
+
+DisasmCache::DisasmCache() :
+  recent_(0x10000, nullptr)
+{
+}
+
+auto DisasmCache::attach(BankFn bank, PeekFn peek) -> void
+{
+  clear();
+
+  bank_ = std::move(bank);
+  peek_ = std::move(peek);
+}
+
+auto DisasmCache::detach() -> void
+{
+  // Without the Processor's writes nothing can be kept up to date
+  clear();
+
+  bank_ = nullptr;
+  peek_ = nullptr;
+}
+
+auto DisasmCache::attached() const -> bool
+{
+  return (bool)peek_;
+}
+
+auto DisasmCache::window(u16 addr, unsigned count, const Entry **entries) -> unsigned
+{
+  assert(attached() && "DisasmCache::window() called on a detached DisasmCache!");
+
+  uncached_.clear();
+
+  // See the note on memory banks above the class
+  unsigned page = NumPages;
+  u32 bank = Uncacheable;
+
+  for(unsigned i = 0; i < count; i++) {
+    if(addr >> PageShift != page) {
+      page = addr >> PageShift;
+      bank = bank_(addr);
+    }
+
+    auto entry = lookup(bank, addr);
+
+    entries[i] = entry;
+    addr += entry->length;
+  }
+
+  return count;
+}
+
+auto DisasmCache::invalidate(u16 addr) -> bool
+{
+  auto& page = pages_[addr >> PageShift];
+
+  bool dropped = false;
+  for(size_t i = 0; i < page.size();) {
+    auto entry = page[i];
+
+    // Whether 'addr' lies in the instruction, accounting for wrap-around
+    if((u16)(addr - entry->addr) < entry->length) {
+      drop(entry);     // Removes the Entry from 'page'
+      dropped = true;
+    } else {
+      i++;
+    }
+  }
+
+  return dropped;
+}
+
+auto DisasmCache::clear() -> void
+{
+  entries_.clear();
+  uncached_.clear();
+
+  std::fill(recent_.begin(), recent_.end(), nullptr);
+  for(auto& page : pages_) page.clear();
+}
+
+auto DisasmCache::size() const -> size_t
+{
+  return entries_.size();
+}
+
+auto DisasmCache::hits() const -> u64
+{
+  return hits_;
+}
+
+auto DisasmCache::misses() const -> u64
+{
+  return misses_;
+}
+
+auto DisasmCache::key(u32 bank, u16 addr) -> u64
+{
+  return (u64)bank << 16 | addr;
+}
+
+auto DisasmCache::disassemble(u16 addr, Entry& entry) -> bool
+{
+  for(unsigned i = 0; i < Instruction::MaxLength; i++) entry.bytes[i] = peek_((u16)(addr + i));
+
+  u8 *ptr = entry.bytes;
+
+  Instruction instruction(entry.bytes, addr);
+  instruction.decode(ptr, entry.bytes + Instruction::MaxLength);
+
+  entry.addr = addr;
+  entry.length = ptr - entry.bytes;
+  entry.data = instruction.isData();
+
+  instruction.format(entry.text, sizeof(entry.text));
+
+  // The instruction's bytes have to come from a single
+  //   bank for the Entry to be found again
+  for(unsigned i = 1; i < entry.length; i++) {
+    if(bank_((u16)(addr + i)) != entry.bank) return false;
+  }
+
+  return entry.bank != Uncacheable;
+}
+
+auto DisasmCache::lookup(u32 bank, u16 addr) -> const Entry *
+{
+  if(bank != Uncacheable) {
+    auto recent = recent_[addr];
+    if(BRGB_LIKELY(recent && recent->bank == bank)) {
+      hits_++;
+
+      return recent;
+    }
+
+    auto it = entries_.find(key(bank, addr));
+    if(it != entries_.end()) {
+      hits_++;
+      recent_[addr] = &it->second;
+
+      return &it->second;
+    }
+  }
+
+  misses_++;
+
+  Entry entry;
+  entry.bank = bank;
+
+  if(!disassemble(addr, entry)) {
+    uncached_.push_back(std::make_unique<Entry>(entry));
+
+    return uncached_.back().get();
+  }
+
+  auto ptr = &entries_.emplace(key(bank, addr), entry).first->second;
+  recent_[addr] = ptr;
+
+  if(!(bank & ReadOnly)) {
+    eachPage(ptr, [&](auto& page) { page.push_back(ptr); });
+  }
+
+  return ptr;
+}
+
+template <typename Fn>
+auto DisasmCache::eachPage(const Entry *entry, Fn fn) -> void
+{
+  unsigned first = entry->addr >> PageShift;
+  unsigned last  = (u16)(entry->addr + entry->length - 1) >> PageShift;
+
+  // The last page can be < the first when the instruction wraps around
+  for(unsigned page = first;; page = (page+1) % NumPages) {
+    fn(pages_[page]);
+
+    if(page == last) break;
+  }
+}
+
+auto DisasmCache::drop(const Entry *entry) -> void
+{
+  if(recent_[entry->addr] == entry) recent_[entry->addr] = nullptr;
+
+  eachPage(entry, [&](auto& page) {
+    auto it = std::find(page.begin(), page.end(), entry);
+    if(it == page.end()) return;    // The Entry isn't writable
+
+    *it = page.back();
+    page.pop_back();
+  });
+
+  auto it = entries_.find(key(entry->bank, entry->addr));
+  assert(it != entries_.end() && &it->second == entry);
+
+  entries_.erase(it);
+}
+
+}
@@ -1,96 +1,151 @@
 #include <device/sm83/disassembler.h>
 
 #include <utility>
+#include <algorithm>
+#include <array>
 #include <string>
-#include <sstream>
-#include <unordered_map>
 
 #include <cassert>
 #include <cstddef>
+#include <cstring>
 
 namespace brgb::sm83disasm {
 
-static constexpr u8 OpcodeNOP  = 0x00;
-static constexpr u8 OpcodeSTOP = 0x10;
-static constexpr u8 OpcodeHALT = 0x76;
-static constexpr u8 OpcodeRLCA = 0x07;
-static constexpr u8 OpcodeRLA  = 0x17;
-static constexpr u8 OpcodeDAA  = 0x27;
-static constexpr u8 OpcodeSCF  = 0x37;
-static constexpr u8 OpcodeRRCA = 0x0F;
-static constexpr u8 OpcodeRRA  = 0x1F;
-static constexpr u8 OpcodeCPL  = 0x2F;
-static constexpr u8 OpcodeCCF  = 0x3F;
-
-static constexpr u8 OpcodeJP_Always          = 0xC3;
-static constexpr u8 OpcodeJP_Always_Indirect = 0xE9;
-static constexpr u8 OpcodeJR_Always          = 0x18;
-static constexpr u8 OpcodeCALL_Always        = 0xCD;
-static constexpr u8 OpcodeRET_Always         = 0xC9;
-
-static constexpr u8 OpcodeLD_Ptr16_A = 0xEA;
-static constexpr u8 OpcodeLD_A_Ptr16 = 0xFA;
-static constexpr u8 OpcodeADD_SP_Imm = 0xE8;
-static constexpr u8 OpcodeLDH_a8_A   = 0xE0;
-static constexpr u8 OpcodeLDH_A_a8   = 0xF0;
-static constexpr u8 OpcodeLDH_CInd_A = 0xE2;
-static constexpr u8 OpcodeLDH_A_CInd = 0xF2;
-
-static const std::unordered_map<OpcodeMnemonic, std::string> p_op_mnem_to_str = {
-  { op_Invalid, "<invalid>" },
-
-  { op_nop, "nop" },
-  { op_stop, "stop" }, { op_halt, "halt" },
-  { op_jp, "jp" }, { op_jr, "jr" },
-  { op_ld, "ld" }, { op_ldh, "ldh" },
-  { op_inc, "inc" }, { op_dec, "dec" },
-  { op_rlca, "rlca" }, { op_rla, "rla" }, { op_rrca, "rrca" }, { op_rra, "rra" },
-  { op_daa, "daa" },
-  { op_cpl, "cpl" },
-  { op_scf, "scf" }, { op_ccf, "ccf" },
-  { op_add, "add" }, { op_adc, "adc" }, { op_sub, "sub" }, { op_sbc, "sbc" },
-  { op_and, "and" }, { op_or, "or" }, { op_xor, "xor" },
-  { op_cp, "cp" },
-  { op_call, "call" },
-  { op_ret, "ret" }, { op_reti, "reti" },
-  { op_push, "push" }, { op_pop, "pop" },
-  { op_ei, "ei" }, { op_di, "di" },
-  { op_rst, "rst" },
-};
+using sm83::Operand;
 
-static const std::unordered_map<OpcodeMnemonic, std::string> p_op_0xCB_mnem_to_str = {
-  { op_rlc, "rlc" }, { op_rl, "rl" }, { op_rrc, "rrc" }, { op_rr, "rr" },
-  { op_sla, "sla" }, { op_sra, "sra" }, { op_srl, "srl" },
-  { op_swap, "swap" },
-  { op_bit, "bit" }, { op_res, "res" }, { op_set, "set" },
-};
+// Writes text into a caller-provided buffer without any heap
+//   allocations, dropping whatever doesn't fit (while always
+//   leaving room for the NUL terminator)
+class LineWriter {
+public:
+  LineWriter(char *buf, size_t size) :
+    begin_(buf), p_(buf), end_(buf + (size ? size-1 : 0)), size_(size)
+  { }
 
-inline auto lo_nibble(u8 op) -> u8 { return op & 0x0F; }
-inline auto hi_nibble(u8 op) -> u8 { return op & 0xF0; }
+  auto put(char c) -> LineWriter&
+  {
+    if(p_ < end_) *p_++ = c;
 
-template <typename... Args>
-inline auto hi_nibble_matches(u8 op, Args... args) -> bool
-{
-  return ((hi_nibble(op) == args) || ...);
-}
+    return *this;
+  }
 
-inline auto hi_nibble_between(u8 op, u8 min, u8 max) -> bool
-{
-  return hi_nibble(op) >= min && hi_nibble(op) <= max;
-}
+  auto put(const char *str) -> LineWriter&
+  {
+    while(*str && p_ < end_) *p_++ = *str++;
 
-template <typename... Args>
-inline auto lo_nibble_matches(u8 op, Args... args) -> bool
-{
-  return ((lo_nibble(op) == args) || ...);
-}
+    return *this;
+  }
 
-inline auto lo_nibble_between(u8 op, u8 min, u8 max) -> bool
-{
-  return lo_nibble(op) >= min && lo_nibble(op) <= max;
-}
+  // Writes 'length' chars of 'str', which doesn't have to be NUL-terminated
+  auto put(const char *str, size_t length) -> LineWriter&
+  {
+    length = std::min<size_t>(length, end_ - p_);
+
+    memcpy(p_, str, length);
+    p_ += length;
+
+    return *this;
+  }
+
+  // Same as put(str, length) for an array of N chars, all of which are
+  //   copied when there's room as that's cheaper than a memcpy() of a
+  //   length only known at runtime (and whatever ends up past the
+  //   text gets overwritten or is past the NUL terminator anyway)
+  template <size_t N>
+  auto putArray(const char (&str)[N], size_t length) -> LineWriter&
+  {
+    if((size_t)(end_ - p_) < N) return put(str, length);
+
+    memcpy(p_, str, N);
+    p_ += length;
+
+    return *this;
+  }
+
+  // Upper case, as in the rest of the disassembly
+  auto hex8(u8 v) -> LineWriter&
+  {
+    static constexpr char Digits[] = "0123456789ABCDEF";
+
+    return put(Digits[v >> 4]).put(Digits[v & 0xF]);
+  }
+
+  auto hex16(u16 v) -> LineWriter&
+  {
+    return hex8(v >> 8).hex8(v & 0xFF);
+  }
+
+  // At least 'min_digits' digits, like "%.*X"
+  auto hex(uintptr_t v, unsigned min_digits) -> LineWriter&
+  {
+    static constexpr char Digits[] = "0123456789ABCDEF";
+
+    // Which is nearly always the case
+    if(v <= 0xFFFF && min_digits == 4) return hex16(v);
+
+    char digits[sizeof(v)*2];
+    unsigned n = 0;
+    do {
+      digits[n++] = Digits[v & 0xF];
+      v >>= 4;
+    } while(v || n < min_digits);
+
+    while(n) put(digits[--n]);
+
+    return *this;
+  }
+
+  // Only ever used for bit indices and such, so a single digit
+  auto digit(unsigned v) -> LineWriter&
+  {
+    return put((char)('0' + v));
+  }
+
+  // Pads the line with spaces up to 'column' (exclusive)
+  auto padTo(size_t column) -> LineWriter&
+  {
+    if(length() >= column) return *this;
+
+    auto n = std::min<size_t>(column - length(), end_ - p_);
+
+    memset(p_, ' ', n);
+    p_ += n;
 
-auto Instruction::OperandReg_to_str(OperandReg reg) -> std::string
+    return *this;
+  }
+
+  auto length() const -> size_t { return p_ - begin_; }
+  auto full() const -> bool { return p_ >= end_; }
+
+  // NUL-terminates the text and returns it's length
+  auto finish() -> size_t
+  {
+    if(size_) *p_ = '\0';
+
+    return length();
+  }
+
+private:
+  char *begin_, *p_, *end_;
+  size_t size_;
+};
+
+// The text of an opcode, except for the operand which depends on the
+//   instruction's bytes (there's at most one), which gets written in
+//   between the 'prefix' and 'suffix'
+//   - Makes formatting mostly a matter of copying these, instead of
+//     branching on the mnemonic and every operand over and over
+struct OpcodeText {
+  char prefix[24];
+  char suffix[16];
+
+  u8 prefix_length = 0, suffix_length = 0;
+
+  // Index of the variable operand, or -1 when there isn't one
+  int operand = -1;
+};
+
+auto Instruction::OperandReg_to_str(OperandReg reg) -> const char *
 {
   switch(reg) {
   // <reg8>
@@ -121,7 +176,7 @@ auto Instruction::OperandReg_to_str(OperandReg reg) -> std::string
   return "<invalid>";
 }
 
-auto Instruction::OperandCondition_to_str(OperandCondition cond) -> std::string
+auto Instruction::OperandCondition_to_str(OperandCondition cond) -> const char *
 {
   switch(cond) {
   case ConditionC:  return "c";
@@ -133,18 +188,14 @@ auto Instruction::OperandCondition_to_str(OperandCondition cond) -> std::string
   return "<invalid>";
 }
 
-auto Instruction::op_mnem_to_str(OpcodeMnemonic op) -> std::string
+auto Instruction::op_mnem_to_str(OpcodeMnemonic op) -> const char *
 {
-  auto it = p_op_mnem_to_str.find(op);
-
-  return it != p_op_mnem_to_str.end() ? it->second : "<unknown>";
+  return sm83::mnemonic_name(op);
 }
 
-auto Instruction::op_0xCB_mnem_to_str(OpcodeMnemonic op) -> std::string
+auto Instruction::op_0xCB_mnem_to_str(OpcodeMnemonic op) -> const char *
 {
-  auto it = p_op_0xCB_mnem_to_str.find(op);
-
-  return it != p_op_0xCB_mnem_to_str.end() ? it->second : "<unknown>";
+  return sm83::mnemonic_name(op);
 }
 
 Instruction::Instruction(u8 *mem) :
@@ -152,402 +203,165 @@ Instruction::Instruction(u8 *mem) :
 {
 }
 
-auto Instruction::disassemble(u8 *ptr) -> u8 *
+Instruction::Instruction(u8 *mem, u16 base) :
+  mem_(mem), base_(base), addresses_(true)
 {
-  // Store the Instruction's offset
-  offset_ = ptr - mem_;
-
-  // Fetch the opcode
-  u8 op = *ptr++;
-  op_ = op;
-
-  // Delegate to alternate method for CB-prefixed opcodes
-  if(op == CB_prefix) return disassembleCBPrefixed(ptr);
+}
 
-  if(hi_nibble_between(op, 0x00, 0x30)) {
-    return disassemble0x00_0x30(ptr);
-  } else if(hi_nibble_between(op, 0x40, 0x70)) {
-    if(op == OpcodeHALT) {  // The HALT opcode is mixed-in with the LDs
-      op_mnem_ = op_halt;
-    } else {
-      op_mnem_ = op_ld;
-    }
-  } else if(hi_nibble_between(op, 0x80, 0xB0)) {
-    return disassemble0x80_0xB0(ptr);
-  } else if(hi_nibble_between(op, 0xC0, 0xF0)) {
-    return disassemble0xC0_0xF0(ptr);
+auto Instruction::disassemble(u8 *ptr) -> u8 *
+{
+  if(decode(ptr, ptr + MaxLength) != DecodeOk) {
+    throw Disassembler::IllegalOpcodeError(offset_, op_);
   }
 
   return ptr;
 }
 
-auto Instruction::numOperands() -> unsigned
+auto Instruction::decode(u8 *& ptr, const u8 *end) -> DecodeStatus
 {
-  u8 op = op_;
-
-  switch(op_mnem_) {
-  case op_nop:  return 0;
-  case op_stop: return 1;   // Always 0
-  case op_halt: return 0;
-
-  case op_jp:
-  case op_jr:
-  case op_call:
-  case op_ret:
-  case op_reti:
-    // For these instructions the accumulator ('A' register)
-    //   is listed as an operand instead of being implied
-   if(op == OpcodeJP_Always || op == OpcodeJP_Always_Indirect || op == OpcodeJR_Always
-     || op == OpcodeCALL_Always || op == OpcodeRET_Always) {
-      return 1;
-    }
+  assert(ptr < end && "Instruction::decode() called without any bytes to decode!");
 
-    return 2;
+  // Store the Instruction's offset
+  offset_ = base_ + (ptr - mem_);
+  if(addresses_) offset_ &= 0xFFFF;
 
-  case op_ld:
-  case op_ldh: return 2;
+  // Look up the opcode
+  u8 op = ptr[0];
 
-  case op_inc:
-  case op_dec: return 1;
+  bool prefixed = op == CB_prefix;
+  const auto *info = &sm83::opcode_info(op);
+  if(prefixed) {
+    if(end - ptr < 2) return decodeData(ptr, DecodeTruncated);
 
-  case op_rlca:
-  case op_rla:
-  case op_rrca:
-  case op_rra: return 0;   // operand is implied
+    // Look past the prefix for the real opcode
+    op = ptr[1];
+    info = &sm83::opcode_info_cb(op);
+  }
 
-  case op_daa:
-  case op_cpl: return 0;
+  if(info->mnemonic == OpcodeMnemonic::Invalid) return decodeData(ptr, DecodeIllegalOpcode);
+  if(end - ptr < info->length) return decodeData(ptr, DecodeTruncated);
 
-  case op_scf:
-  case op_ccf: return 0;
+  data_ = false;
 
-  case op_add:
-  case op_adc:
-  case op_sbc: return 2;   // the 'A' register operand is explicit
+  op_ = op;
+  op_CB_prefixed_ = prefixed;
 
-  case op_sub:
-  case op_and:
-  case op_xor:
-  case op_or:
-  case op_cp: return 1;
+  info_ = info;
+  op_mnem_ = info->mnemonic;
 
-  case op_push:
-  case op_pop: return 1;
+  // Fetch the operands
+  //   - Little-endian byte ordering
+  unsigned num_operand_bytes = info->length - (prefixed ? 2 : 1);
+  ptr += prefixed ? 2 : 1;
 
-  case op_ei:
-  case op_di: return 0;
+  operand_ = 0;
+  if(num_operand_bytes > 0) operand_lo_ = *ptr++;
+  if(num_operand_bytes > 1) operand_hi_ = *ptr++;
 
-  case op_rst: return 1;
+  return DecodeOk;
+}
 
-  case op_rlc:
-  case op_rl:
-  case op_rrc:
-  case op_rr:
-  case op_sla:
-  case op_sra:
-  case op_srl: return 1;
+auto Instruction::decodeData(u8 *& ptr, DecodeStatus status) -> DecodeStatus
+{
+  data_ = true;
 
-  case op_swap: return 1;
+  op_ = *ptr++;
+  op_CB_prefixed_ = false;
 
-  case op_bit:
-  case op_res:
-  case op_set: return 2;
-  }
+  info_ = nullptr;
+  op_mnem_ = OpcodeMnemonic::Invalid;
+
+  operand_ = 0;
 
-  return ~0u;
+  return status;
 }
 
-auto Instruction::operandType(unsigned which) -> OperandType
+auto Instruction::isData() const -> bool
 {
-  assert(which < 2 && "Instruction::operandType() called with out-of-range 'which'!");
-
-  u8 op = op_;
-
-  switch(op_mnem_) {
-  case op_nop:
-  case op_halt: return OperandNone;
-
-  case op_stop: return OperandImm8;   // Always 0
+  return data_;
+}
 
-  case op_daa:
-  case op_cpl:
-  case op_scf:
-  case op_ccf:
-  case op_rlca:
-  case op_rla:
-  case op_rrca:
-  case op_rra:
-  case op_ei:
-  case op_di: return OperandImplied;
+auto Instruction::numOperands() -> unsigned
+{
+  assert((info_ || data_) && "Instruction::numOperands() called before Instruction::disassemble()!");
 
-  case op_push:
-  case op_pop: return OperandReg16;
+  if(data_) return 0;
 
-  case op_reti: return OperandImplied;
+  return info_->numOperands();
+}
 
-  case op_rst: return OperandRSTVector;
-  }
+auto Instruction::operand(unsigned which) -> Operand
+{
+  assert(which < 2 && "Instruction::operand() called with out-of-range 'which'!");
 
-  if(op_CB_prefixed_) {
-    if(hi_nibble_between(op, 0x40, 0xF0)) {
-      if(which == 0) return OperandBitIndex;
+  return info_ ? info_->operands[which] : Operand::None;
+}
 
-      // which == 1
-      which = 0;
-    }
+auto Instruction::operandType(unsigned which) -> OperandType
+{
+  switch(operand(which)) {
+  case Operand::None: return OperandNone;
 
-    // Handle (hl) operand
-    return lo_nibble_matches(op, 0x06, 0x0E) ? OperandReg16Indirect : OperandReg8;
-  }
+  case Operand::A: case Operand::B: case Operand::C: case Operand::D:
+  case Operand::E: case Operand::H: case Operand::L:
+    return OperandReg8;
 
-  if(op_mnem_ == op_jp || op_mnem_ == op_jr || op_mnem_ == op_call || op_mnem_ == op_ret) {
-    if(op == OpcodeJP_Always || op == OpcodeCALL_Always) {
-      return OperandAddress16;
-    } else if(op == OpcodeJR_Always) {
-      return OperandRelOffset8;
-    } else if(op == OpcodeRET_Always) {
-      return OperandImplied;
-    } else if(op == OpcodeJP_Always_Indirect) {
-      return OperandReg16Indirect;
-    }
+  case Operand::AF: case Operand::BC: case Operand::DE:
+  case Operand::HL: case Operand::SP:
+    return OperandReg16;
 
-    switch(op_mnem_) {
-    case op_jr: return which == 0 ? OperandCond : OperandRelOffset8;
+  case Operand::BCInd: case Operand::DEInd: case Operand::HLInd:
+  case Operand::HLIInd: case Operand::HLDInd:
+    return OperandReg16Indirect;
 
-    default:    return which == 0 ? OperandCond : OperandAddress16;
-    }
-  } else if(op_mnem_ == op_inc || op_mnem_ == op_dec) {
-    if(lo_nibble_matches(op, 0x04, 0x05, 0x0C, 0x0D)) {
-      if(hi_nibble_matches(op, 0x30)) return OperandReg16Indirect;   // inc/dec (hl)
+  case Operand::HighC: return OperandLDHRegC;
 
-      return OperandReg8;
-    } else if(lo_nibble_matches(op, 0x03, 0x0B)) {
-      return OperandReg16;
-    }
-  } else if(hi_nibble_between(op, 0x00, 0x30)) {
-    if(lo_nibble_matches(op, 0x01)) {
-      return which == 0 ? OperandReg16 : OperandImm16;
-    } else if(lo_nibble_matches(op, 0x02)) {
-      return which == 0 ? OperandReg16Indirect : OperandReg8;
-    } else if(lo_nibble_matches(op, 0x0A)) {
-      return which == 0 ? OperandReg8 : OperandReg16Indirect;
-    } else if(lo_nibble_matches(op, 0x06, 0x0E)) {
-      return which == 0 ? OperandReg8 : OperandImm8;
-    }
-  } else if(hi_nibble_between(op, 0x40, 0x70)) {
-    //  ld <reg8>, <reg8>
-    //  ld (hl), <reg8>
-    //  ld <reg8>, (hl)
-
-    if(lo_nibble_matches(op, 0x06) || lo_nibble_matches(op, 0x0E)) {
-      switch(which) {
-      case 1: return OperandReg16Indirect;
-      }
-    } else if(hi_nibble_matches(op, 0x70) && lo_nibble_between(op, 0x00, 0x07)) {
-      switch(which) {
-      case 0: return OperandReg16Indirect;
-      }
-    } else if(lo_nibble_matches(op, 0x02)) {
-      return which == 0 ? OperandReg16Indirect : OperandReg8;
-    } else if(lo_nibble_matches(op, 0x0A)) {
-      return which == 0 ? OperandReg8 : OperandReg16Indirect;
-    } else if(lo_nibble_matches(op, 0x08)) {
-      return which == 0 ? OperandPtr16 : OperandReg16;
-    } else if(lo_nibble_matches(op, 0x09)) {
-      // add hl, <reg16>
-      return OperandReg16;
-    } 
+  case Operand::NZ: case Operand::Z: case Operand::NC: case Operand::CarrySet:
+    return OperandCond;
 
-    return OperandReg8;
-  } else if(hi_nibble_between(op, 0x80, 0xB0)) {
-    //  add a, <reg8>/(hl)
-    //  adc a, <reg8>/(hl)
-    //  sub <reg8>/(hl)
-    //  sbc a, <reg8>/(hl)
-    //  and <reg8>/(hl)
-    //  xor <reg8>/(hl)
-    //  or <reg8>/(hl)
-    //  cp <reg8>/(hl)
-
-    if(lo_nibble_matches(op, 0x06, 0x0E)) {
-      if(op_mnem_ == op_add || op_mnem_ == op_adc || op_mnem_ == op_sbc) {
-        return which == 1 ? OperandReg16Indirect : OperandReg8;
-      }
-    }
+  case Operand::Imm8: return OperandImm8;
 
-    return OperandReg8;
-  } else if(hi_nibble_between(op, 0xC0, 0xF0)) {
-    //   add a, <imm8>
-    //   adc a, <imm8>
-    //   sub <imm8>
-    //   sbc a, <imm8>
-    //   and <imm8>
-    //   xor <imm8>
-    //   or <imm8>
-    //   cp <imm8>
-    if(lo_nibble_matches(op, 0x06, 0x0E)) {
-      if(op_mnem_ == op_add || op_mnem_ == op_adc || op_mnem_ == op_sbc) {
-        return which == 0 ? OperandReg8 : OperandImm8;
-      }
+  // The targets of jp and call are addresses
+  case Operand::Imm16:
+    return op_mnem_ == OpcodeMnemonic::Jp || op_mnem_ == OpcodeMnemonic::Call ?
+      OperandAddress16 : OperandImm16;
 
-      return OperandImm8;
-    } else if(op == OpcodeLD_Ptr16_A) {
-      return which == 0 ? OperandPtr16 : OperandReg8;
-    } else if(op == OpcodeLD_A_Ptr16) {
-      return which == 0 ? OperandReg8 : OperandPtr16;
-    } else if(op == OpcodeLDH_a8_A) {
-      return which == 0 ? OperandLDHOffset8 : OperandReg8;
-    } else if(op == OpcodeLDH_A_a8) {
-      return which == 0 ? OperandReg8 : OperandLDHOffset8;
-    } else if(op == OpcodeLDH_CInd_A) {
-      return which == 0 ? OperandLDHRegC : OperandReg8;
-    } else if(op == OpcodeLDH_A_CInd) {
-      return which == 0 ? OperandReg8 : OperandLDHRegC;
-    }
-  } 
+  case Operand::Rel8:      return OperandRelOffset8;
+  case Operand::Offset8:   return OperandOffset8;
+  case Operand::SPOffset8: return OperandSPOffset8;
+  case Operand::Ptr16:     return OperandPtr16;
+  case Operand::HighPtr8:  return OperandLDHOffset8;
+  case Operand::RSTVector: return OperandRSTVector;
+  case Operand::BitIndex:  return OperandBitIndex;
+  }
 
   return OperandInvalid;
 }
 
 auto Instruction::reg(unsigned which) -> OperandReg
 {
-  assert(which < 2 && "Instruction::reg() called with out-of-range 'which'!");
-
-  static const OperandReg idx_to_reg8[] = {
-    RegB, RegC, RegD, RegE, RegH, RegL, RegHLInd, RegA,
-  };
-
-  static const OperandReg idx_to_reg16[] = {
-    // inc <reg16>
-    // dec <reg16>
-    // ld <reg16>,<imm16>
-    // add hl,<reg16>
-    RegBC, RegDE, RegHL, RegSP,
-
-    // push <reg16>
-    // pop <reg16>
-    RegBC, RegDE, RegHL, RegAF,
-  };
-
-  u8 op = op_;
-
-  // All 0xCB-prefixed instructions can be handled uniformly
-  if(op_CB_prefixed_) return idx_to_reg8[op_.bit(0, 2)];
-
-  if(op_mnem_ == op_inc || op_mnem_ == op_dec && which == 0) {
-    if(lo_nibble_matches(op_, 0x04, 0x05, 0x0C, 0x0D)) {    // inc/dec <reg8>
-      /*
-        0x04 - 0000 0100   // inc b
-        0x0C - 0000 1100   // inc c
-        0x14 - 0001 0100   // inc d
-        0x1C - 0001 1100   // inc e
-        0x24 - 0010 0100   // inc h
-        0x2C - 0010 1100   // inc l
-        0x34 - 0011 0100   // inc (hl)
-        0x3C - 0011 1100   // inc a
-      */
-
-      return idx_to_reg8[op_.bit(3, 5)];
-    } else if(lo_nibble_matches(op_, 0x03, 0x0B)) {         // inc/dec <reg16>
-      /*
-        0x03 - 0000 0011   // inc bc
-        0x13 - 0001 0011   // inc de
-        0x23 - 0010 0011   // inc hl
-        0x33 - 0011 0011   // inc sp
-      */
-
-      return idx_to_reg16[op_.bit(4, 5)];
-    }
-  } else if(op_mnem_ == op_push || op_mnem_ == op_pop && which == 0) {
-    /*
-      0xC1 - 1100 0001  // pop bc
-      0xD1 - 1101 0001  // pop de
-      0xE1 - 1110 0001  // pop hl
-      0xF1 - 1111 0001  // pop af
-      0xC5 - 1100 0101  // push bc
-      0xD5 - 1101 0101  // push de
-      0xE5 - 1110 0101  // push hl
-      0xF5 - 1111 0101  // push af
-    */
-
-    return idx_to_reg16[op_.bit(4, 5) + 4];
-  } else if(op == OpcodeLD_Ptr16_A) {
-    if(which == 1) return RegA;
-  } else if(op == OpcodeLD_A_Ptr16) {
-    if(which == 0) return RegA;
-  } else if(op == OpcodeLDH_a8_A) {
-    if(which == 1) return RegA;
-  } else if(op == OpcodeLDH_A_a8) {
-    if(which == 0) return RegA;
-  } else if(op == OpcodeLDH_CInd_A) {
-    if(which == 1) return RegA;
-  } else if(op == OpcodeLDH_A_CInd) {
-    if(which == 0) return RegA;
-  } else if(hi_nibble_between(op_, 0x00, 0x30)) {
-    if(lo_nibble_matches(op_, 0x06, 0x0E) && which == 0) {          // ld <reg8>, <imm8>
-      /*
-        0x06 - 0000 0110   // ld b, <imm8>
-        0x0E - 0000 1110   // ld c, <imm8>
-        0x16 - 0001 0110   // ld d, <imm8>
-        0x1E - 0001 1110   // ld e, <imm8>
-        0x26 - 0010 0110   // ld h, <imm8>
-        0x2E - 0010 1110   // ld l, <imm8>
-        0x36 - 0011 0110   // ld (hl), <imm8>
-        0x3E - 0011 1110   // ld a, <imm8>
-      */
-
-      return idx_to_reg8[op_.bit(3, 5)];
-    } else if(lo_nibble_matches(op_, 0x01, 0x09) && which == 0) {   // ld <reg16>, <imm16>
-      /*                                                            // add hl, <reg16>
-        0x01 - 0000 0001   // ld bc, <imm16>
-        0x11 - 0001 0001   // ld de, <imm16>
-        0x21 - 0010 0001   // ld hl, <imm16>
-        0x31 - 0011 0001   // ld sp, <imm16>
-      */
-
-      return idx_to_reg16[op_.bit(4, 5)];
-    } else if(lo_nibble_matches(op_, 0x02)) {                       // ld (bc), a
-      if(which == 1) return RegA;                                   // ld (de), a
-                                                                    // ld (hl+), a
-      // which == 0                                                 // ld (hl-), a
-      switch(op) {
-      case 0x02: return RegBCInd;
-      case 0x12: return RegDEInd;
-      case 0x22: return RegHLIInd;
-      case 0x32: return RegHLDInd;
-      }
-    } else if(lo_nibble_matches(op_, 0x0A)) {                       // ld a, (bc)
-      if(which == 0) return RegA;                                   // ld a, (de)
-                                                                    // ld a, (hl+)
-      // which == 1                                                 // ld a, (hl-)
-      switch(op) {
-      case 0x0A: return RegBCInd;
-      case 0x1A: return RegDEInd;
-      case 0x2A: return RegHLIInd;
-      case 0x3A: return RegHLDInd;
-      }
-    }
-  } else if(hi_nibble_between(op, 0x40, 0x70)) {     // ld <reg8>, <reg8>
-    if(op_mnem_ == op_halt) return RegInvalid;    // HALT doesn't have any operands
-
-    u8 src_idx = op_.bit(0, 2);
-    u8 dst_idx = op_.bit(3, 5);
-
-    switch(which) {
-    case 0: return idx_to_reg8[dst_idx];
-    case 1: return idx_to_reg8[src_idx];
-    }
-  } else if(hi_nibble_between(op, 0x80, 0xB0)) {
-    // The accumulator is explicit in these instructions...
-    if(op_mnem_ == op_add || op_mnem_ == op_adc || op_sbc) {
-      if(which == 0) return RegA;
-
-      // Unify codepaths (which == 1 here)
-      which = 0;
-    }
-
-    // ...but for all of them the encoding is the same
-    return which == 0 ? idx_to_reg8[op_.bit(0, 2)] : RegInvalid;
+  switch(operand(which)) {
+  case Operand::A: return RegA;
+  case Operand::B: return RegB;
+  case Operand::C: return RegC;
+  case Operand::D: return RegD;
+  case Operand::E: return RegE;
+  case Operand::H: return RegH;
+  case Operand::L: return RegL;
+
+  case Operand::AF: return RegAF;
+  case Operand::BC: return RegBC;
+  case Operand::DE: return RegDE;
+  case Operand::HL: return RegHL;
+  case Operand::SP: return RegSP;
+
+  case Operand::BCInd:  return RegBCInd;
+  case Operand::DEInd:  return RegDEInd;
+  case Operand::HLInd:  return RegHLInd;
+  case Operand::HLIInd: return RegHLIInd;
+  case Operand::HLDInd: return RegHLDInd;
+
+  default: break;
   }
 
   return RegInvalid;
@@ -575,48 +389,23 @@ auto Instruction::relOffset() -> i8
 
 auto Instruction::cond() -> OperandCondition
 {
-  static const OperandCondition cc_to_condition[] = {
-    ConditionNZ, ConditionZ, ConditionNC, ConditionC,
-  };
-
-  u8 op = op_;
-
-  // Only JP,JR,CALL,RET opcodes have an OperandCondition operand
-  if(op_mnem_ != op_jp && op_mnem_ != op_jr && op_mnem_ != op_call && op_mnem_ != op_ret) {
-    return ConditionInvalid;
+  // Only the conditional jp, jr, call and ret have
+  //   a condition, always as their first operand
+  switch(operand(0)) {
+  case Operand::NZ:       return ConditionNZ;
+  case Operand::Z:        return ConditionZ;
+  case Operand::NC:       return ConditionNC;
+  case Operand::CarrySet: return ConditionC;
+
+  default: break;
   }
 
-  // Handle unconditional JP,JR,CALL,RET opcodes
-  if(op == OpcodeJP_Always || op == OpcodeJP_Always_Indirect || op == OpcodeJR_Always || 
-      op == OpcodeCALL_Always || op == OpcodeRET_Always) {
-    return ConditionInvalid;
-  }
-
-  /*
-    0x20 - 0010 0000  // nz
-    0xC0 - 1100 0000  // nz
-    0xC2 - 1100 0010  // nz
-    0xC4 - 1100 0100  // nz
-    0xCA - 1100 1010  //  z
-    0x28 - 0010 1000  //  z
-    0xC8 - 1100 1000  //  z
-    0xCC - 1100 1100  //  z
-    0x30 - 0011 0000  // nc
-    0xD0 - 1101 0000  // nc
-    0xD2 - 1101 0010  // nc
-    0xD4 - 1101 0100  // nc
-    0x38 - 0011 1000  //  c
-    0xD8 - 1101 1000  //  c
-    0xDA - 1101 1010  //  c
-    0xDC - 1101 1100  //  c
-  */
-
-  return cc_to_condition[op_.bit(3, 4)];
+  return ConditionInvalid;
 }
 
 auto Instruction::RSTVector() -> u8
 {
-  if(op_mnem_ != op_rst) return RSTVectorInvalid;
+  if(op_mnem_ != OpcodeMnemonic::Rst) return RSTVectorInvalid;
 
   /*
     0xC7 - 1100 0111  // 00h
@@ -651,760 +440,198 @@ auto Instruction::bitIndex() -> unsigned
 
 auto Instruction::toStr() -> std::string
 {
-  auto op = opcodeToStr();
-
-  // Right-pad the mnemonic with spaces to a width of 4
-  while(op.length() < 4) op += ' ';
-
-  auto operands = operandsToStr();
+  char buf[Disassembler::MaxLineLength];
+  auto length = format(buf, sizeof(buf));
 
-  return util::fmt("%s %s", op.data(), operands.data());
+  return std::string(buf, length);
 }
 
-auto Instruction::disassemble0x00_0x30(u8 *ptr) -> u8 *
+auto Instruction::format(char *buf, size_t size) -> size_t
 {
-  dispatchOnLoNibble(
-      std::make_pair((u8)0x00, [this,&ptr]() { dispatchOnHiNibble(
-        //  nop
-        std::make_pair(OpcodeNOP, [this,&ptr]() {
-          op_mnem_ = op_nop;
-        }),
-
-        //  stop
-        std::make_pair(OpcodeSTOP, [this,&ptr]() {
-          op_mnem_ = op_stop;
-
-          // STOP has a dummy 0x00 operand
-          operand_ = *ptr++;
-        }),
-
-        //  jr nz, <r8>
-        std::make_pair((u8)0x20, [this,&ptr]() {
-          op_mnem_ = op_jr;
-
-          // Fetch the jump displacement
-          operand_ = *ptr++;
-        }),
-        //  jr nc, <r8>
-        std::make_pair((u8)0x30, [this,&ptr]() {
-          op_mnem_ = op_jr;
-
-          // Fetch the jump displacement
-          operand_ = *ptr++;
-        }));
-      }),
-
-      //  ld bc, <imm16>
-      //  ld de, <imm16>
-      //  ld hl, <imm16>
-      //  ld sp, <imm16>
-      std::make_pair((u8)0x01, [this,&ptr]() {
-        op_mnem_ = op_ld;
-
-        // Fetch the source address
-        //   - Little-endian byte ordering
-        operand_lo_ = *ptr++;
-        operand_hi_ = *ptr++;
-      }),
-      //  ld (bc), a
-      //  ld (de), a
-      //  ld (hl+), a
-      //  ld (hl-), a
-      std::make_pair((u8)0x02, [this,&ptr]() {
-        op_mnem_ = op_ld;
-      }),
-
-      //  inc bc
-      //  inc de
-      //  inc hl
-      //  inc sp
-      std::make_pair((u8)0x03, [this,&ptr]() {
-        op_mnem_ = op_inc;
-      }),
-
-      //  dec bc
-      //  dec de
-      //  dec hl
-      //  dec sp
-      std::make_pair((u8)0x0B, [this,&ptr]() {
-        op_mnem_ = op_dec;
-      }),
-
-      //  inc b
-      //  inc d
-      //  inc h
-      //  inc (hl)
-      std::make_pair((u8)0x04, [this,&ptr]() {
-        op_mnem_ = op_inc;
-      }),
-      //  inc c
-      //  inc e
-      //  inc l
-      //  inc a
-      std::make_pair((u8)0x0C, [this,&ptr]() {
-        op_mnem_ = op_inc;
-      }),
-
-      //  dec b
-      //  dec d
-      //  dec h
-      //  dec (hl)
-      std::make_pair((u8)0x05, [this,&ptr]() {
-        op_mnem_ = op_dec;
-      }),
-      //  dec c
-      //  dec e
-      //  dec l
-      //  dec a
-      std::make_pair((u8)0x0D, [this,&ptr]() {
-        op_mnem_ = op_dec;
-      }),
-
-      //  ld b, <imm8>
-      //  ld d, <imm8>
-      //  ld h, <imm8>
-      //  ld (hl), <imm8>
-      std::make_pair((u8)0x06, [this,&ptr]() {
-        op_mnem_ = op_ld;
-
-        // Fetch the immediate data
-        operand_ = *ptr++;
-      }),
-      //  ld c, <imm8>
-      //  ld e, <imm8>
-      //  ld l, <imm8>
-      //  ld a, <imm8>
-      std::make_pair((u8)0x0E, [this,&ptr]() {
-        op_mnem_ = op_ld;
-
-        // Fetch the immediate data
-        operand_ = *ptr++;
-      }),
-
-      std::make_pair((u8)0x07, [this,&ptr]() { dispatchOnHiNibble(
-        //  rlca
-        std::make_pair(OpcodeRLCA, [this,&ptr]() {
-          op_mnem_ = op_rlca;
-        }),
-
-        //  rla
-        std::make_pair(OpcodeRLA, [this,&ptr]() {
-          op_mnem_ = op_rla;
-        }),
-
-        //  daa
-        std::make_pair(OpcodeDAA, [this,&ptr]() {
-          op_mnem_ = op_daa;
-        }),
-
-        //  scf
-        std::make_pair(OpcodeSCF, [this,&ptr]() {
-          op_mnem_ = op_scf;
-        }));
-      }),
-      std::make_pair((u8)0x0F, [this,&ptr]() { dispatchOnHiNibble(
-        //  rrca
-        std::make_pair(OpcodeRRCA, [this,&ptr]() {
-          op_mnem_ = op_rrca;
-        }),
-
-        //  rra
-        std::make_pair(OpcodeRRA, [this,&ptr]() {
-          op_mnem_ = op_rra;
-        }),
-
-        //  cpl 
-        std::make_pair(OpcodeCPL, [this,&ptr]() {
-          op_mnem_ = op_cpl;
-        }),
-
-        //  ccf
-        std::make_pair(OpcodeCCF, [this,&ptr]() {
-          op_mnem_ = op_ccf;
-        }));
-      }),
-
-      std::make_pair((u8)0x08, [this,&ptr]() { dispatchOnHiNibble(
-          //  ld (<addr16>), SP
-          std::make_pair((u8)0x00, [this,&ptr]() {
-            op_mnem_ = op_ld;
-
-            // Fetch the source address
-            //   - Little-endian byte ordering
-            operand_lo_ = *ptr++;
-            operand_hi_ = *ptr++;
-          }),
-
-          //  jr <r8>
-          std::make_pair((u8)0x10, [this,&ptr]() {
-            op_mnem_ = op_jr;
-
-            // Fetch the jump displacement
-            operand_ = *ptr++;
-          }),
-          //  jr z, <r8>
-          std::make_pair((u8)0x20, [this,&ptr]() {
-            op_mnem_ = op_jr;
-
-            // Fetch the jump displacement
-            operand_ = *ptr++;
-          }),
-          //  jr c, <r8>
-          std::make_pair((u8)0x30, [this,&ptr]() {
-            op_mnem_ = op_jr;
-
-            // Fetch the jump displacement
-            operand_ = *ptr++;
-          }));
-      }),
-
-      //  add hl, bc
-      //  add hl, de
-      //  add hl, hl
-      //  add hl, bc
-      std::make_pair((u8)0x09, [this,&ptr]() {
-        op_mnem_ = op_add;
-      }),
-
-      //  ld a, (bc)
-      //  ld a, (de)
-      //  ld a, (hl+)
-      //  ld a, (hl-)
-      std::make_pair((u8)0x0A, [this,&ptr]() {
-        op_mnem_ = op_ld;
-      })
-  );
+  LineWriter out(buf, size);
+  write(out);
 
-  return ptr;
+  return out.finish();
 }
 
-auto Instruction::disassemble0x80_0xB0(u8 *ptr) -> u8 *
+auto Instruction::write(LineWriter& out) -> void
 {
-  dispatchOnHiNibble(
-      std::make_pair((u8)0x80, [this,&ptr]() {
-        if(lo_nibble_between(op_, 0x00, 0x07)) {
-          op_mnem_ = op_add;
-        } else {
-          op_mnem_ = op_adc;
-        }
-      }),
-
-      std::make_pair((u8)0x90, [this,&ptr]() {
-        if(lo_nibble_between(op_, 0x00, 0x07)) {
-          op_mnem_ = op_sub;
-        } else {
-          op_mnem_ = op_sbc;
-        }
-      }),
-
-      std::make_pair((u8)0xA0, [this,&ptr]() {
-        if(lo_nibble_between(op_, 0x00, 0x07)) {
-          op_mnem_ = op_and;
-        } else {
-          op_mnem_ = op_xor;
-        }
-      }),
-
-      std::make_pair((u8)0xB0, [this,&ptr]() {
-        if(lo_nibble_between(op_, 0x00, 0x07)) {
-          op_mnem_ = op_or;
-        } else {
-          op_mnem_ = op_cp;
-        }
-      })
-  );
+  assert(mem_ && (info_ || data_) &&
+      "Instruction::toStr() can be called ONLY after Instruction::disassemble()!");
 
-  return ptr;
-}
+  if(data_) {
+    out.put("db   $").hex8(op_);
+    return;
+  }
 
-auto Instruction::disassemble0xC0_0xF0(u8 *ptr) -> u8 *
-{
-  dispatchOnLoNibble(
-      std::make_pair((u8)0x00, [this,&ptr]() { dispatchOnHiNibble(
-          //  ret nz
-          std::make_pair((u8)0xC0, [this,&ptr]() {
-            op_mnem_ = op_ret;
-          }),
-          //  ret nc
-          std::make_pair((u8)0xD0, [this,&ptr]() {
-            op_mnem_ = op_ret;
-          }),
-
-          //  ld ($FF00+<a8>), a
-          std::make_pair((u8)0xE0, [this,&ptr]() {
-            op_mnem_ = op_ldh;
-
-            // Fetch the load offset
-            operand_ = *ptr++;
-          }),
-          //  ld a, ($FF00+<a8>)
-          std::make_pair((u8)0xF0, [this,&ptr]() {
-            op_mnem_ = op_ldh;
-
-            // Fetch the load offset
-            operand_ = *ptr++;
-          }));
-      }),
-
-      std::make_pair((u8)0x01, [this,&ptr]() {
-          op_mnem_ = op_pop;
-      }),
-
-      std::make_pair((u8)0x02, [this,&ptr]() { dispatchOnHiNibble(
-          //  jp nz, <a16>
-          std::make_pair((u8)0xC0, [this,&ptr]() {
-            op_mnem_ = op_jp;
-
-            // Fetch the jump address
-            //   - Little-endian byte ordering
-            operand_lo_ = *ptr++;
-            operand_hi_ = *ptr++;
-          }),
-          //  jp nc, <a16>
-          std::make_pair((u8)0xD0, [this,&ptr]() {
-            op_mnem_ = op_jp;
-
-            // Fetch the jump address
-            //   - Little-endian byte ordering
-            operand_lo_ = *ptr++;
-            operand_hi_ = *ptr++;
-          }),
-
-          //  ld ($FF00+c), a
-          std::make_pair((u8)0xE0, [this,&ptr]() {
-            op_mnem_ = op_ldh;
-          }),
-          //  ld a, ($FF00+c)
-          std::make_pair((u8)0xF0, [this,&ptr]() {
-            op_mnem_ = op_ldh;
-          }));
-      }),
-
-      std::make_pair((u8)0x03, [this,&ptr]() { dispatchOnHiNibble(
-          //  jp <a16>
-          std::make_pair((u8)0xC0, [this,&ptr]() {
-            op_mnem_ = op_jp;
-
-            // Fetch the jump address
-            //   - Little-endian byte ordering
-            operand_lo_ = *ptr++;
-            operand_hi_ = *ptr++;
-          }),
-
-          std::make_pair((u8)0xD0, [this,&ptr]() {
-            throw Disassembler::IllegalOpcodeError(ptr-mem_-1, op_);
-          }),
-          std::make_pair((u8)0xE0, [this,&ptr]() {
-            throw Disassembler::IllegalOpcodeError(ptr-mem_-1, op_);
-          }),
-
-          //  di
-          std::make_pair((u8)0xF0, [this,&ptr]() {
-            op_mnem_ = op_di;
-          }));
-      }),
-
-      std::make_pair((u8)0x04, [this,&ptr]() { dispatchOnHiNibble(
-          //  call nz, <a16>
-          std::make_pair((u8)0xC0, [this,&ptr]() {
-            op_mnem_ = op_call;
-
-            // Fetch the call address
-            //   - Little-endian byte ordering
-            operand_lo_ = *ptr++;
-            operand_hi_ = *ptr++;
-          }),
-          //  call nc, <a16>
-          std::make_pair((u8)0xD0, [this,&ptr]() {
-            op_mnem_ = op_call;
-
-            // Fetch the call address
-            //   - Little-endian byte ordering
-            operand_lo_ = *ptr++;
-            operand_hi_ = *ptr++;
-          }),
-
-
-          std::make_pair((u8)0xE0, [this,&ptr]() {
-            throw Disassembler::IllegalOpcodeError(ptr-mem_-1, op_);
-          }),
-          std::make_pair((u8)0xF0, [this,&ptr]() {
-            throw Disassembler::IllegalOpcodeError(ptr-mem_-1, op_);
-          }));
-      }),
-
-      //  push bc
-      //  push de
-      //  push hl
-      //  push af
-      std::make_pair((u8)0x05, [this,&ptr]() {
-          op_mnem_ = op_push;
-      }),
-
-      std::make_pair((u8)0x06, [this,&ptr]() { dispatchOnHiNibble(
-          //  add a, <d8>
-          std::make_pair((u8)0xC0, [this,&ptr]() {
-            op_mnem_ = op_add;
-
-            // Fetch the immediate data
-            operand_ = *ptr++;
-          }),
-
-          //  sub <d8>
-          std::make_pair((u8)0xD0, [this,&ptr]() {
-            op_mnem_ = op_sub;
-
-            // Fetch the immediate data
-            operand_ = *ptr++;
-          }),
-
-          //  and <d8>
-          std::make_pair((u8)0xE0, [this,&ptr]() {
-            op_mnem_ = op_and;
-
-            // Fetch the immediate data
-            operand_ = *ptr++;
-          }),
-
-          //  or <d8>
-          std::make_pair((u8)0xF0, [this,&ptr]() {
-            op_mnem_ = op_or;
-
-            // Fetch the immediate data
-            operand_ = *ptr++;
-          }));
-      }),
-
-      //  rst 0x00
-      //  rst 0x10
-      //  rst 0x20
-      //  rst 0x30
-      std::make_pair((u8)0x07, [this,&ptr]() {
-        op_mnem_ = op_rst;
-      }),
-
-      std::make_pair((u8)0x08, [this,&ptr]() { dispatchOnHiNibble(
-          //  ret z
-          std::make_pair((u8)0xC0, [this,&ptr]() {
-            op_mnem_ = op_ret;
-          }),
-          //  ret c
-          std::make_pair((u8)0xD0, [this,&ptr]() {
-            op_mnem_ = op_ret;
-          }),
-
-          //  add sp, <r8>
-          std::make_pair((u8)0xE0, [this,&ptr]() {
-            op_mnem_ = op_add;
-
-            // Fetch immediate data
-            operand_ = *ptr++;
-          }),
-
-          //  ld hl, sp+<r8>
-          std::make_pair((u8)0xF0, [this,&ptr]() {
-            op_mnem_ = op_ld;
-
-            // Fetch immediate data
-            operand_ = *ptr++;
-          }));
-      }),
-
-      std::make_pair((u8)0x09, [this,&ptr]() { dispatchOnHiNibble(
-          //  ret
-          std::make_pair((u8)0xC0, [this,&ptr]() {
-            op_mnem_ = op_ret;
-          }),
-          //  reti
-          std::make_pair((u8)0xD0, [this,&ptr]() {
-            op_mnem_ = op_reti;
-          }),
-
-          //  jp (hl)
-          std::make_pair((u8)0xE0, [this,&ptr]() {
-            op_mnem_ = op_jp;
-          }),
-
-          //  ld sp, hl
-          std::make_pair((u8)0xF0, [this,&ptr]() {
-            op_mnem_ = op_ld;
-          }));
-      }),
-
-      std::make_pair((u8)0x0A, [this,&ptr]() { dispatchOnHiNibble(
-          //  jp z, <a16>
-          std::make_pair((u8)0xC0, [this,&ptr]() {
-            op_mnem_ = op_jp;
-
-            // Fetch the jump address
-            operand_lo_ = *ptr++;
-            operand_hi_ = *ptr++;
-          }),
-          //  jp c, <a16>
-          std::make_pair((u8)0xD0, [this,&ptr]() {
-            op_mnem_ = op_jp;
-
-            // Fetch the jump address
-            operand_lo_ = *ptr++;
-            operand_hi_ = *ptr++;
-          }),
-
-          //  ld (<a16>), a 
-          std::make_pair((u8)0xE0, [this,&ptr]() {
-            op_mnem_ = op_ld;
-
-            // Fetch load address
-            operand_lo_ = *ptr++;
-            operand_hi_ = *ptr++;
-          }),
-          //  ld a, (<a16>)
-          std::make_pair((u8)0xF0, [this,&ptr]() {
-            op_mnem_ = op_ld;
-
-            // Fetch load address
-            operand_lo_ = *ptr++;
-            operand_hi_ = *ptr++;
-          }));
-      }),
-
-      std::make_pair((u8)0x0B, [this,&ptr]() { dispatchOnHiNibble(
-          //  <cb prefix>
-          std::make_pair((u8)0xC0, [this,&ptr]() {
-            assert(0 && "decode0xC0_0xF0() called with CB-prefixed instruction!");
-          }),
-
-          std::make_pair((u8)0xD0, [this,&ptr]() {
-            throw Disassembler::IllegalOpcodeError(ptr-mem_-1, op_);
-          }),
-          std::make_pair((u8)0xE0, [this,&ptr]() {
-            throw Disassembler::IllegalOpcodeError(ptr-mem_-1, op_);
-          }),
-
-          //  ei
-          std::make_pair((u8)0xF0, [this,&ptr]() {
-            op_mnem_ = op_ei;
-          }));
-      }),
-
-      std::make_pair((u8)0x0C, [this,&ptr]() { dispatchOnHiNibble(
-          //  call z, <a16>
-          std::make_pair((u8)0xC0, [this,&ptr]() {
-            op_mnem_ = op_call;
-
-            // Fetch the call address
-            //   - Little-endian byte ordering
-            operand_lo_ = *ptr++;
-            operand_hi_ = *ptr++;
-          }),
-          //  call c, <a16>
-          std::make_pair((u8)0xD0, [this,&ptr]() {
-            op_mnem_ = op_call;
-
-            // Fetch the call address
-            //   - Little-endian byte ordering
-            operand_lo_ = *ptr++;
-            operand_hi_ = *ptr++;
-          }),
-
-
-          std::make_pair((u8)0xE0, [this,&ptr]() {
-            throw Disassembler::IllegalOpcodeError(ptr-mem_-1, op_);
-          }),
-          std::make_pair((u8)0xF0, [this,&ptr]() {
-            throw Disassembler::IllegalOpcodeError(ptr-mem_-1, op_);
-          }));
-      }),
-
-      std::make_pair((u8)0x0D, [this,&ptr]() { dispatchOnHiNibble(
-          //  call <a16>
-          std::make_pair((u8)0xC0, [this,&ptr]() {
-            op_mnem_ = op_call;
-
-            // Fetch the call address
-            //   - Little-endian byte ordering
-            operand_lo_ = *ptr++;
-            operand_hi_ = *ptr++;
-          }),
-
-          std::make_pair((u8)0xD0, [this,&ptr]() {
-            throw Disassembler::IllegalOpcodeError(ptr-mem_-1, op_);
-          }),
-          std::make_pair((u8)0xE0, [this,&ptr]() {
-            throw Disassembler::IllegalOpcodeError(ptr-mem_-1, op_);
-          }),
-          std::make_pair((u8)0xF0, [this,&ptr]() {
-            throw Disassembler::IllegalOpcodeError(ptr-mem_-1, op_);
-          }));
-      }),
-
-      std::make_pair((u8)0x0E, [this,&ptr]() { dispatchOnHiNibble(
-          //  adc a, <d8>
-          std::make_pair((u8)0xC0, [this,&ptr]() {
-            op_mnem_ = op_adc;
-
-            // Fetch the immediate data
-            operand_ = *ptr++;
-          }),
-
-          //  sbc a, <d8>
-          std::make_pair((u8)0xD0, [this,&ptr]() {
-            op_mnem_ = op_sbc;
-
-            // Fetch the immediate data
-            operand_ = *ptr++;
-          }),
-
-          //  and <d8>
-          std::make_pair((u8)0xE0, [this,&ptr]() {
-            op_mnem_ = op_xor;
-
-            // Fetch the immediate data
-            operand_ = *ptr++;
-          }),
-
-          //  or <d8>
-          std::make_pair((u8)0xF0, [this,&ptr]() {
-            op_mnem_ = op_cp;
-
-            // Fetch the immediate data
-            operand_ = *ptr++;
-          }));
-      }),
-
-      //  rst 0x08
-      //  rst 0x18
-      //  rst 0x28
-      //  rst 0x38
-      std::make_pair((u8)0x0F, [this,&ptr]() {
-        op_mnem_ = op_rst;
-      })
-  );
+  const auto& text = opcode_texts()[info_ - sm83::OpcodeTable.data()];
 
-  return ptr;
+  out.putArray(text.prefix, text.prefix_length);
+  if(text.operand >= 0) writeOperand(out, text.operand);
+  out.putArray(text.suffix, text.suffix_length);
 }
 
-auto Instruction::disassembleCBPrefixed(u8 *ptr) -> u8 *
+auto Instruction::opcode_texts() -> const OpcodeText *
 {
-  op_CB_prefixed_ = true;
+  static const auto texts = [] {
+    std::array<OpcodeText, sm83::OpcodeTable.size()> texts;
+
+    for(size_t i = 0; i < texts.size(); i++) {
+      if(sm83::OpcodeTable[i].mnemonic == OpcodeMnemonic::Invalid) continue;
+
+      // The operands' values are irrelevant, as the
+      //   one which depends on them is left out
+      u8 code[3] = { (u8)i, 0x00, 0x00 };
+      if(i >= 0x100) {
+        code[0] = CB_prefix;
+        code[1] = (u8)i;
+      }
 
-  // Discard the fetched prefix and fetch the real opcode
-  u8 op = *ptr++;
-  op_ = op;
+      Instruction instruction(code);
+      instruction.disassemble(code);
 
-  if(hi_nibble_between(op, 0x00, 0x30)) {
-    static const OpcodeMnemonic op_mnem[] = {
-      op_rlc, op_rrc,
-      op_rl, op_rr,
-      op_sla, op_sra,
-      op_swap, op_srl,
-    };
-
-    /*
-      0x07 - 0000 0111  // rlc a
-      0x0F - 0000 1111  // rrc a
-      0x17 - 0001 0111  // rl a
-      0x1F - 0001 1111  // rr a
-      0x27 - 0010 0111  // sla a
-      0x2F - 0010 1111  // sra a
-      0x37 - 0011 0111  // swap a
-      0x3F - 0011 1111  // srl a
-    */
-    op_mnem_ = op_mnem[op_.bit(3, 5)];
-  } else if(hi_nibble_between(op, 0x40, 0x70)) {    // bit <0-7>, <reg8>
-    op_mnem_ = op_bit;
-  } else if(hi_nibble_between(op, 0x80, 0xB0)) {    // res <0-7>, <reg8>
-    op_mnem_ = op_res;
-  } else {                                          // set <0-7>, <reg8>
-    op_mnem_ = op_set;
-  }
+      auto& text = texts[i];
+      text.operand = instruction.variableOperand();
 
-  return ptr;
-}
+      // LineWriter always leaves room for the NUL terminator,
+      //   which isn't needed here
+      LineWriter prefix(text.prefix, sizeof(text.prefix) + 1);
+      LineWriter suffix(text.suffix, sizeof(text.suffix) + 1);
 
-auto Instruction::opcodeToStr() -> std::string
-{
-  assert(mem_ && op_mnem_ != op_Invalid &&
-      "Instruction::toStr() can be called ONLY after decode() on that object!");
-
-  std::string opcode_mnem;
-  if(!op_CB_prefixed_) {
-    opcode_mnem = op_mnem_to_str(op_mnem_);
-  } else {
-    opcode_mnem = op_0xCB_mnem_to_str(op_mnem_);
-  }
+      instruction.writeOpcode(prefix);
+      prefix.put(' ');
 
-  return opcode_mnem;
-}
+      int num_operands = instruction.numOperands();
+      for(int which = 0; which < num_operands; which++) {
+        auto& out = text.operand >= 0 && which > text.operand ? suffix : prefix;
 
-auto Instruction::operandsToStr() -> std::string
-{
-  assert(mem_ && op_mnem_ != op_Invalid &&
-      "Instruction::operandsToStr() can be called ONLY after Instruction::disassemble()!");
+        // Comma between operands
+        if(which > 0) out.put(", ");
 
-  unsigned num_operands = numOperands();
-  if(!num_operands) return "";     // Instruction has no operands
+        if(which != text.operand) instruction.writeOperand(out, which);
+      }
 
-  std::ostringstream os;
+      assert(!prefix.full() && !suffix.full() && "OpcodeText is too small for an opcode's text!");
 
-  for(auto i = 0; i < num_operands; i++) {
-    auto type = operandType(i);
+      text.prefix_length = prefix.length();
+      text.suffix_length = suffix.length();
+    }
 
-    // Comma between operands
-    if(i > 0) os << ", ";
+    return texts;
+  }();
 
-    switch(type) {
-    case OperandInvalid: assert(0);   // Unreachable
+  return texts.data();
+}
 
-    case OperandNone:
-    case OperandImplied: return "";
+auto Instruction::variableOperand() -> int
+{
+  int num_operands = numOperands();
+  for(int which = 0; which < num_operands; which++) {
+    switch(operandType(which)) {
+    case OperandImm8:
+    case OperandImm16:
+    case OperandAddress16:
+    case OperandRelOffset8:
+    case OperandOffset8:
+    case OperandSPOffset8:
+    case OperandPtr16:
+    case OperandLDHOffset8:
+      return which;
 
-    case OperandRSTVector:
-      os << util::fmt("$%.2X", RSTVector());
-      break;
+    default: break;
+    }
+  }
 
-    case OperandCond:
-      os << OperandCondition_to_str(cond());
-      break;
+  return -1;
+}
 
-    case OperandReg8:
-    case OperandReg16:
+auto Instruction::writeOpcode(LineWriter& out) -> void
+{
+  auto start = out.length();
 
-    case OperandReg16Indirect:
-      os << OperandReg_to_str(reg(i));
-      break;
+  out.put(sm83::mnemonic_name(op_mnem_));
 
-    case OperandImm8:
-      os << util::fmt("$%.2X", imm8());
-      break;
+  // Right-pad the mnemonic with spaces to a width of 4
+  out.padTo(start + 4);
+}
 
-    case OperandImm16:
-    case OperandAddress16:
-      os << util::fmt("$%.4X", imm16());
-      break;
+// Writes a signed offset as [-]$XX
+static auto write_signed_offset(LineWriter& out, i8 offset) -> void
+{
+  if(offset < 0) out.put('-');
 
-    case OperandRelOffset8:
-      os << util::fmt("<$%.4X>", (intptr_t)offset_ + relOffset() + 2);
-      break;
+  out.put('$').hex8(offset < 0 ? -offset : offset);
+}
 
-    case OperandPtr16:
-      os << util::fmt("($%.4X)", address());
-      break;
+auto Instruction::writeOperand(LineWriter& out, unsigned which) -> void
+{
+  switch(operandType(which)) {
+  case OperandInvalid: assert(0);   // Unreachable
+
+  case OperandNone:
+  case OperandImplied: break;
+
+  case OperandRSTVector:
+    out.put('$').hex8(RSTVector());
+    break;
+
+  case OperandCond:
+    out.put(OperandCondition_to_str(cond()));
+    break;
+
+  case OperandReg8:
+  case OperandReg16:
+  case OperandReg16Indirect:
+    out.put(OperandReg_to_str(reg(which)));
+    break;
+
+  case OperandImm8:
+    out.put('$').hex8(imm8());
+    break;
+
+  case OperandImm16:
+  case OperandAddress16:
+    out.put('$').hex16(imm16());
+    break;
+
+  case OperandRelOffset8: {
+    // Targets before the start of the binary (or past $FFFF, when
+    //   the offsets are addresses) wrap around the 16-bit address
+    //   space like PC does
+    intptr_t target = (intptr_t)offset_ + relOffset() + 2;
+    if(target < 0 || addresses_) target &= 0xFFFF;
+
+    out.put("<$").hex(target, 4).put('>');
+    break;
+  }
 
-    case OperandLDHOffset8:
-      os << util::fmt("($FF00+$%.2X)", imm8());
-      break;
+  case OperandOffset8:
+    write_signed_offset(out, relOffset());
+    break;
 
-    case OperandLDHRegC:
-      os << "($FF00+c)";
-      break;
+  case OperandSPOffset8:
+    out.put("sp");
+    if(relOffset() >= 0) out.put('+');
 
-    case OperandBitIndex:
-      os << util::fmt("%u", bitIndex());
-      break;
-    }
-  }
+    write_signed_offset(out, relOffset());
+    break;
+
+  case OperandPtr16:
+    out.put("($").hex16(address()).put(')');
+    break;
 
-  return os.str();
+  case OperandLDHOffset8:
+    out.put("($FF00+$").hex8(imm8()).put(')');
+    break;
+
+  case OperandLDHRegC:
+    out.put("($FF00+c)");
+    break;
+
+  case OperandBitIndex:
+    out.digit(bitIndex());
+    break;
+  }
 }
 
 Disassembler::IllegalOpcodeError::IllegalOpcodeError(
@@ -1420,7 +647,7 @@ auto Disassembler::IllegalOperandError::format_error(
 {
 #define FMT_BASE "illegal operand for opcode 0x%.2x@0x%.4x (%s) -> "
 #define FMT_ARGS (unsigned)op, (unsigned)offset,                                    \
-                  Instruction::op_mnem_to_str((OpcodeMnemonic)op).data(), operand
+                  sm83::mnemonic_name(sm83::opcode_info(op).mnemonic), operand
 
   switch(op_size) {
   case OperandSize::Operand_u8:  return util::fmt(FMT_BASE "0x%.2x", FMT_ARGS);
@@ -1445,38 +672,69 @@ auto Disassembler::begin(u8 *mem) -> Disassembler&
   // Setup the memory pointer and the cursor
   //   to it's beginning
   mem_ = cursor_ = mem;
+  end_ = nullptr;
 
   return *this;
 }
 
+auto Disassembler::begin(u8 *mem, size_t size) -> Disassembler&
+{
+  begin(mem);
+  end_ = mem + size;
+
+  return *this;
+}
+
+auto Disassembler::done() const -> bool
+{
+  return end_ && cursor_ >= end_;
+}
+
+auto Disassembler::offset() const -> size_t
+{
+  return cursor_ - mem_;
+}
+
 auto Disassembler::singleStep() -> std::string
 {
+  char buf[MaxLineLength];
+  auto length = singleStep(buf, sizeof(buf));
+
+  return std::string(buf, length);
+}
+
+auto Disassembler::singleStep(char *buf, size_t size) -> size_t
+{
+  assert(!done() && "Disassembler::singleStep() called past the end of the binary!");
+
   Instruction instruction(mem_);
   u8 *current_instruction = cursor_;
 
-  std::ostringstream out;
+  LineWriter out(buf, size);
 
   // Append the instruction's offset on the left
-  out << util::fmt("%.4X      ", cursor_ - mem_);
+  out.hex(cursor_ - mem_, 4).put("      ");
+
+  // Disassemble and append the instruction itself, or
+  //   a 'db' of a byte which isn't an opcode
+  instruction.decode(cursor_, end_ ? end_ : cursor_ + Instruction::MaxLength);
 
-  // Disassemble and append the instruction itself
-  cursor_ = instruction.disassemble(cursor_);
-  out << instruction.toStr();
+  instruction.write(out);
 
   // Pad the output to 30 columns (or add a single space
   //   in case it's width exceedes 30)
-  do { out << ' '; } while(out.tellp() < 30);
+  out.put(' ').padTo(30);
 
   // Write the raw bytes that make up the instruction on the right
-  out << ';';
+  out.put(';');
   while(current_instruction < cursor_) {
-    out << util::fmt(" %.2X", *current_instruction);
-
+    out.put(' ').hex8(*current_instruction);
     current_instruction++;
   }
-  out << '\n';
 
-  return out.str();
+  out.put('\n');
+
+  return out.finish();
 }
 
 }
@@ -0,0 +1,193 @@
+#include <device/sm83/cpu.h>
+#include <device/sm83/ops.h>
+#include <device/sm83/opcodes.h>
+#include <device/sm83/profiler.h>
+#include <device/sm83/trace.h>
+
+namespace brgb::sm83 {
+
+auto Processor::profiler(Profiler *profiler) -> Processor&
+{
+  profiler_ = profiler;
+  profile_pages_.fill(nullptr);
+
+  if(profiler_) profiler_->begin(cycles_);
+
+  updateInstrumented();
+
+  return *this;
+}
+
+auto Processor::profiler() const -> Profiler *
+{
+  return profiler_;
+}
+
+auto Processor::tracer(TraceWriter *tracer) -> Processor&
+{
+  tracer_ = tracer;
+
+  updateInstrumented();
+
+  return *this;
+}
+
+auto Processor::tracer() const -> TraceWriter *
+{
+  return tracer_;
+}
+
+auto Processor::addBreakpoint(u16 addr) -> Processor&
+{
+  if(breakpoints_[addr]) return *this;
+
+  breakpoints_[addr] = true;
+  num_breakpoints_++;
+
+  // None of the Blocks can contain the breakpoint
+  flushBlocks();
+  updateInstrumented();
+
+  return *this;
+}
+
+auto Processor::removeBreakpoint(u16 addr) -> Processor&
+{
+  if(!breakpoints_[addr]) return *this;
+
+  breakpoints_[addr] = false;
+  num_breakpoints_--;
+
+  // Let the Blocks which were cut short grow back
+  flushBlocks();
+  updateInstrumented();
+
+  return *this;
+}
+
+auto Processor::clearBreakpoints() -> Processor&
+{
+  if(!num_breakpoints_) return *this;
+
+  breakpoints_.reset();
+  num_breakpoints_ = 0;
+
+  flushBlocks();
+  updateInstrumented();
+
+  return *this;
+}
+
+auto Processor::breakpointHit() const -> bool
+{
+  return break_hit_;
+}
+
+auto Processor::updateInstrumented() -> void
+{
+  // Table and Threaded have no Blocks to cut short of breakpoints
+  bool per_instruction = engine_ == Engine::Table || engine_ == Engine::Threaded;
+
+  instrumented_ = profiler_ || tracer_ || (num_breakpoints_ && per_instruction);
+}
+
+auto Processor::executeInstrumented(unsigned instructions) -> unsigned
+{
+  auto interrupt_state = interruptState();
+
+  Registers rf = r;
+  u16 last_pc = rf.pc;
+
+  unsigned executed = 0;
+  while(executed < instructions) {
+    // The first instruction was checked by execute()
+    if(executed && breakpointAt(rf.pc)) break;
+
+    last_pc = rf.pc;
+
+    u16 sp = rf.sp;
+    u64 start = cycles_;
+
+    TraceRecord record;
+    if(tracer_) {
+      record.cycle = cycles_;
+      record.pc = rf.pc; record.sp = rf.sp;
+      record.af = rf.af(); record.bc = rf.bc();
+      record.de = rf.de(); record.hl = rf.hl();
+      record.ime = ime_;
+      record.reserved = 0;
+    }
+
+    Profiler::Entry *entry = profiler_ ? &profileEntry(rf.pc) : nullptr;
+
+    u8 op = opcode(rf);
+
+    if(tracer_) {
+      record.opcode = op;
+
+      tracer_->record(record);
+    }
+
+    (this->*OpTable[op])(rf);
+    executed++;
+
+    if(profiler_) {
+      entry->count++;
+      entry->cycles += cycles_ - start;
+
+      // Conditional calls/returns which weren't taken leave SP alone
+      //   - 'op' is the 0xCB prefix for the CB-prefixed opcodes,
+      //     none of which are calls or returns
+      const auto& info = opcode_info(op);
+
+      if(info.is(OpCall) && rf.sp == (u16)(sp - 2)) {
+        profiler_->call(profilePage(rf.pc)->bank, rf.pc, sp, cycles_);
+      } else if(info.is(OpReturn) && rf.sp == (u16)(sp + 2)) {
+        profiler_->ret(rf.sp, cycles_);
+      }
+    }
+
+    if(BRGB_UNLIKELY(interruptState() != interrupt_state || cycles_ > until_)) break;
+  }
+
+  r = rf;
+  last_pc_ = last_pc;
+
+  return executed;
+}
+
+auto Processor::profilePage(u16 addr) -> Profiler::Page *
+{
+  auto& page = profile_pages_[addr >> 8];
+  if(BRGB_UNLIKELY(!page)) {
+    u16 base = addr & 0xFF00;
+
+    page = profiler_->page(memoryBank(base), base);
+  }
+
+  return page;
+}
+
+auto Processor::profileEntry(u16 addr) -> Profiler::Entry&
+{
+  auto& entry = profilePage(addr)->entries[addr & 0xFF];
+
+  // Grab the instruction's bytes for the disassembly in
+  //   Profiler::report(), while they're still mapped
+  if(BRGB_UNLIKELY(!entry.count && !entry.known)) {
+    bool cacheable = true;
+    for(unsigned i = 0; i < 3; i++) {
+      cacheable = cacheable && memoryBank(addr + i) != Uncacheable;
+    }
+
+    if(cacheable) {
+      for(unsigned i = 0; i < 3; i++) entry.code[i] = peek(addr + i);
+
+      entry.known = true;
+    }
+  }
+
+  return entry;
+}
+
+}
@@ -0,0 +1,563 @@
+#include <device/sm83/cpu.h>
+#include <device/sm83/ops.h>
+#include <device/sm83/jit.h>
+#include <device/sm83/opcodes.h>
+
+#include <sys/mman.h>
+
+#include <optional>
+#include <algorithm>
+
+#include <cstring>
+#include <cstddef>
+#include <cassert>
+
+namespace brgb::sm83 {
+
+CodeArena::CodeArena(size_t size) :
+  size_(size)
+{
+#if defined(BRGB_SM83_JIT)
+  auto mem = mmap(nullptr, size_, PROT_READ|PROT_WRITE|PROT_EXEC, MAP_PRIVATE|MAP_ANONYMOUS, -1, 0);
+
+  // Leaving 'base_' == nullptr makes commit() always fail,
+  //   so a failure here just disables the recompiler
+  if(mem != MAP_FAILED) base_ = (u8 *)mem;
+#endif
+}
+
+CodeArena::~CodeArena()
+{
+#if defined(BRGB_SM83_JIT)
+  if(base_) munmap(base_, size_);
+#endif
+}
+
+auto CodeArena::commit(const std::vector<u8>& code) -> void *
+{
+  // Keep the start of every piece of code aligned
+  size_t size = (code.size() + 15) & ~(size_t)15;
+  if(!base_ || used_+size > size_) return nullptr;
+
+  auto ptr = base_ + used_;
+  memcpy(ptr, code.data(), code.size());
+
+  used_ += size;
+
+  return ptr;
+}
+
+auto CodeArena::reset() -> void
+{
+  used_ = 0;
+}
+
+auto CodeArena::used() const -> size_t
+{
+  return used_;
+}
+
+auto X64Emitter::code() const -> const std::vector<u8>&
+{
+  return code_;
+}
+
+auto X64Emitter::size() const -> size_t
+{
+  return code_.size();
+}
+
+auto X64Emitter::push(Reg r) -> X64Emitter&
+{
+  if(r >= r8) byte(0x41);
+
+  return byte(0x50 | (r & 7));
+}
+
+auto X64Emitter::pop(Reg r) -> X64Emitter&
+{
+  if(r >= r8) byte(0x41);
+
+  return byte(0x58 | (r & 7));
+}
+
+auto X64Emitter::ret() -> X64Emitter&
+{
+  return byte(0xC3);
+}
+
+auto X64Emitter::mov64(Reg dst, Reg src) -> X64Emitter&
+{
+  byte(0x48 | (src >> 3) << 2 | (dst >> 3));
+
+  return byte(0x89).byte(0xC0 | (src & 7) << 3 | (dst & 7));
+}
+
+auto X64Emitter::mov32(Reg dst, Reg src) -> X64Emitter&
+{
+  if(dst >= r8 || src >= r8) byte(0x40 | (src >> 3) << 2 | (dst >> 3));
+
+  return byte(0x89).byte(0xC0 | (src & 7) << 3 | (dst & 7));
+}
+
+auto X64Emitter::mov32(Reg dst, u32 imm) -> X64Emitter&
+{
+  if(dst >= r8) byte(0x41);
+
+  return byte(0xB8 | (dst & 7)).imm32(imm);
+}
+
+auto X64Emitter::movRaxImm64(u64 imm) -> X64Emitter&
+{
+  return byte(0x48).byte(0xB8).imm64(imm);
+}
+
+auto X64Emitter::storeRax(Reg base, i32 disp) -> X64Emitter&
+{
+  return memOp({ 0x89 }, rax, base, disp, Op64);
+}
+
+auto X64Emitter::loadZxAl(Reg base, i32 disp) -> X64Emitter&
+{
+  return memOp({ 0x0F, 0xB6 }, rax, base, disp);
+}
+
+auto X64Emitter::loadAl(Reg base, i32 disp) -> X64Emitter&
+{
+  return memOp({ 0x8A }, rax, base, disp);
+}
+
+auto X64Emitter::storeAl(Reg base, i32 disp) -> X64Emitter&
+{
+  return memOp({ 0x88 }, rax, base, disp);
+}
+
+auto X64Emitter::store8(Reg base, i32 disp, u8 imm) -> X64Emitter&
+{
+  return memOp({ 0xC6 }, 0, base, disp).byte(imm);
+}
+
+auto X64Emitter::store16(Reg base, i32 disp, u16 imm) -> X64Emitter&
+{
+  return memOp({ 0xC7 }, 0, base, disp, Op16).imm16(imm);
+}
+
+auto X64Emitter::incdec16(Reg base, i32 disp, bool dec) -> X64Emitter&
+{
+  return memOp({ 0xFF }, dec ? 1 : 0, base, disp, Op16);
+}
+
+auto X64Emitter::add64(Reg base, i32 disp, u32 imm) -> X64Emitter&
+{
+  return memOp({ 0x81 }, 0, base, disp, Op64).imm32(imm);
+}
+
+auto X64Emitter::cmpZero8(Reg base, i32 disp) -> X64Emitter&
+{
+  return memOp({ 0x80 }, 7, base, disp).byte(0x00);
+}
+
+auto X64Emitter::incdecAx(bool dec) -> X64Emitter&
+{
+  return byte(0x66).byte(0xFF).byte(dec ? 0xC8 : 0xC0);
+}
+
+auto X64Emitter::shlEax(u8 imm) -> X64Emitter&
+{
+  return byte(0xC1).byte(0xE0).byte(imm);
+}
+
+auto X64Emitter::shrEax(u8 imm) -> X64Emitter&
+{
+  return byte(0xC1).byte(0xE8).byte(imm);
+}
+
+auto X64Emitter::dec32(Reg r) -> X64Emitter&
+{
+  if(r >= r8) byte(0x41);
+
+  return byte(0xFF).byte(0xC8 | (r & 7));
+}
+
+auto X64Emitter::callRax() -> X64Emitter&
+{
+  return byte(0xFF).byte(0xD0);
+}
+
+auto X64Emitter::jmp() -> Label
+{
+  byte(0xE9).imm32(0);
+
+  return code_.size();
+}
+
+auto X64Emitter::jcc(Cond cc) -> Label
+{
+  byte(0x0F).byte(0x80 | cc).imm32(0);
+
+  return code_.size();
+}
+
+auto X64Emitter::bind(Label jump) -> X64Emitter&
+{
+  // 'jump' points right after the rel32, which
+  //   is what it's relative to
+  i32 rel = (i32)(code_.size() - jump);
+  memcpy(code_.data() + jump - 4, &rel, sizeof(rel));
+
+  return *this;
+}
+
+auto X64Emitter::byte(u8 b) -> X64Emitter&
+{
+  code_.push_back(b);
+
+  return *this;
+}
+
+auto X64Emitter::imm16(u16 v) -> X64Emitter&
+{
+  return byte(v & 0xFF).byte(v >> 8);
+}
+
+auto X64Emitter::imm32(u32 v) -> X64Emitter&
+{
+  return imm16(v & 0xFFFF).imm16(v >> 16);
+}
+
+auto X64Emitter::imm64(u64 v) -> X64Emitter&
+{
+  return imm32(v & 0xFFFF'FFFF).imm32(v >> 32);
+}
+
+auto X64Emitter::memOp(std::initializer_list<u8> opcode, u8 reg, Reg base, i32 disp, OpSize size) -> X64Emitter&
+{
+  if(size == Op16) byte(0x66);
+
+  u8 rex = 0x40 | (size == Op64) << 3 | (reg >> 3) << 2 | (base >> 3);
+  if(rex != 0x40) byte(rex);
+
+  for(auto b : opcode) byte(b);
+
+  // mod=10 (disp32), rsp/r12 as the base require a SIB byte
+  byte(0x80 | (reg & 7) << 3 | (base & 7));
+  if((base & 7) == rsp) byte(0x24);
+
+  return imm32((u32)disp);
+}
+
+auto Processor::executeJit(unsigned instructions) -> unsigned
+{
+#if !defined(BRGB_SM83_JIT)
+  return executeCached(instructions);
+#else
+  // Blocks get recompiled once they've been entered this many times
+  static constexpr unsigned HotBlockHits = 16;
+
+  if(!jit_code_) jit_code_.reset(new CodeArena());
+
+  auto interrupt_state = interruptState();
+
+  Registers rf = r;
+
+  // See executeCached()
+  const BlockCache::Block *last_block = nullptr;
+  unsigned last_op = 0;
+  u16 last_pc = rf.pc;
+
+  unsigned left = instructions;
+  while(left) {
+    // See executeCached()
+    if(left != instructions && cycles_ > until_) break;
+
+    unsigned first;
+    auto block = enterBlock(rf.pc, first);
+
+    if(BRGB_UNLIKELY(!block)) {
+      // See executeCached()
+      if(left != instructions && breakpointAt(rf.pc)) break;
+
+      last_block = nullptr;
+      last_pc = rf.pc;
+
+      // The code can't be cached - interpret a single instruction
+      (this->*OpTable[opcode(rf)])(rf);
+      left--;
+    } else if(first) {
+      // The recompiled code can only be entered at the start
+      //   of the Block, so the rest of it is interpreted
+      unsigned ops = std::min(left, blockOps(block, first));
+      unsigned executed = ops - runBlock(block, rf, ops, first);
+
+      left -= executed;
+
+      last_block = block;
+      last_op = first + executed-1;
+    } else {
+      unsigned ops = std::min(left, blockOps(block));
+
+      // Entries which are cut short count towards the Block being
+      //   hot as well, as their remainder gets resumed by the next
+      //   execute() instead of starting a Block of it's own
+      if(BRGB_UNLIKELY(!block->native && ++block->hits == HotBlockHits)) {
+        // Start over with an empty CodeArena (and BlockCache,
+        //   as the Blocks point into it) once it fills up
+        if(!recompile(block) && jit_code_->used()) {
+          flushBlocks();
+
+          block = this->block(rf.pc);
+          recompile(block);
+        }
+      }
+
+      unsigned executed;
+      if(block->native) {
+        block_break_ = false;
+        executed = ops - block->native(this, &rf, ops);
+
+        // See runBlock()
+        if(executed == ops && !block_break_ && ops < block->ops.size()) {
+          partial_block_ = block;
+          partial_op_ = ops;
+          partial_pc_ = rf.pc;
+        }
+      } else {
+        executed = ops - runBlock(block, rf, ops);
+      }
+
+      left -= executed;
+
+      last_block = block;
+      last_op = executed-1;
+    }
+
+    // See executeCached()
+    if(BRGB_UNLIKELY(interruptState() != interrupt_state)) break;
+  }
+
+  r = rf;
+  last_pc_ = last_block ? opAddress(last_block, last_op) : last_pc;
+
+  return instructions - left;
+#endif
+}
+
+// Returns the address of the function 'handler' points to
+static auto handler_address(BlockCache::Handler handler) -> u64
+{
+  // Itanium C++ ABI - a pointer to a non-virtual member function
+  //   is the function's address followed by a 'this' adjustment
+  struct {
+    u64 ptr;
+    i64 adj;
+  } pmf;
+
+  static_assert(sizeof(pmf) == sizeof(handler));
+  memcpy(&pmf, &handler, sizeof(pmf));
+
+  assert(!(pmf.ptr & 1) && !pmf.adj && "the instruction handlers can't be virtual!");
+
+  return pmf.ptr;
+}
+
+// Offsets of the 8-bit registers, indexed like Reg8
+//   (with (hl) in place of an offset)
+static constexpr i32 p_reg8_offset[8] = {
+  offsetof(Registers, b), offsetof(Registers, c),
+  offsetof(Registers, d), offsetof(Registers, e),
+  offsetof(Registers, h), offsetof(Registers, l),
+  -1, offsetof(Registers, a),
+};
+
+// Offsets of the high/low bytes of the register pairs
+//   indexed like Reg16_rp (except sp, which is a u16)
+static constexpr i32 p_reg16_offset[3][2] = {
+  { offsetof(Registers, b), offsetof(Registers, c) },
+  { offsetof(Registers, d), offsetof(Registers, e) },
+  { offsetof(Registers, h), offsetof(Registers, l) },
+};
+
+auto Processor::recompile(BlockCache::Block *block) -> bool
+{
+#if !defined(BRGB_SM83_JIT)
+  return false;
+#else
+  using Reg = X64Emitter::Reg;
+
+  // Register assignment:
+  //   rbx - Processor *   r12 - Registers *   r13d - instructions left
+  static constexpr Reg P = X64Emitter::rbx;
+  static constexpr Reg RF = X64Emitter::r12;
+  static constexpr Reg Left = X64Emitter::r13;
+
+  const i32 pc_offset = offsetof(Registers, pc);
+  const i32 sp_offset = offsetof(Registers, sp);
+
+  const i32 operands_offset = (i32)((const u8 *)&operands_ - (const u8 *)this);
+  const i32 block_break_offset = (i32)((const u8 *)&block_break_ - (const u8 *)this);
+  const i32 cycles_offset = (i32)((const u8 *)&cycles_ - (const u8 *)this);
+
+  X64Emitter x;
+
+  // The return address + 3 callee-saved registers (32 bytes)
+  //   keep the stack 16-byte aligned for the calls
+  x.push(X64Emitter::rbx).push(X64Emitter::r12).push(X64Emitter::r13);
+
+  x.mov64(P, X64Emitter::rdi);
+  x.mov64(RF, X64Emitter::rsi);
+  x.mov32(Left, X64Emitter::rdx);
+
+  std::vector<X64Emitter::Label> exits;
+
+  // Memory cycles spent by the inline instructions (since
+  //   the last handler call), which are only accounted for
+  //   right before the next call or when leaving
+  unsigned pending = 0;
+
+  auto flush_pending = [&](unsigned cycles) {
+    if(!cycles) return;
+
+    x.add64(P, cycles_offset, cycles);
+  };
+
+  // Leaves with PC set to 'pc' (when the instruction
+  //   didn't set it itself) and all cycles spent
+  auto emit_exit = [&](std::optional<u16> pc, unsigned cycles) {
+    if(pc) x.store16(RF, pc_offset, *pc);
+    flush_pending(cycles);
+
+    exits.push_back(x.jmp());
+  };
+
+  // Exits taken after an inline instruction when no instructions
+  //   are left, which are emitted after the Block's last one
+  //   to keep the code which runs through it compact
+  struct SideExit {
+    X64Emitter::Label jump;
+
+    u16 pc;
+    unsigned pending;
+  };
+
+  std::vector<SideExit> side_exits;
+
+  u16 pc = block->pc;
+  for(size_t i = 0; i < block->ops.size(); i++) {
+    const auto& op = block->ops[i];
+    bool last = i+1 == block->ops.size();
+
+    u8 opcode = op.opcode;
+
+    u8 x_ = opcode >> 6, y = (opcode >> 3) & 7, z = opcode & 7;
+    u8 p = y >> 1, q = y & 1;
+
+    u16 next_pc = pc + op.length;
+
+    // Set when the instruction is done inline, in which case PC
+    //   is only written back when leaving (as 'next_pc')
+    bool inline_op = true;
+
+    if(opcode == 0x00) {
+      //  nop
+    } else if(x_ == 1 && y != 6 && z != 6) {
+      //  ld <reg8>, <reg8>
+      x.loadZxAl(RF, p_reg8_offset[z]);
+      x.storeAl(RF, p_reg8_offset[y]);
+    } else if(x_ == 0 && z == 6 && y != 6) {
+      //  ld <reg8>, imm8
+      x.store8(RF, p_reg8_offset[y], op.operands[0]);
+    } else if(x_ == 0 && z == 1 && q == 0) {
+      //  ld <reg16>, imm16
+      if(p == 3) {
+        x.store16(RF, sp_offset, op.operands[1] << 8 | op.operands[0]);
+      } else {
+        x.store8(RF, p_reg16_offset[p][0], op.operands[1]);
+        x.store8(RF, p_reg16_offset[p][1], op.operands[0]);
+      }
+    } else if(x_ == 0 && z == 3) {
+      //  inc <reg16>
+      //  dec <reg16>
+      if(p == 3) {
+        x.incdec16(RF, sp_offset, q);
+      } else {
+        x.loadZxAl(RF, p_reg16_offset[p][0]);
+        x.shlEax(8);
+        x.loadAl(RF, p_reg16_offset[p][1]);
+        x.incdecAx(q);
+        x.storeAl(RF, p_reg16_offset[p][1]);
+        x.shrEax(8);
+        x.storeAl(RF, p_reg16_offset[p][0]);
+      }
+    } else if(opcode == 0xC3) {
+      //  jp imm16
+      next_pc = op.operands[1] << 8 | op.operands[0];
+    } else if(opcode == 0x18) {
+      //  jr imm8
+      next_pc += (i8)op.operands[0];
+    } else {
+      // Everything else calls the handler, which can access the
+      //   bus, so all the cycles up to this point (including the
+      //   opcode fetch) have to be spent first
+      flush_pending(pending + op.fetches);
+      pending = 0;
+
+      x.store16(RF, pc_offset, pc + op.fetches);
+
+      x.movRaxImm64((u64)op.operands);
+      x.storeRax(P, operands_offset);
+
+      x.mov64(X64Emitter::rdi, P);
+      x.mov64(X64Emitter::rsi, RF);
+      x.movRaxImm64(handler_address(op.handler));
+      x.callRax();
+
+      // The handler takes care of PC
+      inline_op = false;
+    }
+
+    // None of the inline instructions branch conditionally,
+    //   so they always spend the same number of cycles
+    if(inline_op) pending += opcode_info(opcode).cycles;
+
+    x.dec32(Left);
+    if(last) {
+      emit_exit(inline_op ? std::optional<u16>(next_pc) : std::nullopt, pending);
+      break;
+    }
+
+    if(inline_op) {
+      side_exits.push_back({ x.jcc(X64Emitter::Zero), next_pc, pending });
+    } else {
+      exits.push_back(x.jcc(X64Emitter::Zero));
+
+      // The Block is no longer safe to continue when one of
+      //   it's instructions wrote to it (or remapped memory)
+      x.cmpZero8(P, block_break_offset);
+      exits.push_back(x.jcc(X64Emitter::NotZero));
+    }
+
+    pc = next_pc;
+  }
+
+  for(const auto& exit : side_exits) {
+    x.bind(exit.jump);
+    emit_exit(exit.pc, exit.pending);
+  }
+
+  for(auto exit : exits) x.bind(exit);
+
+  x.mov32(X64Emitter::rax, Left);
+
+  x.pop(X64Emitter::r13).pop(X64Emitter::r12).pop(X64Emitter::rbx);
+  x.ret();
+
+  auto code = jit_code_->commit(x.code());
+  if(!code) return false;
+
+  block->native = (BlockCache::NativeFn)code;
+
+  return true;
+#endif
+}
+
+}
@@ -1,16 +1,150 @@
 #include <device/sm83/cpu.h>
+#include <device/sm83/ops.h>
 
-#include <cassert>
+#include <utility>
 
-#define STRINGIFY_(x) #x
-#define STRINGIFY(x) STRINGIFY_(x)
-#define OP_STUB assert(0 && STRINGIFY(__PRETTY_FUNCTION__) " stub!");
+#include <cassert>
 
 namespace brgb::sm83 {
 
-auto Processor::opHALT() -> void
+template <Processor::Fetch F, size_t... Ops>
+constexpr auto Processor::opTable(std::index_sequence<Ops...>) -> std::array<OpHandler, sizeof...(Ops)>
+{
+  return {{ &Processor::op<Ops, F>... }};
+}
+
+template <size_t... Ops>
+constexpr auto Processor::opTableCB(std::index_sequence<Ops...>) -> std::array<OpHandler, sizeof...(Ops)>
+{
+  return {{ &Processor::opCB<Ops>... }};
+}
+
+const std::array<Processor::OpHandler, 256> Processor::OpTable =
+    opTable<Fetch::Bus>(std::make_index_sequence<256>());
+const std::array<Processor::OpHandler, 256> Processor::OpTableCB =
+    opTableCB(std::make_index_sequence<256>());
+const std::array<Processor::OpHandler, 256> Processor::OpTablePredecoded =
+    opTable<Fetch::Predecoded>(std::make_index_sequence<256>());
+
+auto Processor::instruction() -> void
+{
+  if(!prologue()) return;
+
+  Registers rf = r;
+
+  (this->*OpTable[opcode(rf)])(rf);
+
+  r = rf;
+}
+
+auto Processor::interrupt() -> unsigned
+{
+  assert(irq_pending_ && "interrupt() called without an interrupt pending!");
+
+  bool halted = run_state_ == RunState::Halted;
+  run_state_ = RunState::Running;
+
+  if(!ime_) {
+    // Only woken up from HALT
+    updateInterrupts();
+    return NoInterrupt;
+  }
+
+  // The lowest numbered line has the highest priority
+  unsigned irq = 0;
+  while(!(irq_lines_ & (1u<<irq))) irq++;
+
+  ime_ = false;
+  updateInterrupts();
+
+  Registers rf = r;
+
+  // Waking up from HALT takes an extra memory cycle
+  if(halted) idle();
+
+  // The dispatch takes 5 memory cycles - it's the same
+  //   as 'call' except for the 2 cycles before the push
+  idle(); idle();
+  push16(rf, rf.pc);
+
+  rf.pc = 0x40 + irq*8;
+  idle();
+
+  r = rf;
+
+  // The dispatch is profiled like a 'call' to the vector
+  if(BRGB_UNLIKELY(profiler_ != nullptr)) {
+    profiler_->call(profilePage(rf.pc)->bank, rf.pc, (u16)(rf.sp + 2), cycles_);
+  }
+
+  return irq;
+}
+
+auto Processor::haltBug() -> void
 {
-  OP_STUB;
+  run_state_ = RunState::Running;
+
+  Registers rf = r;
+
+  // The opcode is fetched without incrementing PC, so it's
+  //   first byte is read again as the following one
+  (this->*OpTable[read(rf.pc)])(rf);
+
+  r = rf;
+}
+
+auto Processor::execute(unsigned instructions, u64 until) -> unsigned
+{
+  if(!instructions) return 0;
+
+  // Set before the prologue(), as enabling interrupts
+  //   there has to stop the engine as well
+  until_ = until;
+
+  // Resuming from a breakpoint executes the instruction it stopped at
+  //   - Checked before the prologue(), which could enable interrupts
+  //     that would then be dispatched before the instruction
+  bool resume = std::exchange(break_hit_, false) && r.pc == break_pc_;
+  if(BRGB_UNLIKELY(num_breakpoints_) && !resume && run_state_ == RunState::Running) {
+    if(breakpointAt(r.pc)) return 0;
+  }
+
+  if(!prologue()) return 1;
+
+  if(BRGB_UNLIKELY(instrumented_)) return executeInstrumented(instructions);
+
+  switch(engine_) {
+  case Engine::Table:    return executeTable(instructions);
+  case Engine::Threaded: return executeThreaded(instructions);
+  case Engine::Cached:   return executeCached(instructions);
+  case Engine::Jit:      return executeJit(instructions);
+  }
+
+  assert(0);   // Unreachable
+  return 0;
+}
+
+auto Processor::executeTable(unsigned instructions) -> unsigned
+{
+  auto interrupt_state = interruptState();
+
+  Registers rf = r;
+  u16 last_pc = rf.pc;
+
+  unsigned executed = 0;
+  while(executed < instructions) {
+    last_pc = rf.pc;
+
+    (this->*OpTable[opcode(rf)])(rf);
+    executed++;
+
+    if(BRGB_UNLIKELY(interruptState() != interrupt_state || cycles_ > until_)) break;
+  }
+
+  r = rf;
+  last_pc_ = last_pc;
+
+  return executed;
 }
 
 }
@@ -0,0 +1,223 @@
+#include <device/sm83/profiler.h>
+#include <device/sm83/cpu.h>
+#include <device/sm83/disassembler.h>
+#include <util/format.h>
+
+#include <algorithm>
+
+#include <cassert>
+
+namespace brgb::sm83 {
+
+Profiler::Profiler()
+{
+}
+
+auto Profiler::begin(u64 cycles) -> void
+{
+  pages_.clear();
+  graph_ = { };
+
+  start_ = cycles;
+}
+
+auto Profiler::page(u32 bank, u16 base) -> Page *
+{
+  assert(!(base % PageSize) && "page() called with an unaligned address!");
+
+  auto& page = pages_[key(bank, base)];
+  if(!page) {
+    page = std::make_unique<Page>();
+
+    page->bank = bank;
+    page->base = base;
+    page->entries = { };
+  }
+
+  return page.get();
+}
+
+auto Profiler::call(u32 bank, u16 addr, u16 sp, u64 cycles) -> void
+{
+  auto& stack = graph_.stack;
+
+  // Calls which would return to an address at or below 'sp' have
+  //   been abandoned (ex. their return address was popped off
+  //   manually or the stack was moved), so they end here
+  while(!stack.empty() && stack.back().sp <= sp) graph_.pop(cycles);
+
+  auto callee = key(bank, addr);
+  auto caller = stack.empty() ? RootFunction : stack.back().function;
+
+  auto& function = graph_.functions[callee];
+  function.calls++;
+  function.active++;
+
+  graph_.edges[{ caller, callee }].calls++;
+
+  stack.push_back({ callee, sp, cycles, 0 });
+}
+
+auto Profiler::ret(u16 sp, u64 cycles) -> void
+{
+  auto& stack = graph_.stack;
+
+  // A return which doesn't pop a call's return address (ex. 'push hl'
+  //   followed by 'ret' used as an indirect jump) doesn't end any,
+  //   while one which does also ends the calls made from it which
+  //   never returned
+  while(!stack.empty() && stack.back().sp <= sp) graph_.pop(cycles);
+}
+
+auto Profiler::CallGraph::pop(u64 cycles) -> void
+{
+  auto frame = stack.back();
+  stack.pop_back();
+
+  auto duration = cycles - frame.start;
+
+  auto& function = functions[frame.function];
+  function.self += duration - frame.children;
+
+  // Only the outermost of recursive calls counts
+  if(!--function.active) function.inclusive += duration;
+
+  auto caller = RootFunction;
+  if(stack.empty()) {
+    root_children += duration;
+  } else {
+    caller = stack.back().function;
+    stack.back().children += duration;
+  }
+
+  edges[{ caller, frame.function }].cycles += duration;
+}
+
+auto Profiler::report(FILE *out, u64 cycles, unsigned lines) const -> void
+{
+  // Close all the calls which haven't returned yet, without
+  //   disturbing the ones still being tracked
+  auto graph = graph_;
+  while(!graph.stack.empty()) graph.pop(cycles);
+
+  auto total = cycles - start_;
+  auto& root = graph.functions[RootFunction];
+
+  root.self = total - graph.root_children;
+  root.inclusive = total;
+
+  auto percent = [&](u64 c) { return total ? 100.0 * c / total : 0.0; };
+
+  // Flat profile of the instructions
+  std::vector<std::pair<const Page *, unsigned>> hot;
+  for(const auto& [page_key, page] : pages_) {
+    for(unsigned i = 0; i < PageSize; i++) {
+      if(page->entries[i].count) hot.emplace_back(page.get(), i);
+    }
+  }
+
+  auto cycles_of = [](const auto& h) { return h.first->entries[h.second].cycles; };
+  auto num_hot = std::min<size_t>(lines, hot.size());
+
+  std::partial_sort(hot.begin(), hot.begin() + num_hot, hot.end(), [&](const auto& a, const auto& b) {
+    return cycles_of(a) > cycles_of(b);
+  });
+
+  fprintf(out, "Instructions (by cycles, %zu executed):\n", hot.size());
+  fprintf(out, "  %14s %7s %14s  %-8s  %s\n", "cycles", "%", "count", "address", "instruction");
+  for(size_t i = 0; i < num_hot; i++) {
+    auto [page, index] = hot[i];
+    const auto& entry = page->entries[index];
+
+    std::string disassembly = "??";
+    if(entry.known) {
+      u8 code[3] = { entry.code[0], entry.code[1], entry.code[2] };
+
+      // Illegal opcodes come out as a 'db'
+      sm83disasm::Instruction instruction(code);
+
+      u8 *ptr = code;
+      instruction.decode(ptr, code + sizeof(code));
+
+      disassembly = instruction.toStr();
+    }
+
+    // Everything is counted in memory cycles,
+    //   but printed as t-cycles (x4)
+    fprintf(out, "  %14llu %6.2f%% %14llu  %-8s  %s\n",
+        (unsigned long long)entry.cycles*4, percent(entry.cycles), (unsigned long long)entry.count,
+        functionName(key(page->bank, page->base + index)).data(), disassembly.data());
+  }
+
+  // Flat profile of the functions
+  std::vector<std::pair<FunctionKey, const Function *>> functions;
+  for(const auto& [function_key, function] : graph.functions) functions.emplace_back(function_key, &function);
+
+  auto num_functions = std::min<size_t>(lines, functions.size());
+
+  std::partial_sort(functions.begin(), functions.begin() + num_functions, functions.end(),
+      [](const auto& a, const auto& b) { return a.second->self > b.second->self; });
+
+  fprintf(out, "\nFunctions (by self cycles, %zu called):\n", functions.size() - 1);
+  fprintf(out, "  %14s %7s %14s %7s %10s  %s\n", "self", "%", "inclusive", "%", "calls", "function");
+  for(size_t i = 0; i < num_functions; i++) {
+    auto [function_key, function] = functions[i];
+
+    fprintf(out, "  %14llu %6.2f%% %14llu %6.2f%% %10llu  %s\n",
+        (unsigned long long)function->self*4, percent(function->self),
+        (unsigned long long)function->inclusive*4, percent(function->inclusive),
+        (unsigned long long)function->calls, functionName(function_key).data());
+  }
+
+  // Call graph of the functions
+  std::partial_sort(functions.begin(), functions.begin() + num_functions, functions.end(),
+      [](const auto& a, const auto& b) { return a.second->inclusive > b.second->inclusive; });
+
+  fprintf(out, "\nCall graph (by inclusive cycles):\n");
+  for(size_t i = 0; i < num_functions; i++) {
+    auto [function_key, function] = functions[i];
+
+    fprintf(out, "  %-8s  inclusive=%llu (%.2f%%) self=%llu (%.2f%%) calls=%llu\n", functionName(function_key).data(),
+        (unsigned long long)function->inclusive*4, percent(function->inclusive),
+        (unsigned long long)function->self*4, percent(function->self),
+        (unsigned long long)function->calls);
+
+    for(const auto& [edge_key, edge] : graph.edges) {
+      auto [caller, callee] = edge_key;
+
+      if(callee == function_key) {
+        fprintf(out, "      <- %-8s  calls=%llu cycles=%llu\n", functionName(caller).data(),
+            (unsigned long long)edge.calls, (unsigned long long)edge.cycles*4);
+      }
+    }
+
+    for(const auto& [edge_key, edge] : graph.edges) {
+      auto [caller, callee] = edge_key;
+
+      if(caller == function_key) {
+        fprintf(out, "      -> %-8s  calls=%llu cycles=%llu\n", functionName(callee).data(),
+            (unsigned long long)edge.calls, (unsigned long long)edge.cycles*4);
+      }
+    }
+  }
+}
+
+auto Profiler::key(u32 bank, u16 addr) -> u64
+{
+  return (u64)bank << 16 | addr;
+}
+
+auto Profiler::functionName(FunctionKey function) const -> std::string
+{
+  if(function == RootFunction) return "<root>";
+
+  auto bank = (u32)(function >> 16);
+  auto addr = (u16)function;
+
+  // Code in Uncacheable memory has no meaningful bank
+  if(bank == Processor::Uncacheable) return util::fmt("--:%.4X", addr);
+
+  return util::fmt("%.2X:%.4X", bank & ~Processor::ReadOnly, addr);
+}
+
+}
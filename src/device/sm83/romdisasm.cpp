@@ -0,0 +1,531 @@
+#include <device/sm83/romdisasm.h>
+#include <device/sm83/disassembler.h>
+#include <device/sm83/opcodes.h>
+
+#include <algorithm>
+#include <atomic>
+#include <thread>
+#include <tuple>
+
+#include <cassert>
+#include <cstring>
+
+namespace brgb::sm83disasm {
+
+using sm83::Operand;
+
+enum : u16 {
+  // Writing the bank number anywhere in this range switches
+  //   the bank mapped at 0x4000-0x7FFF (on all MBCs)
+  BankSelectBegin = 0x2000,
+  BankSelectEnd   = 0x3FFF,
+
+  // The first address past the ROM
+  RomEnd = 0x8000,
+};
+
+// Executed right after the boot ROM
+static constexpr u16 p_entry_point = 0x0100;
+
+// The rst and interrupt vectors
+static constexpr u16 p_vectors[] = {
+  0x00, 0x08, 0x10, 0x18, 0x20, 0x28, 0x30, 0x38,
+  0x40, 0x48, 0x50, 0x58, 0x60,
+};
+
+// Returns the opcode at 'code' (with at least 'avail'
+//   bytes), looking past the 0xCB prefix
+static auto p_opcode_info(const u8 *code, size_t avail) -> const sm83::OpcodeInfo *
+{
+  const auto *info = &sm83::opcode_info(code[0]);
+  if(info->is(sm83::OpPrefix)) {
+    if(avail < 2) return nullptr;
+
+    info = &sm83::opcode_info_cb(code[1]);
+  }
+
+  return info->mnemonic != sm83::Mnemonic::Invalid ? info : nullptr;
+}
+
+// Returns the target of the branch (or call) at 'addr',
+//   or -1 when it isn't known until it's executed
+static auto p_branch_target(const sm83::OpcodeInfo& info, const u8 *code, u16 addr) -> int
+{
+  for(auto operand : info.operands) {
+    switch(operand) {
+    case Operand::Rel8:      return (u16)(addr + info.length + (i8)code[1]);
+    case Operand::Imm16:     return code[1] | (code[2] << 8);
+    case Operand::RSTVector: return code[0] & 0x38;
+
+    default: break;
+    }
+  }
+
+  return -1;   // jp hl, ret and reti
+}
+
+// Returns 'true' when the instruction leaves a different
+//   value in 'a' (or might, as with call)
+static auto p_writes_a(const sm83::OpcodeInfo& info) -> bool
+{
+  return info.is(sm83::OpWritesA | sm83::OpCall);
+}
+
+RomDisassembler::RomDisassembler(const u8 *rom, size_t size) :
+  rom_(rom), num_banks_(size / BankSize)
+{
+  banks_.resize(num_banks_);
+  distributed_.resize(num_banks_);
+
+  for(auto& bank : banks_) bank.flags.resize(BankSize);
+
+  if(!num_banks_) return;
+
+  // At power on bank 1 is mapped at 0x4000, but by the time an
+  //   interrupt or rst happens it could be any of them
+  unsigned vector_bank = num_banks_ == 2 ? 1 : UnknownBank;
+  for(auto vector : p_vectors) {
+    banks_[0].flags[vector] |= ByteLabel|ByteEntryPoint;
+    banks_[0].seeds.push_back({ vector, vector_bank });
+  }
+
+  // Pushed last, so it's walked first
+  banks_[0].flags[p_entry_point] |= ByteLabel|ByteEntryPoint;
+  banks_[0].seeds.push_back({ p_entry_point, num_banks_ > 1 ? 1 : UnknownBank });
+}
+
+auto RomDisassembler::entryPoint(unsigned bank, u16 addr) -> RomDisassembler&
+{
+  assert(bank < num_banks_ && addr >= bankBase(bank) && (u16)(addr - bankBase(bank)) < BankSize &&
+      "RomDisassembler::entryPoint() called with an address outside of the bank!");
+
+  banks_[bank].flags[addr - bankBase(bank)] |= ByteLabel|ByteEntryPoint;
+  banks_[bank].seeds.push_back({ addr, bank ? bank : UnknownBank });
+
+  return *this;
+}
+
+auto RomDisassembler::analyze(unsigned num_threads) -> RomDisassembler&
+{
+  if(!num_threads) num_threads = std::max(std::thread::hardware_concurrency(), 1u);
+
+  std::vector<unsigned> work;
+  for(;;) {
+    work.clear();
+    for(unsigned bank = 0; bank < num_banks_; bank++) {
+      if(!banks_[bank].seeds.empty()) work.push_back(bank);
+    }
+
+    if(work.empty()) break;
+
+    // Each bank is only ever touched by the thread walking it,
+    //   so the threads just need to agree on who walks which
+    std::atomic<size_t> next_work = 0;
+    auto worker = [&]() {
+      for(size_t i; (i = next_work++) < work.size(); ) walk(work[i]);
+    };
+
+    std::vector<std::thread> threads;
+    for(unsigned i = 1; i < std::min<size_t>(num_threads, work.size()); i++) {
+      threads.emplace_back(worker);
+    }
+
+    worker();
+    for(auto& thread : threads) thread.join();
+
+    distribute();
+  }
+
+  for(auto& bank : banks_) {
+    for(const auto& ref : bank.refs) {
+      if(ref.to_bank == UnknownBank) continue;
+
+      banks_[ref.to_bank].xrefs.push_back(ref);
+    }
+  }
+
+  auto by_target = [](const XRef& a, const XRef& b) {
+    return std::tie(a.to, a.from_bank, a.from) < std::tie(b.to, b.from_bank, b.from);
+  };
+
+  auto by_source = [](const XRef& a, const XRef& b) { return a.from < b.from; };
+
+  for(auto& bank : banks_) {
+    std::sort(bank.xrefs.begin(), bank.xrefs.end(), by_target);
+    std::sort(bank.refs.begin(), bank.refs.end(), by_source);
+  }
+
+  std::sort(unresolved_.begin(), unresolved_.end(), by_target);
+
+  return *this;
+}
+
+auto RomDisassembler::walk(unsigned bank_index) -> void
+{
+  auto& bank = banks_[bank_index];
+
+  auto base = bankBase(bank_index);
+  const u8 *data = rom_ + offset(bank_index, base);
+
+  auto stack = std::move(bank.seeds);
+  bank.seeds.clear();
+
+  while(!stack.empty()) {
+    auto [addr, mapped_bank] = stack.back();
+    stack.pop_back();
+
+    // The value last loaded into 'a' with 'ld a, <n>' (-1
+    //   when it's unknown), for spotting bank switches
+    int known_a = -1;
+
+    // Follow the code until it's flow ends, it runs into
+    //   code walked before, data or the end of the bank
+    while(addr >= base && (u16)(addr - base) < BankSize) {
+      unsigned i = addr - base;
+      if(bank.flags[i] & (ByteCode|ByteOperand)) break;
+
+      const auto *info = p_opcode_info(data + i, BankSize - i);
+      if(!info || i + info->length > BankSize) break;
+
+      bank.flags[i] |= ByteCode;
+      for(unsigned j = 1; j < info->length; j++) bank.flags[i + j] |= ByteOperand;
+
+      bank.instructions++;
+
+      const u8 *code = data + i;
+      u8 op = code[0];
+
+      // ld (<a16>), a
+      if(op == 0xEA) {
+        u16 dst = code[1] | (code[2] << 8);
+        if(dst >= BankSelectBegin && dst <= BankSelectEnd) {
+          // Bank 0 can't be mapped at 0x4000, 1 is used instead
+          //   (which only wraps around to 0 for a single bank ROM)
+          mapped_bank = known_a >= 0 ? std::max(known_a, 1) % num_banks_ : 0;
+
+          // Some bank got mapped, but which one isn't known
+          if(!mapped_bank) mapped_bank = UnknownBank;
+        }
+      }
+
+      if(op == 0x3E) {          // ld a, <n>
+        known_a = code[1];
+      } else if(p_writes_a(*info)) {
+        known_a = -1;
+      }
+
+      if(!info->is(sm83::OpBranch)) {
+        addr += info->length;
+        continue;
+      }
+
+      auto target = p_branch_target(*info, code, addr);
+
+      // Only the ROM is followed, not code copied to RAM
+      if(target >= 0 && target < RomEnd) {
+        XRef ref = { 0, (u16)target, bank_index, addr, info->is(sm83::OpCall) };
+        if(target >= SwitchableBase) ref.to_bank = mapped_bank;
+
+        bank.refs.push_back(ref);
+
+        // References to other banks get handed over in between rounds
+        if(ref.to_bank == bank_index) {
+          bank.flags[target - base] |= ByteLabel | (ref.call ? ByteCallTarget : 0);
+          stack.push_back({ (u16)target, mapped_bank });
+        }
+      }
+
+      // jp, jr, ret, reti and jp hl don't continue on
+      if(!info->is(sm83::OpConditional) && !info->is(sm83::OpCall)) break;
+
+      addr += info->length;
+    }
+  }
+}
+
+auto RomDisassembler::distribute() -> void
+{
+  for(unsigned from = 0; from < num_banks_; from++) {
+    auto& refs = banks_[from].refs;
+
+    for(size_t i = distributed_[from]; i < refs.size(); i++) {
+      const auto& ref = refs[i];
+
+      if(ref.to_bank == UnknownBank) {
+        unresolved_.push_back(ref);
+        continue;
+      } else if(ref.to_bank == from) {
+        continue;     // Already walked
+      }
+
+      auto& bank = banks_[ref.to_bank];
+      auto& flags = bank.flags[ref.to - bankBase(ref.to_bank)];
+
+      flags |= ByteLabel | (ref.call ? ByteCallTarget : 0);
+      if(flags & ByteCode) continue;
+
+      // Code in bank 0 reached from another bank runs with
+      //   that bank still mapped
+      bank.seeds.push_back({ ref.to, ref.to_bank ? ref.to_bank : from });
+    }
+
+    distributed_[from] = refs.size();
+  }
+}
+
+auto RomDisassembler::numBanks() const -> unsigned
+{
+  return num_banks_;
+}
+
+auto RomDisassembler::bankBase(unsigned bank) -> u16
+{
+  return bank ? SwitchableBase : 0x0000;
+}
+
+auto RomDisassembler::offset(unsigned bank, u16 addr) const -> size_t
+{
+  return (size_t)bank*BankSize + (addr - bankBase(bank));
+}
+
+auto RomDisassembler::flags(unsigned bank, u16 addr) const -> u8
+{
+  assert(bank < num_banks_ && addr >= bankBase(bank) && (u16)(addr - bankBase(bank)) < BankSize &&
+      "RomDisassembler::flags() called with an address outside of the bank!");
+
+  return banks_[bank].flags[addr - bankBase(bank)];
+}
+
+auto RomDisassembler::xrefs(unsigned bank) const -> const std::vector<XRef>&
+{
+  return banks_[bank].xrefs;
+}
+
+auto RomDisassembler::unresolvedXRefs() const -> const std::vector<XRef>&
+{
+  return unresolved_;
+}
+
+auto RomDisassembler::numInstructions() const -> size_t
+{
+  size_t instructions = 0;
+  for(const auto& bank : banks_) instructions += bank.instructions;
+
+  return instructions;
+}
+
+// A single line of a listing, built up in place and then appended
+//   to the listing as a whole, which is a lot cheaper than going
+//   through snprintf() (or std::string) for every field
+class ListingLine {
+public:
+  enum : size_t {
+    // Longer than any line of the listing can get
+    MaxLength = 160,
+  };
+
+  auto put(char c) -> ListingLine&
+  {
+    *p_++ = c;
+
+    return *this;
+  }
+
+  auto put(const char *str) -> ListingLine&
+  {
+    while(*str) *p_++ = *str++;
+
+    return *this;
+  }
+
+  // Upper case, with at least 'min_digits' digits like "%.*X"
+  auto hex(unsigned v, unsigned min_digits) -> ListingLine&
+  {
+    static constexpr char Digits[] = "0123456789ABCDEF";
+
+    unsigned digits = min_digits;
+    while(digits < 8 && (v >> (digits*4))) digits++;
+
+    for(unsigned i = digits; i > 0; i--) *p_++ = Digits[(v >> ((i-1)*4)) & 0xF];
+
+    return *this;
+  }
+
+  auto dec(unsigned v) -> ListingLine&
+  {
+    char digits[10];
+
+    unsigned num_digits = 0;
+    do {
+      digits[num_digits++] = '0' + v%10;
+      v /= 10;
+    } while(v);
+
+    while(num_digits) *p_++ = digits[--num_digits];
+
+    return *this;
+  }
+
+  // See RomDisassembler::labelName()
+  auto label(unsigned bank, u16 addr) -> ListingLine&
+  {
+    return put('L').hex(bank, 2).put('_').hex(addr, 4);
+  }
+
+  // Pads the line with spaces up to 'column' (or adds a
+  //   single space when it's already past it)
+  auto padTo(size_t column) -> ListingLine&
+  {
+    do { *p_++ = ' '; } while(length() < column);
+
+    return *this;
+  }
+
+  auto data() -> char * { return line_; }
+  auto length() const -> size_t { return p_ - line_; }
+
+  // Makes 'length' chars written to data() by someone else a part of the line
+  auto advance(size_t length) -> ListingLine& { p_ += length; return *this; }
+
+  // Appends the line (along with a '\n') to 'out' and starts a new one
+  auto flush(std::string& out) -> void
+  {
+    *p_++ = '\n';
+    out.append(line_, length());
+
+    p_ = line_;
+  }
+
+private:
+  char line_[MaxLength];
+  char *p_ = line_;
+};
+
+auto RomDisassembler::labelName(char *buf, size_t size, unsigned bank, u16 addr) -> size_t
+{
+  ListingLine line;
+  line.label(bank, addr);
+
+  auto length = std::min<size_t>(line.length(), size ? size-1 : 0);
+
+  memcpy(buf, line.data(), length);
+  if(size) buf[length] = '\0';
+
+  return length;
+}
+
+enum : unsigned {
+  // Column the comments after code and data start at
+  CommentColumn = 40,
+
+  // Cross-references listed above a label, the rest are counted
+  MaxListedXRefs = 4,
+
+  // Bytes per 'db' line
+  DataPerLine = 8,
+};
+
+auto RomDisassembler::listBank(unsigned bank_index, std::string& out) const -> void
+{
+  const auto& bank = banks_[bank_index];
+
+  auto base = bankBase(bank_index);
+  const u8 *data = rom_ + offset(bank_index, base);
+
+  ListingLine line;
+
+  line.put("; ROM bank $").hex(bank_index, 2)
+    .put(" ($").hex(base, 4).put("-$").hex(base + BankSize-1, 4).put(')')
+    .flush(out);
+
+  auto xref = bank.xrefs.begin();
+  for(unsigned i = 0; i < BankSize; ) {
+    u16 addr = base + i;
+    u8 flags = bank.flags[i];
+
+    if(flags & ByteLabel) {
+      line.flush(out);    // Blank line above every label
+
+      line.label(bank_index, addr).put(':');
+
+      while(xref != bank.xrefs.end() && xref->to < addr) xref++;
+
+      unsigned num_xrefs = 0;
+      for(; xref != bank.xrefs.end() && xref->to == addr; xref++, num_xrefs++) {
+        if(num_xrefs >= MaxListedXRefs) continue;
+
+        if(!num_xrefs) {
+          line.padTo(CommentColumn).put("; xrefs:");
+        } else {
+          line.put(',');
+        }
+
+        line.put(' ').hex(xref->from_bank, 2).put(':').hex(xref->from, 4);
+      }
+
+      if(num_xrefs > MaxListedXRefs) line.put(" (+").dec(num_xrefs - MaxListedXRefs).put(" more)");
+
+      if(!num_xrefs && (flags & ByteEntryPoint)) line.padTo(CommentColumn).put("; entry point");
+
+      line.flush(out);
+    }
+
+    if(flags & ByteCode) {
+      line.put("    ").hex(addr, 4).put("  ");
+
+      // The (never written to) bank is decoded in place
+      u8 *code = const_cast<u8 *>(data + i);
+
+      Instruction instruction(const_cast<u8 *>(data), base);
+      u8 *ptr = code;
+      instruction.decode(ptr, data + BankSize);
+
+      unsigned length = ptr - code;
+
+      line.advance(instruction.format(line.data() + line.length(), ListingLine::MaxLength - line.length()));
+
+      line.padTo(CommentColumn).put(';');
+      for(unsigned j = 0; j < length; j++) line.put(' ').hex(data[i + j], 2);
+
+      // Name the label the instruction branches to
+      const auto *info = p_opcode_info(data + i, BankSize - i);
+      auto target = info->is(sm83::OpBranch) ? p_branch_target(*info, data + i, addr) : -1;
+      if(target >= 0 && target < RomEnd) {
+        // The bank of a target in the switchable range has
+        //   to be looked up in the references
+        auto ref = std::lower_bound(bank.refs.begin(), bank.refs.end(), addr,
+            [](const XRef& ref, u16 addr) { return ref.from < addr; });
+
+        unsigned target_bank = ref != bank.refs.end() && ref->from == addr ? ref->to_bank : UnknownBank;
+
+        line.put("  -> ");
+        if(target_bank != UnknownBank) {
+          line.label(target_bank, target);
+        } else {
+          line.put("L??_").hex(target, 4);
+        }
+      }
+
+      line.flush(out);
+      i += length;
+
+      continue;
+    }
+
+    // Data, up until the next code or label
+    line.put("    ").hex(addr, 4).put("  db   ");
+
+    unsigned j = 0;
+    do {
+      if(j) line.put(", ");
+      line.put('$').hex(data[i + j], 2);
+
+      j++;
+    } while(j < DataPerLine && i+j < BankSize && !(bank.flags[i + j] & (ByteCode|ByteLabel)));
+
+    line.flush(out);
+    i += j;
+  }
+}
+
+}
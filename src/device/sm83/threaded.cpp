@@ -0,0 +1,92 @@
+#include <device/sm83/cpu.h>
+#include <device/sm83/ops.h>
+#include <device/sm83/opcodes.h>
+
+#include <cassert>
+
+// Expands X(hi, lo) for every opcode, where 'hi' and 'lo' are the
+//   opcode's upper and lower hex digits respectively
+#define OPS_16(X, hi) \
+  X(hi,0) X(hi,1) X(hi,2) X(hi,3) X(hi,4) X(hi,5) X(hi,6) X(hi,7) \
+  X(hi,8) X(hi,9) X(hi,A) X(hi,B) X(hi,C) X(hi,D) X(hi,E) X(hi,F)
+
+#define OPS_256(X) \
+  OPS_16(X,0) OPS_16(X,1) OPS_16(X,2) OPS_16(X,3) \
+  OPS_16(X,4) OPS_16(X,5) OPS_16(X,6) OPS_16(X,7) \
+  OPS_16(X,8) OPS_16(X,9) OPS_16(X,A) OPS_16(X,B) \
+  OPS_16(X,C) OPS_16(X,D) OPS_16(X,E) OPS_16(X,F)
+
+namespace brgb::sm83 {
+
+auto Processor::executeThreaded(unsigned instructions) -> unsigned
+{
+#define LABEL(hi, lo)    &&op_##hi##lo,
+#define LABEL_CB(hi, lo) &&cb_##hi##lo,
+
+  static const void *const Dispatch[256]   = { OPS_256(LABEL) };
+  static const void *const DispatchCB[256] = { OPS_256(LABEL_CB) };
+
+#undef LABEL_CB
+#undef LABEL
+
+  auto interrupt_state = interruptState();
+
+  // The registers stay in 'rf' until the exit, where they
+  //   get written back to 'r'
+  Registers rf = r;
+  u16 last_pc = rf.pc;
+
+  unsigned left = instructions;
+
+  // Every handler gets it's own copy of the dispatch code, which
+  //   gives the host's branch predictor a separate history for
+  //   each of them (unlike a single switch() or call site)
+  //  - Writes to IF or IE aren't confined to any opcodes, so
+  //    the interruptPending() changes are only caught through
+  //    updateInterrupts() zeroing 'until_'
+#define NEXT()                                              \
+  if(BRGB_UNLIKELY(!--left || cycles_ > until_)) goto exit; \
+  last_pc = rf.pc;                                          \
+  goto *Dispatch[opcode(rf)];
+
+#define HANDLER(hi, lo)                                          \
+  op_##hi##lo:                                                   \
+    if constexpr(0x##hi##lo == 0xCB) {                           \
+      goto *DispatchCB[opcode(rf)];                              \
+    } else {                                                     \
+      op<0x##hi##lo>(rf);                                        \
+    }                                                            \
+                                                                 \
+    if constexpr(opcode_info(0x##hi##lo).is(OpInterruptState)) { \
+      if(interruptState() != interrupt_state) {                  \
+        left--;                                                  \
+        goto exit;                                               \
+      }                                                          \
+    }                                                            \
+    NEXT();
+
+#define HANDLER_CB(hi, lo)   \
+  cb_##hi##lo:               \
+    opCB<0x##hi##lo>(rf);    \
+    NEXT();
+
+  goto *Dispatch[opcode(rf)];
+
+  OPS_256(HANDLER)
+  OPS_256(HANDLER_CB)
+
+#undef HANDLER_CB
+#undef HANDLER
+#undef NEXT
+
+exit:
+  r = rf;
+  last_pc_ = last_pc;
+
+  return instructions - left;
+}
+
+}
+
+#undef OPS_256
+#undef OPS_16
@@ -0,0 +1,320 @@
+#include <device/sm83/trace.h>
+
+#include <utility>
+
+#include <cstring>
+#include <cassert>
+
+namespace brgb::sm83 {
+
+// Written at the start of every trace file
+static constexpr char TraceMagic[8] = { 'B', 'R', 'G', 'B', 'T', 'R', 'C', 1 };
+
+// Each record is encoded relative to the previous one as:
+//   - A byte with a bit set for each of the fields below which changed
+//   - PC's difference (zig-zag encoded) and the cycle's difference,
+//     both as varints (7 bits per byte, least significant first)
+//   - The changed fields, 16-bit ones in little endian
+enum ChangedField : u8 {
+  ChangedSP     = 1<<0,
+  ChangedAF     = 1<<1,
+  ChangedBC     = 1<<2,
+  ChangedDE     = 1<<3,
+  ChangedHL     = 1<<4,
+  ChangedOpcode = 1<<5,
+  ChangedIME    = 1<<6,
+};
+
+static auto put_varint(std::vector<u8>& out, u64 v) -> void
+{
+  while(v >= 0x80) {
+    out.push_back((u8)v | 0x80);
+    v >>= 7;
+  }
+
+  out.push_back((u8)v);
+}
+
+static auto put_u16(std::vector<u8>& out, u16 v) -> void
+{
+  out.push_back((u8)v);
+  out.push_back(v >> 8);
+}
+
+static auto zigzag(u16 v) -> u16
+{
+  return (u16)(v << 1) ^ (u16)((i16)v >> 15);
+}
+
+static auto unzigzag(u16 v) -> u16
+{
+  return (v >> 1) ^ -(v & 1);
+}
+
+// Appends 'record' encoded as a delta of 'last' to 'out'
+static auto encode(std::vector<u8>& out, const TraceRecord& last, const TraceRecord& record) -> void
+{
+  u8 changed = 0;
+  if(record.sp != last.sp)         changed |= ChangedSP;
+  if(record.af != last.af)         changed |= ChangedAF;
+  if(record.bc != last.bc)         changed |= ChangedBC;
+  if(record.de != last.de)         changed |= ChangedDE;
+  if(record.hl != last.hl)         changed |= ChangedHL;
+  if(record.opcode != last.opcode) changed |= ChangedOpcode;
+  if(record.ime != last.ime)       changed |= ChangedIME;
+
+  out.push_back(changed);
+
+  put_varint(out, zigzag(record.pc - last.pc));
+  put_varint(out, record.cycle - last.cycle);
+
+  if(changed & ChangedSP) put_u16(out, record.sp);
+  if(changed & ChangedAF) put_u16(out, record.af);
+  if(changed & ChangedBC) put_u16(out, record.bc);
+  if(changed & ChangedDE) put_u16(out, record.de);
+  if(changed & ChangedHL) put_u16(out, record.hl);
+  if(changed & ChangedOpcode) out.push_back(record.opcode);
+  if(changed & ChangedIME)    out.push_back(record.ime);
+}
+
+TraceWriter::TraceWriter()
+{
+  for(auto& buffer : buffers_) buffer.resize(BufferRecords);
+}
+
+TraceWriter::~TraceWriter()
+{
+  close();
+}
+
+auto TraceWriter::open(const char *file_name) -> bool
+{
+  close();
+
+  file_ = fopen(file_name, "wb");
+  if(!file_) return false;
+
+  if(fwrite(TraceMagic, sizeof(TraceMagic), 1, file_) != 1) {
+    fclose(file_);
+    file_ = nullptr;
+
+    return false;
+  }
+
+  filled_.clear();
+  free_.clear();
+  for(auto& buffer : buffers_) free_.push_back(&buffer);
+
+  closing_ = failed_ = false;
+  records_ = 0;
+
+  current_ = free_.back();
+  free_.pop_back();
+
+  cursor_ = current_->data();
+  end_ = cursor_ + BufferRecords;
+
+  thread_ = std::thread(&TraceWriter::compressor, this);
+
+  return true;
+}
+
+auto TraceWriter::close() -> bool
+{
+  if(!file_) return true;
+
+  // Hand off the partially filled buffer...
+  current_->resize(cursor_ - current_->data());
+  records_ += current_->size();
+
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+
+    filled_.push_back(current_);
+    closing_ = true;
+  }
+  cv_.notify_all();
+
+  //  ...and wait for everything to be written out
+  thread_.join();
+
+  current_->resize(BufferRecords);
+  current_ = nullptr;
+  cursor_ = end_ = nullptr;
+
+  bool ok = !failed_;
+  if(fclose(file_)) ok = false;
+
+  file_ = nullptr;
+
+  return ok;
+}
+
+auto TraceWriter::records() const -> u64
+{
+  if(!current_) return records_;
+
+  return records_ + (cursor_ - current_->data());
+}
+
+auto TraceWriter::submit() -> void
+{
+  records_ += BufferRecords;
+
+  std::unique_lock<std::mutex> lock(mutex_);
+
+  filled_.push_back(current_);
+  cv_.notify_all();
+
+  // Only waits when all the other buffers are still
+  //   waiting to be compressed
+  cv_.wait(lock, [this] { return !free_.empty(); });
+
+  current_ = free_.back();
+  free_.pop_back();
+
+  lock.unlock();
+
+  cursor_ = current_->data();
+  end_ = cursor_ + BufferRecords;
+}
+
+auto TraceWriter::compressor() -> void
+{
+  TraceRecord last = { };
+  std::vector<u8> out;
+
+  while(true) {
+    Buffer *buffer = nullptr;
+    bool last_buffer = false;
+
+    {
+      std::unique_lock<std::mutex> lock(mutex_);
+      cv_.wait(lock, [this] { return !filled_.empty() || closing_; });
+
+      if(filled_.empty()) return;
+
+      buffer = filled_.front();
+      filled_.erase(filled_.begin());
+
+      last_buffer = closing_ && filled_.empty();
+    }
+
+    out.clear();
+    for(const auto& record : *buffer) {
+      encode(out, last, record);
+      last = record;
+    }
+
+    bool ok = fwrite(out.data(), 1, out.size(), file_) == out.size();
+
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+
+      if(!ok) failed_ = true;
+
+      // The buffer handed off by close() stays with it
+      if(!last_buffer) free_.push_back(buffer);
+    }
+    cv_.notify_all();
+
+    if(last_buffer) return;
+  }
+}
+
+TraceReader::~TraceReader()
+{
+  close();
+}
+
+auto TraceReader::open(const char *file_name) -> bool
+{
+  close();
+
+  file_ = fopen(file_name, "rb");
+  if(!file_) return false;
+
+  char magic[sizeof(TraceMagic)];
+  if(fread(magic, sizeof(magic), 1, file_) != 1 || memcmp(magic, TraceMagic, sizeof(magic))) {
+    close();
+    return false;
+  }
+
+  last_ = { };
+
+  return true;
+}
+
+auto TraceReader::close() -> void
+{
+  if(file_) fclose(file_);
+
+  file_ = nullptr;
+}
+
+auto TraceReader::next(TraceRecord& record) -> bool
+{
+  if(!file_) return false;
+
+  u8 changed;
+  if(!byte(changed)) return false;
+
+  record = last_;
+
+  u64 pc_delta, cycle_delta;
+  if(!varint(pc_delta) || !varint(cycle_delta)) return false;
+
+  record.pc += unzigzag((u16)pc_delta);
+  record.cycle += cycle_delta;
+
+  bool ok = true;
+  if(changed & ChangedSP) ok = ok && u16le(record.sp);
+  if(changed & ChangedAF) ok = ok && u16le(record.af);
+  if(changed & ChangedBC) ok = ok && u16le(record.bc);
+  if(changed & ChangedDE) ok = ok && u16le(record.de);
+  if(changed & ChangedHL) ok = ok && u16le(record.hl);
+  if(changed & ChangedOpcode) ok = ok && byte(record.opcode);
+  if(changed & ChangedIME)    ok = ok && byte(record.ime);
+
+  if(!ok) return false;
+
+  last_ = record;
+
+  return true;
+}
+
+auto TraceReader::byte(u8& b) -> bool
+{
+  int c = getc_unlocked(file_);
+  if(c == EOF) return false;
+
+  b = (u8)c;
+
+  return true;
+}
+
+auto TraceReader::varint(u64& v) -> bool
+{
+  v = 0;
+  for(unsigned shift = 0; shift < 64; shift += 7) {
+    u8 b;
+    if(!byte(b)) return false;
+
+    v |= (u64)(b & 0x7F) << shift;
+    if(!(b & 0x80)) return true;
+  }
+
+  return false;    // Too long to be a valid varint
+}
+
+auto TraceReader::u16le(u16& v) -> bool
+{
+  u8 lo, hi;
+  if(!byte(lo) || !byte(hi)) return false;
+
+  v = lo | hi << 8;
+
+  return true;
+}
+
+}
@@ -21,6 +21,11 @@ auto ISchedDevice::tick(Clock ticks) -> ISchedDevice&
   return *this;
 }
 
+auto ISchedDevice::ticksIn(Clock clk) -> Clock
+{
+  return clk / scalar_;
+}
+
 auto ISchedDevice::frequency(double freq) -> ISchedDevice&
 {
   frequency_ = freq+0.5;
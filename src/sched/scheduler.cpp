@@ -154,14 +154,32 @@ auto Scheduler::syncWith(ISchedDevice *device) -> void
   });
   assert(it_self != threads_.end() && "current Thread not owned by this Scheduler!");
 
+  auto it_device = std::find_if(threads_.begin(), threads_.end(), [=](const Thread::Ptr& t) {
+    return t->device() == device;
+  });
+  assert(it_device != threads_.end() && "'device' not owned by this Scheduler!");
+
   auto& self = *it_self;
   while(device->clock() < self->device()->clock()) {
     if(duringSync()) break;
 
-    co_switch(self->handle());
+    // Run the device which is behind until it catches up
+    co_switch((*it_device)->handle());
   }
 }
 
+auto Scheduler::nextEvent() -> ISchedDevice::Clock
+{
+  auto next = (ISchedDevice::Clock)NoEvent;
+  for(const auto& t : threads_) {
+    if(co_active() == t->thread_) continue;
+
+    next = std::min(next, t->device()->clock());
+  }
+
+  return next;
+}
+
 auto Scheduler::uniqueId() -> Thread::Id
 {
   Thread::Id id = 0;
@@ -0,0 +1,191 @@
+#include <system/gb/cartridge.h>
+
+#include <utility>
+#include <algorithm>
+
+#include <cassert>
+
+namespace brgb::gb {
+
+// Offsets of cartridge header fields
+enum : u16 {
+  HeaderCartridgeType = 0x0147,
+  HeaderRomSize       = 0x0148,
+  HeaderRamSize       = 0x0149,
+};
+
+auto Cartridge::load(std::vector<u8> rom) -> Cartridge&
+{
+  rom_ = std::move(rom);
+
+  // Pad the ROM to a whole number of banks, so
+  //   bank-relative reads never go out of bounds
+  auto num_banks = (rom_.size() + RomBankSize-1) / RomBankSize;
+  rom_.resize(std::max<size_t>(num_banks, 2) * RomBankSize, 0xFF);
+
+  return *this;
+}
+
+auto Cartridge::loaded() const -> bool
+{
+  return !rom_.empty();
+}
+
+auto Cartridge::deviceToken() -> DeviceToken
+{
+  return GameboyCartridgeDeviceToken;
+}
+
+auto Cartridge::attach(SystemBus *sys_bus, IBusDevice *target) -> DeviceMemoryMap*
+{
+  assert(target && "Cartridge::attach() called without a 'target'!");
+
+  auto map = sys_bus->createMap(target);
+
+  (*map)
+    .r("0x0000-0x7fff", [this](BusTransactionHandlerSetRef& h) {
+        h.get<BusReadHandlerSet>()
+          .fn(romReadHandler());
+    })
+    .w("0x0000-0x7fff", [this](BusTransactionHandlerSetRef& h) {
+        h.get<BusWriteHandlerSet>()
+          .fn(mapperWriteHandler());
+    })
+
+    .r("0xa000-0xbfff", [this](BusTransactionHandlerSetRef& h) {
+        h.get<BusReadHandlerSet>()
+          .fn(ramReadHandler())
+          .base(0xA000);
+    })
+    .w("0xa000-0xbfff", [this](BusTransactionHandlerSetRef& h) {
+        h.get<BusWriteHandlerSet>()
+          .fn(ramWriteHandler())
+          .base(0xA000);
+    });
+
+  return map;
+}
+
+auto Cartridge::detach(DeviceMemoryMap *map) -> void
+{
+}
+
+auto Cartridge::power() -> void
+{
+  s_ = { };
+
+  s_.rom_bank_lo = 1;
+}
+
+auto Cartridge::romBank(u16 addr) const -> unsigned
+{
+  if(mapper() == RomOnly) return addr >> 14;
+
+  unsigned bank = 0;
+  if(addr < 0x4000) {
+    // In the advanced banking mode the upper bits
+    //   affect the 0x0000-0x3FFF region as well
+    if(s_.banking_mode) bank = s_.bank_hi << 5;
+  } else {
+    bank = (s_.bank_hi << 5) | s_.rom_bank_lo;
+  }
+
+  return bank % numRomBanks();
+}
+
+auto Cartridge::romData(u16 addr) const -> const u8 *
+{
+  if(!loaded()) return nullptr;
+
+  return rom_.data() + romBank(addr)*RomBankSize + (addr & (RomBankSize-1));
+}
+
+auto Cartridge::saveState(State& state) -> void
+{
+  state = s_;
+}
+
+auto Cartridge::loadState(const State& state) -> void
+{
+  s_ = state;
+}
+
+auto Cartridge::mapper() const -> Mapper
+{
+  if(rom_.size() <= HeaderCartridgeType) return RomOnly;
+
+  switch(rom_[HeaderCartridgeType]) {
+  case MBC1:
+  case MBC1_Ram:
+  case MBC1_RamBattery: return MBC1;
+  }
+
+  // TODO: support the rest of the mappers
+  return RomOnly;
+}
+
+auto Cartridge::numRomBanks() const -> unsigned
+{
+  return rom_.size() / RomBankSize;
+}
+
+auto Cartridge::ramSize() const -> unsigned
+{
+  if(rom_.size() <= HeaderRamSize) return 0;
+
+  switch(rom_[HeaderRamSize]) {
+  case 0x02: return 1 * RamBankSize;
+  case 0x03: return 4 * RamBankSize;
+  }
+
+  return 0;
+}
+
+auto Cartridge::romReadHandler() -> BusReadHandler::ByteHandler
+{
+  return BusReadHandler::for_u8_with_addr_width<u16>([this](u16 addr) -> u8 {
+      if(!loaded()) return 0xFF;
+
+      return *romData(addr);
+  });
+}
+
+auto Cartridge::mapperWriteHandler() -> BusWriteHandler::ByteHandler
+{
+  return BusWriteHandler::for_u8_with_addr_width<u16>([this](u16 addr, u8 data) {
+      if(mapper() == RomOnly) return;
+
+      switch(addr >> 13) {
+      case 0: s_.ram_enable = (data & 0x0F) == 0x0A; break;
+      case 1: s_.rom_bank_lo = (data & 0x1F) ? (data & 0x1F) : 1; break;
+      case 2: s_.bank_hi = data & 0x03; break;
+      case 3: s_.banking_mode = data & 0x01; break;
+      }
+  });
+}
+
+auto Cartridge::ramReadHandler() -> BusReadHandler::ByteHandler
+{
+  return BusReadHandler::for_u8_with_addr_width<u16>([this](u16 addr) -> u8 {
+      auto size = ramSize();
+      if(!s_.ram_enable || !size) return 0xFF;
+
+      unsigned bank = s_.banking_mode ? s_.bank_hi : 0;
+
+      return s_.ram[(bank*RamBankSize + addr) % size];
+  });
+}
+
+auto Cartridge::ramWriteHandler() -> BusWriteHandler::ByteHandler
+{
+  return BusWriteHandler::for_u8_with_addr_width<u16>([this](u16 addr, u8 data) {
+      auto size = ramSize();
+      if(!s_.ram_enable || !size) return;
+
+      unsigned bank = s_.banking_mode ? s_.bank_hi : 0;
+
+      s_.ram[(bank*RamBankSize + addr) % size] = data;
+  });
+}
+
+}
@@ -3,6 +3,10 @@
 #include <bus/bus.h>
 #include <bus/memorymap.h>
 #include <device/sm83/cpu.h>
+#include <sched/scheduler.h>
+#include <util/compiler.h>
+
+#include <utility>
 
 #include <cassert>
 
@@ -25,30 +29,278 @@ auto CPU::detach(DeviceMemoryMap *map) -> void
 auto CPU::power() -> void
 {
   sm83::Processor::power();
+
+  // There is no boot ROM, so start off with the
+  //   register values it leaves behind (DMG)
+  State s = { };
+
+  s.af = 0x01B0; s.bc = 0x0013;
+  s.de = 0x00D8; s.hl = 0x014D;
+
+  s.sp = 0xFFFE; s.pc = 0x0100;
+
+  loadState(s);
+
+  ticked_ = 0;
+  skipped_cycles_ = 0;
 }
 
 auto CPU::main() -> void
 {
-  // TODO: handle interrupts
-  
-  instruction();   // Fetch, decode and execute an instruction
+  // None of the other devices run again before the clock() goes
+  //   past 'next_event' (see Scheduler::syncWith()), so until then
+  //   instructions are executed back-to-back, without syncing
+  //  - Reads of I/O registers don't need a sync either, as the other
+  //    devices are never behind the CPU when it's executing
+  auto next_event = scheduler()->nextEvent();
+
+  //  - A breakpoint ends the batch, as the Scheduler adjusts all
+  //    the clocks (invalidating 'next_event') when the CPU yields
+  do {
+    step(next_event);
+  } while(next_event != Scheduler::NoEvent && clock() <= next_event && !breakpointHit());
+
+  // Let the rest of the devices catch up
+  scheduler()->syncWithAll();
 }
 
-auto CPU::read(u16 addr) -> u8
+auto CPU::step(Clock next_event) -> void
 {
-  u8 data = bus().readByte(addr);
+  // The flag is only recomputed when IF, IE, IME or the
+  //   RunState change, so it's the only check needed
+  if(BRGB_UNLIKELY(interruptPending())) {
+    auto irq = interrupt();
+    if(irq != NoInterrupt) interrupts_->acknowledge(irq);
+  }
 
-  // 1 memory cycle = 4 internal cycles (t-cycles)
-  tick(4);
+  // Every instruction up to the one which takes the clock() past
+  //   'next_event' is executed by a single execute() call, which
+  //   returns early wherever an interrupt could get dispatched
+  //  - The memory cycles not yet in the clock() (ex. the dispatch)
+  //    count towards 'next_event' as well
+  unsigned instructions = 1;
+  u64 until = ~0ull;
+
+  if(next_event != Scheduler::NoEvent) {
+    auto now = clock();
+
+    instructions = ~0u;
+    until = ticked_ + (next_event > now ? ticksIn(next_event - now) / 4 : 0);
+  }
+
+  execute(instructions, until);
+  catchUp();
+
+  // Stopped right before the instruction, which gets executed once
+  //   the host resumes the emulation - the cycles spent up to that
+  //   point (ex. dispatching an interrupt to the vector the
+  //   breakpoint is on) are already in the clock() the host sees
+  if(BRGB_UNLIKELY(breakpointHit())) {
+    scheduler()->yield(Breakpoint);
+    return;
+  }
+
+  // Nothing can be skipped with an interrupt about to be serviced
+  if(idle_skip_ && !interruptPending()) {
+    if(BRGB_UNLIKELY(runState() != RunState::Running)) {
+      haltSkip();
+    } else if(BRGB_UNLIKELY((u16)(lastPc() - this->pc()) <= MaxIdleLoopBytes)) {
+      // A slice which ended on a short backward branch (or one
+      //   to itself) could've ended on an idle loop's last
+      //   instruction
+      //  - As the slices run up to 'next_event' by themselves,
+      //    the loop only gets fast-forwarded when they stop
+      //    short of it (ex. on an interrupt state change)
+      idleLoop();
+    }
+  }
+}
+
+auto CPU::romData(RomDataFn fn) -> CPU&
+{
+  rom_data_ = std::move(fn);
+
+  return *this;
+}
+
+auto CPU::mapRam(u16 addr, size_t size, u8 *data) -> CPU&
+{
+  assert(!(addr & 0xFF) && !(size & 0xFF) && "mapRam() called with a partial page!");
+
+  for(size_t offset = 0; offset < size; offset += 0x100) {
+    u8 page = (addr + offset) >> 8;
+
+    mapReadPage(page, data + offset);
+    mapWritePage(page, data + offset);
+  }
+
+  return *this;
+}
+
+auto CPU::remapRom() -> void
+{
+  for(unsigned page = 0x00; page < 0x80; page++) {
+    mapReadPage(page, rom_data_ ? rom_data_(page << 8) : nullptr);
+  }
+}
+
+auto CPU::interrupts(Interrupts *interrupts) -> CPU&
+{
+  interrupts_ = interrupts;
+
+  return *this;
+}
+
+auto CPU::romBank(RomBankFn fn) -> CPU&
+{
+  rom_bank_ = std::move(fn);
+
+  return *this;
+}
+
+auto CPU::loadState(const State& state) -> void
+{
+  sm83::Processor::loadState(state);
+
+  idle_loop_.valid = false;
+}
+
+auto CPU::idleSkip(bool enabled) -> CPU&
+{
+  idle_skip_ = enabled;
+  idle_loop_.valid = false;
 
-  return data;
+  return *this;
 }
 
-auto CPU::write(u16 addr, u8 data) -> void
+auto CPU::idleSkip() const -> bool
+{
+  return idle_skip_;
+}
+
+auto CPU::skippedCycles() const -> u64
+{
+  return skipped_cycles_;
+}
+
+auto CPU::busRead(u16 addr) -> u8
+{
+  return bus().readByte(addr);
+}
+
+auto CPU::busWrite(u16 addr, u8 data) -> void
 {
   bus().writeByte(addr, data);
 
-  tick(4);
+  // Writes to 0x0000-0x7FFF go to the cartridge's mapper
+  //   and can switch ROM banks, while 0xE000-0xFDFF
+  //   mirrors WRAM (see memoryBank())
+  if(addr < 0x8000) {
+    codeRemapped();
+    remapRom();
+  } else if(addr >= 0xE000 && addr < 0xFE00) {
+    codeWritten(addr - 0x2000);
+  } else {
+    codeWritten(addr);
+  }
+}
+
+auto CPU::catchUp() -> void
+{
+  // 1 memory cycle = 4 internal cycles (t-cycles)
+  tick(4 * (cycles() - ticked_));
+
+  ticked_ = cycles();
+}
+
+auto CPU::idleLoop() -> void
+{
+  IdleLoop loop = { };
+  loop.valid = true;
+
+  saveState(loop.state);
+  loop.writes = writes();
+  loop.clock = clock();
+  loop.next_event = scheduler()->nextEvent();
+
+  auto same_state = [](const State& a, const State& b) {
+    return a.af == b.af && a.bc == b.bc && a.de == b.de && a.hl == b.hl &&
+      a.sp == b.sp && a.pc == b.pc &&
+      a.ime == b.ime && a.ei_delay == b.ei_delay && a.run_state == b.run_state;
+  };
+
+  // Arriving at the same state twice in a row, without any writes and
+  //   without any other device running in-between, means the iteration
+  //   only read memory which didn't change - so every further one will
+  //   be exactly the same, until another device runs (and possibly
+  //   changes what the loop reads)
+  //  - Each iteration has to end at or before 'next_event', which is
+  //    when the other device will (at the earliest) run again
+  bool idle = idle_loop_.valid && idle_loop_.clock < loop.clock &&
+    idle_loop_.writes == loop.writes && idle_loop_.next_event == loop.next_event &&
+    same_state(idle_loop_.state, loop.state);
+
+  auto last_clock = idle_loop_.clock;
+  idle_loop_ = loop;
+
+  if(!idle || loop.next_event == Scheduler::NoEvent) return;
+  if(loop.next_event <= loop.clock) return;
+
+  auto iteration = loop.clock - last_clock;
+  auto iterations = (loop.next_event - loop.clock) / iteration;
+  if(!iterations) return;
+
+  // Each iteration spent a whole number of memory cycles
+  auto cycles = ticksIn(iterations*iteration) / 4;
+
+  stall(cycles);
+  catchUp();
+
+  idle_loop_.clock = clock();
+  skipped_cycles_ += cycles * 4;
+}
+
+auto CPU::haltSkip() -> void
+{
+  // The opcode following the 'halt' still has to be executed
+  if(runState() == RunState::HaltBug) return;
+
+  auto now = clock();
+  auto next_event = scheduler()->nextEvent();
+
+  if(next_event == Scheduler::NoEvent || next_event <= now) return;
+
+  // Only an interrupt can end HALT and none can happen before another
+  //   device runs, while STOP only ends on a button press, which the
+  //   host makes in-between frames (see gb::Joypad) - so every idle()
+  //   memory cycle until then is spent in one go
+  //  - As with idleLoop() the last one must start at or before
+  //    'next_event', so the CPU wakes up on exactly the same
+  //    memory cycle as it would've without skipping
+  auto cycles = ticksIn(next_event - now) / 4;
+  if(!cycles) return;
+
+  stall(cycles);
+  catchUp();
+
+  skipped_cycles_ += cycles * 4;
+}
+
+auto CPU::memoryBank(u16 addr) -> u32
+{
+  // Only ROM, WRAM and HRAM get cached - VRAM can't be
+  //   read while the PPU is drawing, the external RAM
+  //   can be disabled and I/O registers change on their own
+  if(addr < 0x8000) return rom_bank_ ? ReadOnly | rom_bank_(addr) : Uncacheable;
+  if(addr >= 0xC000 && addr < 0xE000) return 0;
+  if(addr >= 0xFF80 && addr < 0xFFFF) return 0;
+
+  return Uncacheable;
+}
+
+auto CPU::peek(u16 addr) -> u8
+{
+  return bus().readByte(addr);
 }
 
 }
@@ -3,6 +3,8 @@
 
 #include <sched/thread.h>
 
+#include <utility>
+
 #include <cassert>
 
 namespace brgb {
@@ -10,7 +12,11 @@ namespace brgb {
 Gameboy::Gameboy() :
   bus_(new SystemBus()),
 
-  cpu_(new gb::CPU())
+  cpu_(new gb::CPU()),
+  ppu_(new gb::PPU()),
+  cartridge_(new gb::Cartridge()),
+  joypad_(new gb::Joypad()),
+  interrupts_(new gb::Interrupts())
 {
 }
 
@@ -30,6 +36,16 @@ auto Gameboy::init() -> Gameboy&
   // Create the Bus(es) and map all the devices
   //   - CPU bus
   cpu().connect(bus_.get());
+  cpu().romBank([this](u16 addr) -> unsigned {
+      return cartridge().loaded() ? cartridge().romBank(addr) : 0;
+  });
+  cpu().romData([this](u16 addr) {
+      return cartridge().romData(addr);
+  });
+
+  // WRAM doesn't need to go through the SystemBus at all, though
+  //   the echo at 0xE000-0xFDFF still does (see gb::CPU::busWrite())
+  cpu().mapRam(0xC000, wram_.size(), wram_.data());
 
   auto& cpu_ram = *cpu().attach(bus_.get());
 
@@ -49,17 +65,30 @@ auto Gameboy::init() -> Gameboy&
         h.get<BusReadHandlerSet>()
           .fn(hramReadHandler())
           .base(0x0080)
-          .mask(0x007f);
+          .mask(0x00ff);
     })
     .w("0xff80-0xfffe", [this](BusTransactionHandlerSetRef& h) {
         h.get<BusWriteHandlerSet>()
           .fn(hramWriteHandler())
           .base(0x0080)
-          .mask(0x007f);
+          .mask(0x00ff);
     });
 
+  ppu().attach(bus_.get(), cpu_.get());
+  cartridge().attach(bus_.get(), cpu_.get());
+  joypad().attach(bus_.get(), cpu_.get());
+  interrupts().attach(bus_.get(), cpu_.get());
+
+  // Wire up the interrupt lines
+  interrupts().processor(cpu_.get());
+  cpu().interrupts(interrupts_.get());
+  ppu().interrupts(interrupts_.get());
+  joypad().interrupts(interrupts_.get());
+  joypad().processor(cpu_.get());
+
   // Call Thread::create() for all of the device threads
   sched.add(Thread::create(SystemClock, cpu_.get()));
+  sched.add(Thread::create(SystemClock, ppu_.get()));
   // TODO: create threads for the rest of the devices
 
   was_init_ = true;
@@ -72,12 +101,193 @@ auto Gameboy::power() -> void
   assert(was_init_ && "init() MUST be called before power()!");
 
   cpu().power();
+  ppu().power();
+  cartridge().power();
+  joypad().power();
+  interrupts().power();
+
+  // The Cartridge's banks were reset
+  cpu().remapRom();
   // TODO: power up the rest of the devices
 
   // Make the CPU the primary device
   sched.power(cpu_.get());
 }
 
+auto Gameboy::loadCartridge(std::vector<u8> rom) -> Gameboy&
+{
+  cartridge().load(std::move(rom));
+
+  return *this;
+}
+
+auto Gameboy::runFrame(bool render) -> void
+{
+  assert(was_init_ && "init() MUST be called before runFrame()!");
+
+  if(!run_ahead_) return emulateFrame(render);
+
+  assert(!cpu().breakpointHit() && "breakpoints can't be used with run-ahead!");
+
+  // Advance the emulation by a single frame, which is never shown...
+  emulateFrame(false);
+  saveState(*run_ahead_state_);
+
+  //  ...then run ahead with the current input and display the last
+  //   frame reached, so input takes effect 'run_ahead_' frames sooner
+  for(unsigned i = 0; i < run_ahead_; i++) {
+    bool last_frame = i == run_ahead_-1;
+
+    emulateFrame(render && last_frame);
+  }
+
+  // Go back to the frame the emulation is really at
+  loadState(*run_ahead_state_);
+}
+
+auto Gameboy::runAhead(unsigned frames) -> Gameboy&
+{
+  run_ahead_ = frames;
+
+  if(run_ahead_ && !run_ahead_state_) run_ahead_state_.reset(new State());
+
+  return *this;
+}
+
+auto Gameboy::input(u8 buttons) -> Gameboy&
+{
+  joypad().buttons(buttons);
+
+  return *this;
+}
+
+auto Gameboy::cpuEngine(sm83::Processor::Engine engine) -> Gameboy&
+{
+  cpu().engine(engine);
+
+  return *this;
+}
+
+auto Gameboy::cpuIdleSkip(bool enabled) -> Gameboy&
+{
+  cpu().idleSkip(enabled);
+
+  return *this;
+}
+
+auto Gameboy::cpuSkippedCycles() -> u64
+{
+  return cpu().skippedCycles();
+}
+
+auto Gameboy::cpuProfiler(sm83::Profiler *profiler) -> Gameboy&
+{
+  cpu().profiler(profiler);
+
+  return *this;
+}
+
+auto Gameboy::cpuTracer(sm83::TraceWriter *tracer) -> Gameboy&
+{
+  cpu().tracer(tracer);
+
+  return *this;
+}
+
+auto Gameboy::addBreakpoint(u16 addr) -> Gameboy&
+{
+  cpu().addBreakpoint(addr);
+
+  return *this;
+}
+
+auto Gameboy::removeBreakpoint(u16 addr) -> Gameboy&
+{
+  cpu().removeBreakpoint(addr);
+
+  return *this;
+}
+
+auto Gameboy::clearBreakpoints() -> Gameboy&
+{
+  cpu().clearBreakpoints();
+
+  return *this;
+}
+
+auto Gameboy::breakpointHit() -> bool
+{
+  return cpu().breakpointHit();
+}
+
+auto Gameboy::cpuState() -> sm83::Processor::State
+{
+  sm83::Processor::State state;
+  cpu().saveState(state);
+
+  return state;
+}
+
+auto Gameboy::cpuCycles() -> u64
+{
+  return cpu().cycles();
+}
+
+auto Gameboy::framebuffer() -> const gb::PPU::Framebuffer&
+{
+  return ppu().framebuffer();
+}
+
+auto Gameboy::saveState(State& state) -> void
+{
+  cpu().saveState(state.cpu);
+  ppu().saveState(state.ppu);
+  cartridge().saveState(state.cartridge);
+  joypad().saveState(state.joypad);
+  interrupts().saveState(state.interrupts);
+
+  state.wram = wram_;
+  state.hram = hram_;
+
+  state.cpu_clock = cpu().clock();
+  state.ppu_clock = ppu().clock();
+}
+
+auto Gameboy::loadState(const State& state) -> void
+{
+  cpu().loadState(state.cpu);
+  ppu().loadState(state.ppu);
+  cartridge().loadState(state.cartridge);
+  joypad().loadState(state.joypad);
+  interrupts().loadState(state.interrupts);
+
+  cpu().remapRom();
+
+  // Any code the CPU cached from WRAM/HRAM could be stale now
+  if(wram_ != state.wram || hram_ != state.hram) cpu().flushBlocks();
+
+  wram_ = state.wram;
+  hram_ = state.hram;
+
+  cpu().clock(state.cpu_clock);
+  ppu().clock(state.ppu_clock);
+}
+
+auto Gameboy::emulateFrame(bool render) -> void
+{
+  ppu().render(render);
+
+  while(true) {
+    auto event = sched.run(Scheduler::Run);
+
+    // The frame will be finished by the next runFrame()
+    if(event == ISchedDevice::Breakpoint) return;
+    if(event == ISchedDevice::VideoFrame) break;
+  }
+
+  sched.run(Scheduler::Sync);
+}
+
 auto Gameboy::sysBus() -> SystemBus&
 {
   return *bus_;
@@ -88,6 +298,26 @@ auto Gameboy::cpu() -> gb::CPU&
   return *cpu_;
 }
 
+auto Gameboy::ppu() -> gb::PPU&
+{
+  return *ppu_;
+}
+
+auto Gameboy::cartridge() -> gb::Cartridge&
+{
+  return *cartridge_;
+}
+
+auto Gameboy::joypad() -> gb::Joypad&
+{
+  return *joypad_;
+}
+
+auto Gameboy::interrupts() -> gb::Interrupts&
+{
+  return *interrupts_;
+}
+
 auto Gameboy::wramReadHandler() -> BusReadHandler::ByteHandler
 {
   return BusReadHandler::for_u8_with_addr_width<u16>([this](u16 addr) {
@@ -0,0 +1,137 @@
+#include <system/gb/governor.h>
+
+#include <algorithm>
+#include <thread>
+
+namespace brgb {
+
+using Seconds = std::chrono::duration<double>;
+
+// When the emulation falls behind by more than this many frames
+//   (ex. because the process was suspended or the host is too
+//   slow) pacing is restarted instead of trying to catch up,
+//   which would have the emulation run unthrottled for a while
+static constexpr unsigned MaxFramesBehind = 4;
+
+Governor::Governor() :
+  stats_start_(Clock::now())
+{
+  resync();
+}
+
+auto Governor::mode() const -> Mode
+{
+  return mode_;
+}
+
+auto Governor::mode(Mode m) -> Governor&
+{
+  mode_ = m;
+  resync();
+
+  return *this;
+}
+
+auto Governor::multiplier() const -> unsigned
+{
+  return multiplier_;
+}
+
+auto Governor::multiplier(unsigned m) -> Governor&
+{
+  multiplier_ = std::max(m, 1u);
+  resync();
+
+  return *this;
+}
+
+auto Governor::beginFrame() -> bool
+{
+  auto now = Clock::now();
+
+  switch(mode_) {
+  case RealTime:
+    present_ = true;
+    break;
+
+  // Present (at most) a single frame per native frame period, as
+  //   the host's display won't be able to show any more anyway
+  case Fast:
+  case Unlimited: {
+    auto present_period = std::chrono::duration_cast<Clock::duration>(
+        Seconds(1.0 / (mode_ == Fast ? FrameRate : PresentRate))
+    );
+
+    present_ = now - last_present_ >= present_period;
+    break;
+  }
+  }
+
+  if(present_) last_present_ = now;
+
+  return present_;
+}
+
+auto Governor::endFrame() -> void
+{
+  emulated_frames_++;
+  if(present_) presented_frames_++;
+
+  if(mode_ != Unlimited) {
+    auto period = framePeriod();
+
+    deadline_ += period;
+
+    auto now = Clock::now();
+    if(now < deadline_) {
+      std::this_thread::sleep_until(deadline_);
+    } else if(now - deadline_ > MaxFramesBehind*period) {
+      deadline_ = now;
+    }
+  }
+
+  updateStats(Clock::now());
+}
+
+auto Governor::fps() const -> double
+{
+  return fps_;
+}
+
+auto Governor::speed() const -> double
+{
+  return speed_;
+}
+
+auto Governor::framePeriod() const -> Clock::duration
+{
+  double speed = mode_ == Fast ? multiplier_ : 1.0;
+
+  return std::chrono::duration_cast<Clock::duration>(
+      Seconds(1.0 / (FrameRate * speed))
+  );
+}
+
+auto Governor::resync() -> void
+{
+  auto now = Clock::now();
+
+  deadline_ = now;
+
+  // Make sure the next frame gets presented
+  last_present_ = now - std::chrono::hours(1);
+}
+
+auto Governor::updateStats(Clock::time_point now) -> void
+{
+  double elapsed = Seconds(now - stats_start_).count();
+  if(elapsed < StatsInterval) return;
+
+  fps_   = presented_frames_ / elapsed;
+  speed_ = (emulated_frames_ / elapsed) / FrameRate * 100.0;
+
+  stats_start_ = now;
+  emulated_frames_ = presented_frames_ = 0;
+}
+
+}
@@ -0,0 +1,133 @@
+#include <system/gb/interrupts.h>
+
+#include <cassert>
+
+namespace brgb::gb {
+
+// Only the lower 5 bits of IF/IE correspond to interrupts
+enum : u8 {
+  InterruptMask = (1u << sm83::Processor::NumInterrupts) - 1,
+};
+
+auto Interrupts::deviceToken() -> DeviceToken
+{
+  return GameboyInterruptsDeviceToken;
+}
+
+auto Interrupts::attach(SystemBus *sys_bus, IBusDevice *target) -> DeviceMemoryMap*
+{
+  assert(target && "Interrupts::attach() called without a 'target'!");
+
+  auto map = sys_bus->createMap(target);
+
+  (*map)
+    .r("0xff0f-0xff0f", [this](BusTransactionHandlerSetRef& h) {
+        h.get<BusReadHandlerSet>()
+          .fn(ifReadHandler());
+    })
+    .w("0xff0f-0xff0f", [this](BusTransactionHandlerSetRef& h) {
+        h.get<BusWriteHandlerSet>()
+          .fn(ifWriteHandler());
+    })
+
+    .r("0xffff-0xffff", [this](BusTransactionHandlerSetRef& h) {
+        h.get<BusReadHandlerSet>()
+          .fn(ieReadHandler());
+    })
+    .w("0xffff-0xffff", [this](BusTransactionHandlerSetRef& h) {
+        h.get<BusWriteHandlerSet>()
+          .fn(ieWriteHandler());
+    });
+
+  return map;
+}
+
+auto Interrupts::detach(DeviceMemoryMap *map) -> void
+{
+}
+
+auto Interrupts::processor(sm83::Processor *processor) -> Interrupts&
+{
+  processor_ = processor;
+
+  return *this;
+}
+
+auto Interrupts::power() -> void
+{
+  s_ = { };
+
+  // Left behind by the boot ROM
+  s_.requested = 1u << VBlank;
+
+  update();
+}
+
+auto Interrupts::raise(Source source) -> void
+{
+  s_.requested |= 1u << source;
+
+  update();
+}
+
+auto Interrupts::acknowledge(unsigned irq) -> void
+{
+  s_.requested &= ~(1u << irq);
+
+  update();
+}
+
+auto Interrupts::saveState(State& state) -> void
+{
+  state = s_;
+}
+
+auto Interrupts::loadState(const State& state) -> void
+{
+  s_ = state;
+
+  update();
+}
+
+auto Interrupts::update() -> void
+{
+  if(!processor_) return;
+
+  processor_->interruptLines(s_.requested & s_.enabled & InterruptMask);
+}
+
+auto Interrupts::ifReadHandler() -> BusReadHandler::ByteHandler
+{
+  return BusReadHandler::for_u8_with_addr_width<u16>([this](u16 addr) -> u8 {
+      // The unused bits always read as 1
+      return ~InterruptMask | s_.requested;
+  });
+}
+
+auto Interrupts::ifWriteHandler() -> BusWriteHandler::ByteHandler
+{
+  return BusWriteHandler::for_u8_with_addr_width<u16>([this](u16 addr, u8 data) {
+      s_.requested = data & InterruptMask;
+
+      update();
+  });
+}
+
+auto Interrupts::ieReadHandler() -> BusReadHandler::ByteHandler
+{
+  return BusReadHandler::for_u8_with_addr_width<u16>([this](u16 addr) -> u8 {
+      return s_.enabled;
+  });
+}
+
+auto Interrupts::ieWriteHandler() -> BusWriteHandler::ByteHandler
+{
+  return BusWriteHandler::for_u8_with_addr_width<u16>([this](u16 addr, u8 data) {
+      // All 8 bits are writable, even though only 5 are used
+      s_.enabled = data;
+
+      update();
+  });
+}
+
+}
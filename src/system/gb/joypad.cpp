@@ -0,0 +1,115 @@
+#include <system/gb/joypad.h>
+
+#include <cassert>
+
+namespace brgb::gb {
+
+auto Joypad::deviceToken() -> DeviceToken
+{
+  return GameboyJoypadDeviceToken;
+}
+
+auto Joypad::attach(SystemBus *sys_bus, IBusDevice *target) -> DeviceMemoryMap*
+{
+  assert(target && "Joypad::attach() called without a 'target'!");
+
+  auto map = sys_bus->createMap(target);
+
+  (*map)
+    .r("0xff00-0xff00", [this](BusTransactionHandlerSetRef& h) {
+        h.get<BusReadHandlerSet>()
+          .fn(regReadHandler());
+    })
+    .w("0xff00-0xff00", [this](BusTransactionHandlerSetRef& h) {
+        h.get<BusWriteHandlerSet>()
+          .fn(regWriteHandler());
+    });
+
+  return map;
+}
+
+auto Joypad::detach(DeviceMemoryMap *map) -> void
+{
+}
+
+auto Joypad::interrupts(Interrupts *interrupts) -> Joypad&
+{
+  interrupts_ = interrupts;
+
+  return *this;
+}
+
+auto Joypad::processor(sm83::Processor *processor) -> Joypad&
+{
+  processor_ = processor;
+
+  return *this;
+}
+
+auto Joypad::power() -> void
+{
+  s_ = { };
+
+  s_.select = 0x30;
+}
+
+auto Joypad::buttons(u8 pressed) -> Joypad&
+{
+  auto last_lines = lines();
+
+  pressed_ = pressed;
+  update(last_lines);
+
+  return *this;
+}
+
+auto Joypad::saveState(State& state) -> void
+{
+  state = s_;
+}
+
+auto Joypad::loadState(const State& state) -> void
+{
+  s_ = state;
+}
+
+auto Joypad::lines() const -> u8
+{
+  u8 lines = 0;
+
+  // The select lines (and the button lines) are active-low
+  if(!(s_.select & 0x10)) lines |= pressed_ & 0x0F;          // Directions
+  if(!(s_.select & 0x20)) lines |= (pressed_ >> 4) & 0x0F;   // Buttons
+
+  return lines;
+}
+
+auto Joypad::update(u8 last_lines) -> void
+{
+  // Only a high to low transition of a line counts
+  if(!(lines() & ~last_lines)) return;
+
+  if(interrupts_) interrupts_->raise(Interrupts::Joypad);
+  if(processor_) processor_->resume();
+}
+
+auto Joypad::regReadHandler() -> BusReadHandler::ByteHandler
+{
+  return BusReadHandler::for_u8_with_addr_width<u16>([this](u16 addr) -> u8 {
+      return 0xC0 | s_.select | (~lines() & 0x0F);
+  });
+}
+
+auto Joypad::regWriteHandler() -> BusWriteHandler::ByteHandler
+{
+  return BusWriteHandler::for_u8_with_addr_width<u16>([this](u16 addr, u8 data) {
+      auto last_lines = lines();
+
+      // Selecting a group with a button held down
+      //   pulls it's line low as well
+      s_.select = data & 0x30;
+      update(last_lines);
+  });
+}
+
+}
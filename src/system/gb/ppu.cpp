@@ -0,0 +1,306 @@
+#include <system/gb/ppu.h>
+
+#include <sched/scheduler.h>
+
+#include <algorithm>
+
+#include <cassert>
+
+namespace brgb::gb {
+
+// Offsets of the registers from 0xFF40
+enum : u16 {
+  RegLCDC = 0x0, RegSTAT = 0x1,
+  RegSCY  = 0x2, RegSCX  = 0x3,
+  RegLY   = 0x4, RegLYC  = 0x5,
+  RegDMA  = 0x6,
+  RegBGP  = 0x7, RegOBP0 = 0x8, RegOBP1 = 0x9,
+  RegWY   = 0xA, RegWX   = 0xB,
+};
+
+auto PPU::deviceToken() -> DeviceToken
+{
+  return GameboyPPUDeviceToken;
+}
+
+auto PPU::attach(SystemBus *sys_bus, IBusDevice *target) -> DeviceMemoryMap*
+{
+  assert(target && "PPU::attach() called without a 'target'!");
+
+  auto map = sys_bus->createMap(target);
+
+  (*map)
+    .r("0x8000-0x9fff", [this](BusTransactionHandlerSetRef& h) {
+        h.get<BusReadHandlerSet>()
+          .fn(vramReadHandler())
+          .mask(0x1FFF);
+    })
+    .w("0x8000-0x9fff", [this](BusTransactionHandlerSetRef& h) {
+        h.get<BusWriteHandlerSet>()
+          .fn(vramWriteHandler())
+          .mask(0x1FFF);
+    })
+
+    .r("0xfe00-0xfe9f", [this](BusTransactionHandlerSetRef& h) {
+        h.get<BusReadHandlerSet>()
+          .fn(oamReadHandler())
+          .base(0xFE00);
+    })
+    .w("0xfe00-0xfe9f", [this](BusTransactionHandlerSetRef& h) {
+        h.get<BusWriteHandlerSet>()
+          .fn(oamWriteHandler())
+          .base(0xFE00);
+    })
+
+    .r("0xff40-0xff4b", [this](BusTransactionHandlerSetRef& h) {
+        h.get<BusReadHandlerSet>()
+          .fn(regReadHandler())
+          .base(0xFF40);
+    })
+    .w("0xff40-0xff4b", [this](BusTransactionHandlerSetRef& h) {
+        h.get<BusWriteHandlerSet>()
+          .fn(regWriteHandler())
+          .base(0xFF40);
+    });
+
+  return map;
+}
+
+auto PPU::detach(DeviceMemoryMap *map) -> void
+{
+}
+
+auto PPU::power() -> void
+{
+  s_ = { };
+
+  s_.lcdc = 0x91;
+  s_.bgp  = 0xFC;
+  s_.mode = OAMSearch;
+}
+
+auto PPU::main() -> void
+{
+  if(s_.ly < ScreenHeight) {
+    enterMode(OAMSearch);
+    step(OAMSearchDots);
+
+    enterMode(Transfer);
+    if(render_) renderLine();
+    step(TransferDots);
+
+    enterMode(HBlank);
+    step(HBlankDots);
+  } else {
+    step(DotsPerLine);
+  }
+
+  s_.ly = (s_.ly + 1) % LinesPerFrame;
+  updateStat();
+
+  if(s_.ly == ScreenHeight) {
+    enterMode(VBlank);
+    if(interrupts_) interrupts_->raise(Interrupts::VBlank);
+
+    // Let the host know a whole frame has been displayed
+    scheduler()->yield(VideoFrame);
+  }
+}
+
+auto PPU::interrupts(Interrupts *interrupts) -> PPU&
+{
+  interrupts_ = interrupts;
+
+  return *this;
+}
+
+auto PPU::render(bool enabled) -> PPU&
+{
+  render_ = enabled;
+
+  return *this;
+}
+
+auto PPU::framebuffer() const -> const Framebuffer&
+{
+  return framebuffer_;
+}
+
+auto PPU::saveState(State& state) -> void
+{
+  state = s_;
+}
+
+auto PPU::loadState(const State& state) -> void
+{
+  s_ = state;
+}
+
+auto PPU::step(unsigned dots) -> void
+{
+  tick(dots);
+
+  scheduler()->syncWithAll();
+}
+
+auto PPU::enterMode(Mode mode) -> void
+{
+  s_.mode = mode;
+
+  updateStat();
+}
+
+auto PPU::updateStat() -> void
+{
+  bool line = false;
+
+  // Bits 3-5 of STAT enable the interrupt in
+  //   HBlank, VBlank and OAMSearch respectively
+  switch(s_.mode) {
+  case HBlank:    line = s_.stat & 0x08; break;
+  case VBlank:    line = s_.stat & 0x10; break;
+  case OAMSearch: line = s_.stat & 0x20; break;
+  }
+
+  // ...and bit 6 when LY == LYC
+  if((s_.stat & 0x40) && s_.ly == s_.lyc) line = true;
+
+  if(line && !s_.stat_line && interrupts_) interrupts_->raise(Interrupts::Stat);
+
+  s_.stat_line = line;
+}
+
+auto PPU::renderLine() -> void
+{
+  u8 *line = framebuffer_.data() + s_.ly*ScreenWidth;
+
+  bool lcd_enable = s_.lcdc & 0x80;
+  bool bg_enable  = s_.lcdc & 0x01;
+
+  if(!lcd_enable || !bg_enable) {
+    std::fill(line, line + ScreenWidth, 0);
+    return;
+  }
+
+  u16 map_base = (s_.lcdc & 0x08) ? 0x1C00 : 0x1800;
+  bool unsigned_tile_idx = s_.lcdc & 0x10;
+
+  u8 y = s_.ly + s_.scy;
+  for(unsigned x = 0; x < ScreenWidth; x++) {
+    u8 px = x + s_.scx;
+
+    u8 tile = s_.vram[map_base + (y/8)*32 + px/8];
+
+    // Tiles are either indexed from 0x8000 (unsigned) or 0x9000 (signed)
+    u16 tile_addr = unsigned_tile_idx ? tile*16 : 0x1000 + (i8)tile*16;
+    u16 row_addr  = tile_addr + (y % 8)*2;
+
+    u8 lo = s_.vram[row_addr + 0];
+    u8 hi = s_.vram[row_addr + 1];
+
+    unsigned bit = 7 - (px % 8);
+    unsigned color = ((hi >> bit) & 1) << 1 | ((lo >> bit) & 1);
+
+    line[x] = (s_.bgp >> color*2) & 0x03;
+  }
+}
+
+auto PPU::readRegister(u16 reg) -> u8
+{
+  switch(reg) {
+  case RegLCDC: return s_.lcdc;
+  case RegSTAT: {
+    u8 coincidence = s_.ly == s_.lyc;
+
+    return 0x80 | (s_.stat & 0x78) | (coincidence << 2) | s_.mode;
+  }
+  case RegSCY:  return s_.scy;
+  case RegSCX:  return s_.scx;
+  case RegLY:   return s_.ly;
+  case RegLYC:  return s_.lyc;
+  case RegDMA:  return 0xFF;
+  case RegBGP:  return s_.bgp;
+  case RegOBP0: return s_.obp0;
+  case RegOBP1: return s_.obp1;
+  case RegWY:   return s_.wy;
+  case RegWX:   return s_.wx;
+  }
+
+  return 0xFF;
+}
+
+auto PPU::writeRegister(u16 reg, u8 data) -> void
+{
+  switch(reg) {
+  case RegLCDC: s_.lcdc = data; break;
+  case RegSTAT:                                 // Only the interrupt
+    s_.stat = data & 0x78;                      //   selects are writable
+    updateStat();
+    break;
+  case RegSCY:  s_.scy = data; break;
+  case RegSCX:  s_.scx = data; break;
+  case RegLY:   break;                          // Read-only
+  case RegLYC:
+    s_.lyc = data;
+    updateStat();
+    break;
+  case RegDMA:  break;                          // TODO: OAM DMA
+  case RegBGP:  s_.bgp = data; break;
+  case RegOBP0: s_.obp0 = data; break;
+  case RegOBP1: s_.obp1 = data; break;
+  case RegWY:   s_.wy = data; break;
+  case RegWX:   s_.wx = data; break;
+  }
+}
+
+auto PPU::vramReadHandler() -> BusReadHandler::ByteHandler
+{
+  return BusReadHandler::for_u8_with_addr_width<u16>([this](u16 addr) {
+      assert(addr < s_.vram.size());    // Sanity check
+
+      return s_.vram[addr];
+  });
+}
+
+auto PPU::vramWriteHandler() -> BusWriteHandler::ByteHandler
+{
+  return BusWriteHandler::for_u8_with_addr_width<u16>([this](u16 addr, u8 data) {
+      assert(addr < s_.vram.size());    // Sanity check
+
+      s_.vram[addr] = data;
+  });
+}
+
+auto PPU::oamReadHandler() -> BusReadHandler::ByteHandler
+{
+  return BusReadHandler::for_u8_with_addr_width<u16>([this](u16 addr) {
+      assert(addr < s_.oam.size());    // Sanity check
+
+      return s_.oam[addr];
+  });
+}
+
+auto PPU::oamWriteHandler() -> BusWriteHandler::ByteHandler
+{
+  return BusWriteHandler::for_u8_with_addr_width<u16>([this](u16 addr, u8 data) {
+      assert(addr < s_.oam.size());    // Sanity check
+
+      s_.oam[addr] = data;
+  });
+}
+
+auto PPU::regReadHandler() -> BusReadHandler::ByteHandler
+{
+  return BusReadHandler::for_u8_with_addr_width<u16>([this](u16 reg) {
+      return readRegister(reg);
+  });
+}
+
+auto PPU::regWriteHandler() -> BusWriteHandler::ByteHandler
+{
+  return BusWriteHandler::for_u8_with_addr_width<u16>([this](u16 reg, u8 data) {
+      writeRegister(reg, data);
+  });
+}
+
+}
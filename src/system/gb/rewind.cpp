@@ -0,0 +1,235 @@
+#include <system/gb/rewind.h>
+
+#include <algorithm>
+#include <utility>
+
+#include <cstring>
+#include <cassert>
+
+namespace brgb {
+
+// Runs of zero bytes shorter than this are folded into the
+//   surrounding literal, as encoding them on their own would
+//   take up more space than they save
+static constexpr size_t MinZeroRun = 4;
+
+// Upper bound on the output of Rewind::encode(), as each
+//   literal is preceded by at least MinZeroRun zero bytes
+//   (except the first one), the per-literal overhead is
+//   always paid for by the zero run it replaces
+static constexpr size_t MaxEncodedSize = sizeof(Gameboy::State) + 64;
+
+// Average size of a Delta assumed when sizing the ring of
+//   Delta descriptors
+static constexpr size_t AverageDeltaSize = 256;
+
+static auto write_varint(u8 *out, size_t v) -> u8 *
+{
+  while(v >= 0x80) {
+    *out++ = (u8)(v | 0x80);
+    v >>= 7;
+  }
+  *out++ = (u8)v;
+
+  return out;
+}
+
+static auto read_varint(const u8 *in, size_t& v) -> const u8 *
+{
+  v = 0;
+
+  unsigned shift = 0;
+  u8 b;
+  do {
+    b = *in++;
+
+    v |= (size_t)(b & 0x7F) << shift;
+    shift += 7;
+  } while(b & 0x80);
+
+  return in;
+}
+
+Rewind::Rewind(Gameboy *gb, size_t buffer_size, unsigned interval) :
+  gb_(gb),
+  interval_(std::max(interval, 1u)),
+  head_(new Gameboy::State()),
+  current_(new Gameboy::State()),
+  scratch_(MaxEncodedSize),
+  buffer_(buffer_size),
+  deltas_(buffer_size/AverageDeltaSize + 1)
+{
+}
+
+auto Rewind::frame() -> Rewind&
+{
+  if(++frame_counter_ < interval_) return *this;
+
+  frame_counter_ = 0;
+
+  return capture();
+}
+
+auto Rewind::capture() -> Rewind&
+{
+  gb_->saveState(*current_);
+
+  if(has_head_) {
+    auto head    = (const u8 *)head_.get();
+    auto current = (const u8 *)current_.get();
+
+    // Store the difference between the previous snapshot and
+    //   the one being captured, which will allow for getting
+    //   back the former from the latter
+    auto size   = encode(head, current, scratch_.data());
+    auto offset = allocate(size);
+
+    memcpy(buffer_.data() + offset, scratch_.data(), size);
+
+    auto idx = (first_delta_ + num_deltas_) % deltas_.size();
+    deltas_[idx] = { offset, size };
+
+    num_deltas_++;
+  }
+
+  // The captured snapshot becomes the new head
+  std::swap(head_, current_);
+  has_head_ = true;
+
+  return *this;
+}
+
+auto Rewind::step() -> bool
+{
+  if(!has_head_) return false;
+
+  if(!num_deltas_) {
+    // Can't go back any further
+    gb_->loadState(*head_);
+
+    return false;
+  }
+
+  auto idx = (first_delta_ + num_deltas_-1) % deltas_.size();
+  const auto& delta = deltas_[idx];
+
+  apply(buffer_.data() + delta.offset, delta.size, (u8 *)head_.get());
+  num_deltas_--;
+
+  gb_->loadState(*head_);
+  frame_counter_ = 0;
+
+  return true;
+}
+
+auto Rewind::reset() -> Rewind&
+{
+  has_head_ = false;
+
+  first_delta_ = num_deltas_ = 0;
+  frame_counter_ = 0;
+
+  return *this;
+}
+
+auto Rewind::depth() const -> size_t
+{
+  return num_deltas_;
+}
+
+auto Rewind::encode(const u8 *a, const u8 *b, u8 *out) -> size_t
+{
+  constexpr size_t n = sizeof(Gameboy::State);
+
+  u8 *out_begin = out;
+
+  size_t i = 0;
+  while(i < n) {
+    // Skip over the bytes which haven't changed...
+    size_t zeros = 0;
+    while(i < n && !(a[i] ^ b[i])) { zeros++; i++; }
+
+    if(i == n) break;     // Trailing zeros don't need to be stored
+
+    //  ...and gather the ones which did
+    size_t literal_end = i, zero_run = 0;
+    while(literal_end + zero_run < n) {
+      auto idx = literal_end + zero_run;
+
+      if(!(a[idx] ^ b[idx])) {
+        if(++zero_run >= MinZeroRun) break;
+      } else {
+        literal_end = idx+1;
+        zero_run = 0;
+      }
+    }
+
+    out = write_varint(out, zeros);
+    out = write_varint(out, literal_end - i);
+    for(; i < literal_end; i++) *out++ = a[i] ^ b[i];
+  }
+
+  assert((size_t)(out - out_begin) <= MaxEncodedSize);
+
+  return out - out_begin;
+}
+
+auto Rewind::apply(const u8 *delta, size_t size, u8 *state) -> void
+{
+  const u8 *end = delta + size;
+
+  while(delta < end) {
+    size_t zeros, literal;
+
+    delta = read_varint(delta, zeros);
+    delta = read_varint(delta, literal);
+
+    state += zeros;
+    for(size_t i = 0; i < literal; i++) *state++ ^= *delta++;
+  }
+}
+
+auto Rewind::allocate(size_t size) -> size_t
+{
+  assert(size <= buffer_.size() && "Rewind buffer too small to fit a single snapshot!");
+
+  size_t offset = 0;
+  if(num_deltas_) {
+    auto idx = (first_delta_ + num_deltas_-1) % deltas_.size();
+    offset = deltas_[idx].offset + deltas_[idx].size;
+  }
+
+  // Deltas are never split, so when the new one doesn't fit
+  //   at the end of the buffer it's placed at the beginning
+  //   and any (older) Deltas past 'offset' are dropped
+  size_t wrapped_from = buffer_.size();
+  if(offset + size > buffer_.size()) {
+    wrapped_from = offset;
+    offset = 0;
+  }
+
+  while(num_deltas_) {
+    const auto& oldest = deltas_[first_delta_];
+
+    bool overlaps = oldest.offset < offset+size && offset < oldest.offset+oldest.size;
+    bool skipped  = oldest.offset >= wrapped_from;
+
+    if(!overlaps && !skipped) break;
+
+    evictOldest();
+  }
+
+  if(num_deltas_ == deltas_.size()) evictOldest();
+
+  return offset;
+}
+
+auto Rewind::evictOldest() -> void
+{
+  assert(num_deltas_ > 0);
+
+  first_delta_ = (first_delta_ + 1) % deltas_.size();
+  num_deltas_--;
+}
+
+}
@@ -0,0 +1,573 @@
+#include "flat.h"
+#include "json.h"
+
+#include <device/sm83/opcodes.h>
+#include <util/format.h>
+
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+
+#include <array>
+#include <chrono>
+#include <memory>
+#include <optional>
+#include <string>
+#include <vector>
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+using namespace brgb;
+using namespace brgb::tools;
+
+using Engine = sm83::Processor::Engine;
+using RunState = sm83::Processor::RunState;
+
+// Default number of times each test vector is executed
+//   for the throughput measurements
+static constexpr unsigned DefaultRepeats = 100;
+
+// Default number of failures reported for each file
+static constexpr unsigned DefaultFailureLimit = 5;
+
+// A single memory cycle of a test vector
+struct Cycle {
+  enum Kind : u8 {
+    Internal, Read, Write,
+  };
+
+  Kind kind;
+
+  u16 addr;
+  u8 data;
+};
+
+// A single instruction executed from the 'initial' to the
+//   'final' state, spending the listed memory cycles
+struct TestVector {
+  std::string name;
+
+  sm83::Processor::State initial, final;
+
+  // Whether the vector gives 'ei_delay' (as "ei") for the final
+  //   state, otherwise a pending 'ei' counts as IME being set
+  bool final_ei = false;
+
+  std::vector<std::pair<u16, u8>> initial_ram, final_ram;
+
+  // Empty when the vector doesn't list them
+  std::vector<Cycle> cycles;
+};
+
+// Groups of instructions the throughput gets reported for
+enum class OpClass : unsigned {
+  Misc,      // nop, stop, halt, di, ei, daa, cpl, scf, ccf and the illegal opcodes
+  Load8,     // ld between the 8-bit registers, immediates and memory
+  Load16,    // ld of the 16-bit registers, push, pop
+  Alu8,      // add, adc, sub, sbc, and, xor, or, cp, inc, dec
+  Alu16,     // inc, dec, add hl and add sp of the 16-bit registers
+  Rotate,    // rlca, rrca, rla, rra and the CB rotates/shifts
+  Bit,       // bit, res, set
+  Jump,      // jr, jp, call, ret, reti, rst
+
+  NumClasses,
+};
+
+static constexpr std::array<const char *, (size_t)OpClass::NumClasses> OpClassNames = {
+  "misc", "ld8", "ld16", "alu8", "alu16", "rotate", "bit", "jump",
+};
+
+static auto op_class(u8 op, u8 cb_op) -> OpClass
+{
+  using sm83::Mnemonic;
+  using sm83::Operand;
+
+  const auto& info = op == 0xCB ? sm83::opcode_info_cb(cb_op) : sm83::opcode_info(op);
+
+  // ld hl, sp+<offset> and the 16-bit registers
+  bool wide = false;
+  for(auto operand : info.operands) {
+    wide = wide || (operand >= Operand::AF && operand <= Operand::SP) || operand == Operand::SPOffset8;
+  }
+
+  switch(info.mnemonic) {
+  case Mnemonic::Ld: case Mnemonic::Ldh:
+    return wide ? OpClass::Load16 : OpClass::Load8;
+
+  case Mnemonic::Push: case Mnemonic::Pop:
+    return OpClass::Load16;
+
+  case Mnemonic::Add: case Mnemonic::Inc: case Mnemonic::Dec:
+    return wide ? OpClass::Alu16 : OpClass::Alu8;
+
+  case Mnemonic::Adc: case Mnemonic::Sub: case Mnemonic::Sbc: case Mnemonic::And:
+  case Mnemonic::Xor: case Mnemonic::Or: case Mnemonic::Cp:
+    return OpClass::Alu8;
+
+  case Mnemonic::Rlca: case Mnemonic::Rla: case Mnemonic::Rrca: case Mnemonic::Rra:
+  case Mnemonic::Rlc: case Mnemonic::Rl: case Mnemonic::Rrc: case Mnemonic::Rr:
+  case Mnemonic::Sla: case Mnemonic::Sra: case Mnemonic::Srl: case Mnemonic::Swap:
+    return OpClass::Rotate;
+
+  case Mnemonic::Bit: case Mnemonic::Res: case Mnemonic::Set:
+    return OpClass::Bit;
+
+  case Mnemonic::Jp: case Mnemonic::Jr: case Mnemonic::Call:
+  case Mnemonic::Ret: case Mnemonic::Reti: case Mnemonic::Rst:
+    return OpClass::Jump;
+
+  default: break;
+  }
+
+  return OpClass::Misc;
+}
+
+static auto load_file(const char *file_name) -> std::optional<std::string>
+{
+  auto fd = open(file_name, O_RDONLY);
+  if(fd < 0) return std::nullopt;
+
+  struct stat st;
+  if(fstat(fd, &st) < 0) {
+    close(fd);
+    return std::nullopt;
+  }
+
+  std::string data(st.st_size, '\0');
+  if(read(fd, data.data(), data.size()) != (ssize_t)data.size()) {
+    close(fd);
+    return std::nullopt;
+  }
+
+  close(fd);
+  return data;
+}
+
+static auto number(const JsonValue *value, unsigned max, unsigned& out) -> bool
+{
+  if(!value || value->type != JsonValue::Number) return false;
+  if(value->number < 0 || value->number > max) return false;
+
+  out = (unsigned)value->number;
+
+  return true;
+}
+
+// Parses one of the "initial"/"final" objects
+static auto parse_state(const JsonValue& json, sm83::Processor::State& state,
+    std::vector<std::pair<u16, u8>>& ram, bool *has_ei) -> bool
+{
+  if(json.type != JsonValue::Object) return false;
+
+  unsigned a, f, b, c, d, e, h, l, sp, pc;
+  bool ok =
+    number(json.member("a"), 0xFF, a) && number(json.member("f"), 0xFF, f) &&
+    number(json.member("b"), 0xFF, b) && number(json.member("c"), 0xFF, c) &&
+    number(json.member("d"), 0xFF, d) && number(json.member("e"), 0xFF, e) &&
+    number(json.member("h"), 0xFF, h) && number(json.member("l"), 0xFF, l) &&
+    number(json.member("sp"), 0xFFFF, sp) && number(json.member("pc"), 0xFFFF, pc);
+  if(!ok) return false;
+
+  state.af = a << 8 | f; state.bc = b << 8 | c;
+  state.de = d << 8 | e; state.hl = h << 8 | l;
+  state.sp = sp; state.pc = pc;
+
+  // Both are optional
+  unsigned ime = 0, ei = 0;
+  if(auto json_ime = json.member("ime"); json_ime && !number(json_ime, 1, ime)) return false;
+
+  auto json_ei = json.member("ei");
+  if(json_ei && !number(json_ei, 1, ei)) return false;
+  if(has_ei) *has_ei = json_ei;
+
+  state.ime = ime;
+  state.ei_delay = ei;
+  state.run_state = RunState::Running;
+
+  auto json_ram = json.member("ram");
+  if(!json_ram || json_ram->type != JsonValue::Array) return false;
+
+  for(const auto& entry : json_ram->array) {
+    unsigned addr, data;
+    if(entry.type != JsonValue::Array || entry.array.size() != 2) return false;
+    if(!number(&entry.array[0], 0xFFFF, addr) || !number(&entry.array[1], 0xFF, data)) return false;
+
+    ram.emplace_back(addr, data);
+  }
+
+  return true;
+}
+
+// Each cycle is either null (an internal cycle) or [addr, data, kind],
+//   where 'kind' contains an 'r' for reads and a 'w' for writes
+static auto parse_cycle(const JsonValue& json, Cycle& cycle) -> bool
+{
+  cycle = { Cycle::Internal, 0, 0 };
+  if(json.type == JsonValue::Null) return true;
+
+  if(json.type != JsonValue::Array || json.array.size() < 2) return false;
+
+  unsigned addr, data;
+  if(!number(&json.array[0], 0xFFFF, addr)) return false;
+
+  // Some vectors give null data for internal cycles
+  if(json.array[1].type == JsonValue::Null) {
+    data = 0;
+  } else if(!number(&json.array[1], 0xFF, data)) {
+    return false;
+  }
+
+  cycle.addr = addr;
+  cycle.data = data;
+
+  if(json.array.size() > 2 && json.array[2].type == JsonValue::String) {
+    const auto& kind = json.array[2].string;
+
+    if(kind.find('r') != std::string::npos) {
+      cycle.kind = Cycle::Read;
+    } else if(kind.find('w') != std::string::npos) {
+      cycle.kind = Cycle::Write;
+    }
+  }
+
+  return true;
+}
+
+static auto parse_vector(const JsonValue& json) -> std::optional<TestVector>
+{
+  if(json.type != JsonValue::Object) return std::nullopt;
+
+  TestVector vector;
+
+  if(auto name = json.member("name"); name && name->type == JsonValue::String) {
+    vector.name = name->string;
+  }
+
+  auto initial = json.member("initial");
+  auto final = json.member("final");
+  if(!initial || !final) return std::nullopt;
+
+  if(!parse_state(*initial, vector.initial, vector.initial_ram, nullptr)) return std::nullopt;
+  if(!parse_state(*final, vector.final, vector.final_ram, &vector.final_ei)) return std::nullopt;
+
+  if(auto cycles = json.member("cycles")) {
+    if(cycles->type != JsonValue::Array) return std::nullopt;
+
+    for(const auto& json_cycle : cycles->array) {
+      Cycle cycle;
+      if(!parse_cycle(json_cycle, cycle)) return std::nullopt;
+
+      vector.cycles.push_back(cycle);
+    }
+  }
+
+  return vector;
+}
+
+// Returns the vector's first opcode (and the one following a 0xCB prefix)
+static auto vector_opcode(const TestVector& vector) -> std::pair<u8, u8>
+{
+  u8 op = 0, cb_op = 0;
+  for(const auto& [addr, data] : vector.initial_ram) {
+    if(addr == vector.initial.pc) op = data;
+    if(addr == (u16)(vector.initial.pc + 1)) cb_op = data;
+  }
+
+  return { op, cb_op };
+}
+
+// Loads the vector's initial state into 'p' (which
+//   resets it's cycles() and block cache)
+static auto setup(FlatProcessor& p, const TestVector& vector) -> void
+{
+  for(const auto& [addr, data] : vector.initial_ram) p.memory()[addr] = data;
+
+  p.power();
+  p.loadState(vector.initial);
+}
+
+// Returns the addresses touched by the vector back to 0
+static auto teardown(FlatProcessor& p, const TestVector& vector,
+    const std::vector<FlatProcessor::BusWrite>& writes) -> void
+{
+  for(const auto& [addr, data] : vector.initial_ram) p.memory()[addr] = 0;
+  for(const auto& [addr, data] : vector.final_ram) p.memory()[addr] = 0;
+  for(const auto& write : writes) p.memory()[write.addr] = 0;
+}
+
+// Compares the state of 'p' after executing 'vector' and returns
+//   a description of the first mismatch (or an empty string)
+//  - The bus reads are only compared when 'compare_reads' is set
+static auto check(FlatProcessor& p, const TestVector& vector, bool compare_reads,
+    const std::vector<FlatProcessor::BusRead>& reads,
+    const std::vector<FlatProcessor::BusWrite>& writes) -> std::string
+{
+  sm83::Processor::State s;
+  p.saveState(s);
+
+  const auto& f = vector.final;
+
+  auto compare16 = [](const char *name, u16 expected, u16 actual) -> std::string {
+    if(expected == actual) return { };
+
+    return util::fmt("%s=%04x (expected %04x)", name, actual, expected);
+  };
+
+  for(const auto& mismatch : {
+        compare16("af", f.af, s.af), compare16("bc", f.bc, s.bc),
+        compare16("de", f.de, s.de), compare16("hl", f.hl, s.hl),
+        compare16("sp", f.sp, s.sp), compare16("pc", f.pc, s.pc) }) {
+    if(!mismatch.empty()) return mismatch;
+  }
+
+  if(vector.final_ei) {
+    if(s.ime != f.ime || s.ei_delay != f.ei_delay) {
+      return util::fmt("ime=%u ei=%u (expected ime=%u ei=%u)", s.ime, s.ei_delay, f.ime, f.ei_delay);
+    }
+  } else if((s.ime || s.ei_delay) != f.ime) {
+    return util::fmt("ime=%u (expected %u)", s.ime || s.ei_delay, f.ime);
+  }
+
+  for(const auto& [addr, data] : vector.final_ram) {
+    u8 actual = p.memory()[addr];
+    if(actual != data) return util::fmt("(%04x)=%02x (expected %02x)", addr, actual, data);
+  }
+
+  if(vector.cycles.empty()) return { };
+
+  if(p.cycles() != vector.cycles.size()) {
+    return util::fmt("%llu memory cycles (expected %zu)",
+        (unsigned long long)p.cycles(), vector.cycles.size());
+  }
+
+  // Match up the expected bus accesses with the logged ones
+  size_t read = 0, write = 0;
+  for(size_t i = 0; i < vector.cycles.size(); i++) {
+    const auto& cycle = vector.cycles[i];
+
+    if(cycle.kind == Cycle::Write) {
+      FlatProcessor::BusWrite expected = { cycle.addr, cycle.data, i };
+      if(write >= writes.size() || !(writes[write] == expected)) {
+        return util::fmt("no write (%04x)=%02x during cycle %zu", cycle.addr, cycle.data, i);
+      }
+
+      write++;
+    } else if(cycle.kind == Cycle::Read && compare_reads) {
+      FlatProcessor::BusRead expected = { cycle.addr, cycle.data, i };
+      if(read >= reads.size() || !(reads[read] == expected)) {
+        return util::fmt("no read (%04x)=%02x during cycle %zu", cycle.addr, cycle.data, i);
+      }
+
+      read++;
+    }
+  }
+
+  if(write != writes.size()) {
+    const auto& extra = writes[write];
+
+    return util::fmt("unexpected write (%04x)=%02x during cycle %llu",
+        extra.addr, extra.data, (unsigned long long)extra.cycle);
+  }
+
+  if(compare_reads && read != reads.size()) {
+    const auto& extra = reads[read];
+
+    return util::fmt("unexpected read (%04x)=%02x during cycle %llu",
+        extra.addr, extra.data, (unsigned long long)extra.cycle);
+  }
+
+  return { };
+}
+
+// Instructions executed (and the time it took) for each OpClass
+struct Throughput {
+  std::array<unsigned long long, (size_t)OpClass::NumClasses> instructions = { };
+  std::array<double, (size_t)OpClass::NumClasses> seconds = { };
+};
+
+// Executes 'vector' 'repeats' times on 'p' (without any logging)
+//   and adds the time it took to 'throughput'
+//  - The initial state is restored before each repeat, the
+//    time of which is included in the measurement
+static auto measure(FlatProcessor& p, const TestVector& vector, unsigned repeats,
+    Throughput& throughput) -> void
+{
+  setup(p, vector);
+
+  auto start = std::chrono::steady_clock::now();
+
+  for(unsigned i = 0; i < repeats; i++) {
+    // Unchanged bytes are skipped, so the Blocks aren't invalidated
+    for(const auto& [addr, data] : vector.initial_ram) {
+      if(p.memory()[addr] != data) p.store(addr, data);
+    }
+
+    p.loadState(vector.initial);
+    p.execute(1);
+  }
+
+  std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+
+  auto [op, cb_op] = vector_opcode(vector);
+  auto index = (size_t)op_class(op, cb_op);
+
+  throughput.instructions[index] += repeats;
+  throughput.seconds[index] += elapsed.count();
+
+  teardown(p, vector, { });
+}
+
+static auto usage(const char *argv0) -> int
+{
+  fprintf(stderr,
+      "usage: %s [-e engine] [-r repeats] [-l limit] test.json...\n\n"
+      "Runs single instruction test vectors against an sm83::Processor (the table\n"
+      "engine by default, threaded, cached or jit) connected to a flat 64KiB memory.\n"
+      "Each file holds an array of (or a single) test vector objects made up of:\n"
+      "  - \"name\"\n"
+      "  - \"initial\" and \"final\" states, with the registers (\"a\", \"f\", \"b\", \"c\",\n"
+      "    \"d\", \"e\", \"h\", \"l\", \"sp\" and \"pc\"), optional \"ime\" and \"ei\" (a pending\n"
+      "    'ei') and \"ram\" - an array of [address, value] pairs\n"
+      "  - optional \"cycles\", one per memory cycle, each null or [address, value, kind]\n"
+      "    where a 'kind' containing 'r' marks a read and one containing 'w' a write\n\n"
+      "The registers, IME, RAM, memory cycle count and bus writes are compared (the\n"
+      "bus reads too, except with the cached and jit engines as they don't fetch\n"
+      "instructions from the bus). Up to 'limit' (5 by default) failures are\n"
+      "reported per file.\n\n"
+      "Afterwards each vector is executed 'repeats' more times (100 by default, 0\n"
+      "disables it) to report the instructions per second of each class of opcodes.\n",
+      argv0);
+
+  return -1;
+}
+
+int main(int argc, char *argv[])
+{
+  Engine engine = Engine::Table;
+  unsigned repeats = DefaultRepeats;
+  unsigned failure_limit = DefaultFailureLimit;
+
+  int opt;
+  while((opt = getopt(argc, argv, "e:r:l:h")) != -1) {
+    switch(opt) {
+    case 'r': repeats = strtoul(optarg, nullptr, 0); break;
+    case 'l': failure_limit = strtoul(optarg, nullptr, 0); break;
+
+    case 'e':
+      if(auto e = engine_from_name(optarg)) {
+        engine = *e;
+        break;
+      }
+
+      fprintf(stderr, "unknown engine `%s'!\n", optarg);
+      [[fallthrough]];
+
+    default: return usage(argv[0]);
+    }
+  }
+
+  if(optind >= argc) return usage(argv[0]);
+
+  // Allocated on the heap as each one holds the whole 64KiB memory
+  auto p     = std::make_unique<FlatProcessor>();
+  auto bench = std::make_unique<FlatProcessor>();
+
+  p->engine(engine);
+  bench->engine(engine);
+
+  // Blocks are predecoded, see FlatProcessor::logReads()
+  bool compare_reads = engine == Engine::Table || engine == Engine::Threaded;
+
+  std::vector<FlatProcessor::BusRead> reads;
+  std::vector<FlatProcessor::BusWrite> writes;
+  p->logReads(&reads);
+  p->logWrites(&writes);
+
+  Throughput throughput;
+
+  unsigned long long total = 0, failed = 0;
+  bool malformed = false;
+
+  for(int i = optind; i < argc; i++) {
+    const char *file_name = argv[i];
+
+    auto data = load_file(file_name);
+    if(!data) {
+      fprintf(stderr, "couldn't read `%s'!\n", file_name);
+      return -1;
+    }
+
+    JsonParser parser(data->data(), data->data() + data->size());
+
+    auto json = parser.parse();
+    if(!json) {
+      fprintf(stderr, "%s: malformed JSON at offset %zu!\n", file_name, parser.offset());
+
+      malformed = true;
+      continue;
+    }
+
+    // A file can also hold just a single vector
+    std::vector<JsonValue> json_vectors;
+    if(json->type == JsonValue::Array) {
+      json_vectors = std::move(json->array);
+    } else {
+      json_vectors.push_back(std::move(*json));
+    }
+
+    unsigned file_total = 0, file_failed = 0;
+    for(const auto& json_vector : json_vectors) {
+      auto vector = parse_vector(json_vector);
+      if(!vector) {
+        fprintf(stderr, "%s: malformed test vector #%u!\n", file_name, file_total);
+
+        malformed = true;
+        break;
+      }
+
+      file_total++;
+
+      reads.clear();
+      writes.clear();
+
+      setup(*p, *vector);
+      p->execute(1);
+
+      auto mismatch = check(*p, *vector, compare_reads, reads, writes);
+      if(!mismatch.empty()) {
+        if(file_failed < failure_limit) {
+          printf("%s: FAIL %s: %s\n", file_name, vector->name.data(), mismatch.data());
+        }
+
+        file_failed++;
+      }
+
+      teardown(*p, *vector, writes);
+
+      if(repeats) measure(*bench, *vector, repeats, throughput);
+    }
+
+    printf("%s: %u/%u passed\n", file_name, file_total - file_failed, file_total);
+
+    total += file_total;
+    failed += file_failed;
+  }
+
+  printf("%s: %llu/%llu test vectors passed\n", engine_name(engine), total - failed, total);
+
+  if(repeats && total) {
+    printf("\n%-8s %16s %16s\n", "class", "instructions", "instructions/s");
+
+    for(size_t i = 0; i < OpClassNames.size(); i++) {
+      if(!throughput.instructions[i]) continue;
+
+      printf("%-8s %16llu %15.1fM\n", OpClassNames[i], throughput.instructions[i],
+          throughput.instructions[i] / throughput.seconds[i] / 1e6);
+    }
+  }
+
+  return failed || malformed ? 1 : 0;
+}
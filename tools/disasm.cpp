@@ -0,0 +1,370 @@
+#include <device/sm83/romdisasm.h>
+
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+
+#include <sys/mman.h>
+
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <cerrno>
+#include <cstdio>
+#include <cstdlib>
+
+using namespace brgb;
+
+using sm83disasm::RomDisassembler;
+
+// A read-only mapping of a whole file, which saves copying
+//   large ROMs (or sets of them) before disassembling
+class MappedFile {
+public:
+  MappedFile() = default;
+  MappedFile(const MappedFile&) = delete;
+
+  ~MappedFile()
+  {
+    if(data_) munmap(data_, size_);
+  }
+
+  auto open(const char *file_name) -> bool
+  {
+    auto fd = ::open(file_name, O_RDONLY);
+    if(fd < 0) return false;
+
+    struct stat st;
+    if(fstat(fd, &st) < 0 || !st.st_size) {
+      close(fd);
+      return false;
+    }
+
+    auto mem = mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);      // The mapping keeps the file referenced
+
+    if(mem == MAP_FAILED) return false;
+
+    data_ = mem;
+    size_ = st.st_size;
+
+    // The banks get read front to back (analyze() reads bank 0 a lot
+    //   more, but it's 16KiB), so let the kernel read ahead
+    madvise(data_, size_, MADV_SEQUENTIAL);
+
+    return true;
+  }
+
+  auto data() const -> const u8 * { return (const u8 *)data_; }
+  auto size() const -> size_t { return size_; }
+
+private:
+  void *data_ = nullptr;
+  size_t size_ = 0;
+};
+
+// Gathers the output into large write()s, which (unlike stdio)
+//   doesn't copy chunks which are already larger than the buffer
+class BufferedWriter {
+public:
+  enum : size_t {
+    BufferSize = 1024 * 1024,
+  };
+
+  BufferedWriter(int fd) :
+    fd_(fd)
+  {
+    buf_.reserve(BufferSize);
+  }
+
+  ~BufferedWriter()
+  {
+    flush();
+  }
+
+  auto write(const char *data, size_t size) -> void
+  {
+    if(buf_.size() + size > BufferSize) flush();
+
+    if(size >= BufferSize) {
+      writeAll(data, size);
+    } else {
+      buf_.append(data, size);
+    }
+  }
+
+  auto write(const std::string& str) -> void { write(str.data(), str.size()); }
+
+  auto flush() -> void
+  {
+    writeAll(buf_.data(), buf_.size());
+    buf_.clear();
+  }
+
+  // Returns 'false' if any of the write()s failed
+  auto good() const -> bool { return good_; }
+
+private:
+  auto writeAll(const char *data, size_t size) -> void
+  {
+    while(size && good_) {
+      auto written = ::write(fd_, data, size);
+      if(written < 0) {
+        if(errno == EINTR) continue;
+
+        good_ = false;
+        break;
+      }
+
+      data += written;
+      size -= written;
+    }
+  }
+
+  int fd_;
+  std::string buf_;
+
+  bool good_ = true;
+};
+
+// Formats the listings of 'banks' on up to 'num_threads' threads and
+//   writes them out in order as soon as all of the ones before
+//   them were, so formatting overlaps with the writing
+//   - At most a couple of listings per thread are kept around
+//     waiting to be written, which bounds the memory used by ROMs
+//     of any size (a listing is ~180KiB)
+static auto write_listings(const RomDisassembler& disasm, const std::vector<unsigned>& banks,
+    unsigned num_threads, BufferedWriter& out) -> void
+{
+  if(!num_threads) num_threads = std::max(std::thread::hardware_concurrency(), 1u);
+  num_threads = std::min<size_t>(num_threads, banks.size());
+
+  const size_t window = num_threads * 2;
+
+  std::vector<std::string> listings(banks.size());
+  std::vector<bool> done(banks.size(), false);
+
+  std::mutex mutex;
+  std::condition_variable formatted, written;
+
+  size_t next_bank = 0, num_written = 0;
+
+  auto worker = [&]() {
+    std::unique_lock<std::mutex> lock(mutex);
+    while(next_bank < banks.size()) {
+      written.wait(lock, [&]() { return next_bank >= banks.size() || next_bank - num_written < window; });
+      if(next_bank >= banks.size()) break;
+
+      auto i = next_bank++;
+
+      lock.unlock();
+
+      auto& listing = listings[i];
+      disasm.listBank(banks[i], listing);
+      listing.push_back('\n');
+
+      lock.lock();
+
+      done[i] = true;
+      formatted.notify_all();
+    }
+  };
+
+  std::vector<std::thread> threads;
+  for(unsigned i = 0; i < num_threads; i++) threads.emplace_back(worker);
+
+  for(size_t i = 0; i < banks.size(); i++) {
+    {
+      std::unique_lock<std::mutex> lock(mutex);
+      formatted.wait(lock, [&]() { return done[i]; });
+    }
+
+    out.write(listings[i]);
+
+    // Release the memory right away
+    std::string().swap(listings[i]);
+
+    {
+      std::lock_guard<std::mutex> lock(mutex);
+      num_written++;
+    }
+    written.notify_all();
+  }
+
+  for(auto& thread : threads) thread.join();
+}
+
+static auto usage(const char *argv0) -> int
+{
+  fprintf(stderr,
+      "usage: %s [-j threads] [-b bank] [-e bank:addr]... [-o file] [-q] rom...\n\n"
+      "Disassembles the ROM by following it's control flow from the entry\n"
+      "point, rst and interrupt vectors (along with the ones given with -e,\n"
+      "ex. the targets of jump tables) and prints a listing of every bank\n"
+      "(or only the one given with -b) with labels and cross-references,\n"
+      "where the bytes which weren't reached as code are listed as data.\n\n"
+      "Given more than one ROM, their listings are written one after\n"
+      "the other, each one preceded by the ROM's name.\n\n"
+      "The banks are analysed and listed on all of the cores by default.\n"
+      "The listing goes to stdout unless -o is given, with -q only the\n"
+      "summary gets printed (to stderr), so -o and -q can't be combined.\n",
+      argv0);
+
+  return -1;
+}
+
+int main(int argc, char *argv[])
+{
+  unsigned num_threads = 0;
+  unsigned only_bank = RomDisassembler::UnknownBank;
+  const char *out_name = nullptr;
+  bool quiet = false;
+
+  struct EntryPoint {
+    unsigned bank;
+    u16 addr;
+  };
+
+  std::vector<EntryPoint> entry_points;
+
+  int opt;
+  while((opt = getopt(argc, argv, "j:b:e:o:qh")) != -1) {
+    switch(opt) {
+    case 'j': num_threads = strtoul(optarg, nullptr, 0); break;
+    case 'b': only_bank = strtoul(optarg, nullptr, 0); break;
+    case 'o': out_name = optarg; break;
+    case 'q': quiet = true; break;
+
+    case 'e': {
+      char *end;
+      unsigned bank = strtoul(optarg, &end, 16);
+      if(*end == ':') {
+        entry_points.push_back({ bank, (u16)strtoul(end+1, nullptr, 16) });
+        break;
+      }
+
+      fprintf(stderr, "entry points are given as <bank>:<addr> in hex (ex. 01:4000)!\n");
+      [[fallthrough]];
+    }
+
+    default: return usage(argv[0]);
+    }
+  }
+
+  if(optind >= argc) return usage(argv[0]);
+
+  if(out_name && quiet) {
+    fprintf(stderr, "-o can't be given with -q, which doesn't write a listing!\n");
+    return usage(argv[0]);
+  }
+
+  int out_fd = STDOUT_FILENO;
+  if(out_name) {
+    out_fd = open(out_name, O_WRONLY|O_CREAT|O_TRUNC, 0644);
+    if(out_fd < 0) {
+      fprintf(stderr, "couldn't open `%s' for writing!\n", out_name);
+      return -1;
+    }
+  }
+
+  BufferedWriter out(out_fd);
+
+  bool many_roms = argc - optind > 1;
+  size_t total_size = 0;
+
+  auto start = std::chrono::steady_clock::now();
+
+  for(int arg = optind; arg < argc; arg++) {
+    const char *rom_name = argv[arg];
+
+    MappedFile rom;
+    if(!rom.open(rom_name)) {
+      fprintf(stderr, "couldn't load ROM `%s'!\n", rom_name);
+      return -1;
+    }
+
+    RomDisassembler disasm(rom.data(), rom.size());
+    if(!disasm.numBanks()) {
+      fprintf(stderr, "`%s' is smaller than a single bank!\n", rom_name);
+      return -1;
+    }
+
+    for(const auto& entry_point : entry_points) {
+      auto base = RomDisassembler::bankBase(entry_point.bank);
+
+      if(entry_point.bank >= disasm.numBanks() || entry_point.addr < base ||
+          (u16)(entry_point.addr - base) >= RomDisassembler::BankSize) {
+        fprintf(stderr, "entry point %.2X:%.4X is outside of `%s'!\n",
+            entry_point.bank, entry_point.addr, rom_name);
+        return -1;
+      }
+
+      disasm.entryPoint(entry_point.bank, entry_point.addr);
+    }
+
+    if(only_bank != RomDisassembler::UnknownBank && only_bank >= disasm.numBanks()) {
+      fprintf(stderr, "`%s' only has %u banks!\n", rom_name, disasm.numBanks());
+      return -1;
+    }
+
+    auto analyze_start = std::chrono::steady_clock::now();
+
+    disasm.analyze(num_threads);
+
+    std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - analyze_start;
+
+    if(!quiet) {
+      std::vector<unsigned> banks;
+      for(unsigned bank = 0; bank < disasm.numBanks(); bank++) {
+        if(only_bank != RomDisassembler::UnknownBank && bank != only_bank) continue;
+
+        banks.push_back(bank);
+      }
+
+      if(many_roms) {
+        std::string header = "; ";
+        header += rom_name;
+        header += "\n\n";
+
+        out.write(header);
+      }
+
+      write_listings(disasm, banks, num_threads, out);
+    }
+
+    size_t num_xrefs = 0;
+    for(unsigned bank = 0; bank < disasm.numBanks(); bank++) num_xrefs += disasm.xrefs(bank).size();
+
+    if(many_roms) fprintf(stderr, "%s: ", rom_name);
+    fprintf(stderr, "%u banks, %zu instructions, %zu cross-references (%zu into an unknown bank) "
+        "analysed in %.1fms\n",
+        disasm.numBanks(), disasm.numInstructions(), num_xrefs, disasm.unresolvedXRefs().size(),
+        elapsed.count() * 1e3);
+
+    total_size += rom.size();
+  }
+
+  out.flush();
+
+  std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+
+  if(!out.good()) {
+    fprintf(stderr, "couldn't write the listing!\n");
+    return -1;
+  }
+
+  if(out_fd != STDOUT_FILENO) close(out_fd);
+
+  if(many_roms || out_name) {
+    fprintf(stderr, "%zuKiB of ROM disassembled in %.1fms (%.1fMiB/s)\n",
+        total_size / 1024, elapsed.count() * 1e3, total_size / elapsed.count() / (1024*1024));
+  }
+
+  return 0;
+}
@@ -0,0 +1,149 @@
+#pragma once
+
+#include <bus/memorymap.h>
+#include <device/sm83/cpu.h>
+
+#include <array>
+#include <optional>
+#include <vector>
+
+#include <cstring>
+
+namespace brgb::tools {
+
+// sm83::Processor connected to a flat 64KiB memory instead
+//   of a SystemBus, so it can be used without the rest
+//   of a system (all accesses take a single memory cycle)
+//  - memory() must only be modified before power() (or
+//    followed by a flushBlocks()) when using Engine::Cached
+class FlatProcessor final : public sm83::Processor {
+public:
+  using Memory = std::array<u8, 64 * 1024>;
+
+  struct BusAccess {
+    u16 addr;
+    u8 data;
+
+    // The memory cycle during which the access happened
+    u64 cycle;
+
+    auto operator==(const BusAccess& other) const -> bool
+    {
+      return addr == other.addr && data == other.data && cycle == other.cycle;
+    }
+  };
+
+  using BusRead  = BusAccess;
+  using BusWrite = BusAccess;
+
+  FlatProcessor()
+  {
+    for(unsigned page = 0; page < 0x100; page++) {
+      mapReadPage(page, memory_.data() + page*0x100);
+      mapWritePage(page, memory_.data() + page*0x100);
+    }
+  }
+
+  virtual auto deviceToken() -> DeviceToken final { return 0; }
+
+  virtual auto attach(SystemBus *, IBusDevice *) -> DeviceMemoryMap* final { return nullptr; }
+  virtual auto detach(DeviceMemoryMap *) -> void final { }
+
+  virtual auto main() -> void final { execute(1); }
+
+  using sm83::Processor::execute;
+  using sm83::Processor::lastPc;
+
+  auto memory() -> Memory& { return memory_; }
+
+  // When not nullptr all bus reads are appended to 'log'
+  //   - Which makes them go through busRead()
+  //  - The Blocks of Engine::Cached and Engine::Jit are predecoded,
+  //    so the instructions' opcode and operand fetches never show up
+  auto logReads(std::vector<BusRead> *log) -> FlatProcessor&
+  {
+    reads_ = log;
+
+    for(unsigned page = 0; page < 0x100; page++) {
+      mapReadPage(page, log ? nullptr : memory_.data() + page*0x100);
+    }
+
+    return *this;
+  }
+
+  // When not nullptr all bus writes are appended to 'log'
+  //   - Which makes them go through busWrite()
+  auto logWrites(std::vector<BusWrite> *log) -> FlatProcessor&
+  {
+    writes_ = log;
+
+    for(unsigned page = 0; page < 0x100; page++) {
+      mapWritePage(page, log ? nullptr : memory_.data() + page*0x100);
+    }
+
+    return *this;
+  }
+
+  // Modifies memory() without spending any cycles, while
+  //   keeping the block cache coherent (unlike memory())
+  auto store(u16 addr, u8 data) -> void
+  {
+    memory_[addr] = data;
+    codeWritten(addr);
+  }
+
+protected:
+  // All of the memory is mapped directly, so these are
+  //   only reached when the accesses are being logged
+  virtual auto busRead(u16 addr) -> u8 final
+  {
+    if(reads_) reads_->push_back({ addr, memory_[addr], cycles() });
+
+    return memory_[addr];
+  }
+
+  virtual auto busWrite(u16 addr, u8 data) -> void final
+  {
+    if(writes_) writes_->push_back({ addr, data, cycles() });
+
+    memory_[addr] = data;
+    codeWritten(addr);
+  }
+
+  // All of the memory is a single bank of RAM
+  virtual auto memoryBank(u16) -> u32 final { return 0; }
+  virtual auto peek(u16 addr) -> u8 final { return memory_[addr]; }
+
+private:
+  Memory memory_ = { };
+
+  std::vector<BusRead> *reads_ = nullptr;
+  std::vector<BusWrite> *writes_ = nullptr;
+};
+
+inline auto engine_name(sm83::Processor::Engine engine) -> const char *
+{
+  using Engine = sm83::Processor::Engine;
+
+  switch(engine) {
+  case Engine::Table:    return "table";
+  case Engine::Threaded: return "threaded";
+  case Engine::Cached:   return "cached";
+  case Engine::Jit:      return "jit";
+  }
+
+  return "<unknown>";
+}
+
+inline auto engine_from_name(const char *name) -> std::optional<sm83::Processor::Engine>
+{
+  using Engine = sm83::Processor::Engine;
+
+  for(auto engine : { Engine::Table, Engine::Threaded, Engine::Cached, Engine::Jit }) {
+    if(!strcmp(name, engine_name(engine))) return engine;
+  }
+
+  return std::nullopt;
+}
+
+}
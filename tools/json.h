@@ -0,0 +1,233 @@
+#pragma once
+
+#include <types.h>
+
+#include <optional>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include <cctype>
+#include <cstdlib>
+
+namespace brgb::tools {
+
+// A parsed JSON value, just enough of one for reading test vectors
+//   - All numbers are kept as doubles
+//   - Object members are kept in the order they appeared in
+struct JsonValue {
+  enum Type : u8 {
+    Null, Bool, Number, String, Array, Object,
+  };
+
+  Type type = Null;
+
+  bool boolean = false;
+  double number = 0.0;
+  std::string string;
+
+  std::vector<JsonValue> array;
+  std::vector<std::pair<std::string, JsonValue>> object;
+
+  // Returns the member called 'name' of an Object,
+  //   or nullptr when it doesn't have one
+  auto member(const char *name) const -> const JsonValue *
+  {
+    for(const auto& [key, value] : object) {
+      if(key == name) return &value;
+    }
+
+    return nullptr;
+  }
+};
+
+// Recursive descent parser of a whole JSON document
+class JsonParser {
+public:
+  JsonParser(const char *begin, const char *end) :
+    p_(begin), begin_(begin), end_(end)
+  { }
+
+  // Returns std::nullopt when the document is malformed, in
+  //   which case offset() is where the parser gave up
+  auto parse() -> std::optional<JsonValue>
+  {
+    JsonValue value;
+    if(!parseValue(value)) return std::nullopt;
+
+    skipWhitespace();
+    if(p_ != end_) return std::nullopt;    // Trailing garbage
+
+    return value;
+  }
+
+  auto offset() const -> size_t { return p_ - begin_; }
+
+private:
+  enum : unsigned {
+    // Deeper documents are rejected, instead of overflowing the stack
+    MaxDepth = 64,
+  };
+
+  auto skipWhitespace() -> void
+  {
+    while(p_ != end_ && (*p_ == ' ' || *p_ == '\t' || *p_ == '\n' || *p_ == '\r')) p_++;
+  }
+
+  // Consumes 'c' (after any whitespace) when it's next
+  auto consume(char c) -> bool
+  {
+    skipWhitespace();
+    if(p_ == end_ || *p_ != c) return false;
+
+    p_++;
+
+    return true;
+  }
+
+  auto literal(const char *word) -> bool
+  {
+    for(; *word; word++, p_++) {
+      if(p_ == end_ || *p_ != *word) return false;
+    }
+
+    return true;
+  }
+
+  auto parseValue(JsonValue& value) -> bool
+  {
+    skipWhitespace();
+    if(p_ == end_) return false;
+
+    switch(*p_) {
+    case '{': return parseObject(value);
+    case '[': return parseArray(value);
+
+    case '"':
+      value.type = JsonValue::String;
+      return parseString(value.string);
+
+    case 't': value.type = JsonValue::Bool; value.boolean = true;  return literal("true");
+    case 'f': value.type = JsonValue::Bool; value.boolean = false; return literal("false");
+    case 'n': value.type = JsonValue::Null; return literal("null");
+    }
+
+    return parseNumber(value);
+  }
+
+  auto parseObject(JsonValue& value) -> bool
+  {
+    if(++depth_ > MaxDepth) return false;
+
+    p_++;    // '{'
+    value.type = JsonValue::Object;
+
+    if(!consume('}')) {
+      do {
+        std::pair<std::string, JsonValue> member;
+
+        skipWhitespace();
+        if(p_ == end_ || *p_ != '"' || !parseString(member.first)) return false;
+        if(!consume(':') || !parseValue(member.second)) return false;
+
+        value.object.push_back(std::move(member));
+      } while(consume(','));
+
+      if(!consume('}')) return false;
+    }
+
+    depth_--;
+
+    return true;
+  }
+
+  auto parseArray(JsonValue& value) -> bool
+  {
+    if(++depth_ > MaxDepth) return false;
+
+    p_++;    // '['
+    value.type = JsonValue::Array;
+
+    if(!consume(']')) {
+      do {
+        JsonValue& element = value.array.emplace_back();
+        if(!parseValue(element)) return false;
+      } while(consume(','));
+
+      if(!consume(']')) return false;
+    }
+
+    depth_--;
+
+    return true;
+  }
+
+  // Escapes of characters outside of ASCII are replaced with '?'
+  auto parseString(std::string& string) -> bool
+  {
+    p_++;    // '"'
+
+    while(p_ != end_ && *p_ != '"') {
+      char c = *p_++;
+      if(c != '\\') {
+        string.push_back(c);
+        continue;
+      }
+
+      if(p_ == end_) return false;
+
+      switch(char escape = *p_++) {
+      case 'b': string.push_back('\b'); break;
+      case 'f': string.push_back('\f'); break;
+      case 'n': string.push_back('\n'); break;
+      case 'r': string.push_back('\r'); break;
+      case 't': string.push_back('\t'); break;
+
+      case 'u': {
+        if(end_ - p_ < 4) return false;
+
+        std::string hex(p_, p_ + 4);
+        char *hex_end;
+        auto code_point = strtoul(hex.data(), &hex_end, 16);
+        if(hex_end != hex.data() + 4) return false;
+
+        string.push_back(code_point < 0x80 ? (char)code_point : '?');
+        p_ += 4;
+        break;
+      }
+
+      default: string.push_back(escape); break;    // '"', '\\' and '/'
+      }
+    }
+
+    if(p_ == end_) return false;
+
+    p_++;    // '"'
+
+    return true;
+  }
+
+  auto parseNumber(JsonValue& value) -> bool
+  {
+    // strtod() needs a NUL-terminated string
+    const char *start = p_;
+    while(p_ != end_ && (isdigit(*p_) || *p_ == '-' || *p_ == '+' || *p_ == '.' || *p_ == 'e' || *p_ == 'E')) {
+      p_++;
+    }
+
+    std::string number(start, p_);
+    if(number.empty()) return false;
+
+    char *number_end;
+    value.type = JsonValue::Number;
+    value.number = strtod(number.data(), &number_end);
+
+    return number_end == number.data() + number.size();
+  }
+
+  const char *p_, *begin_, *end_;
+
+  unsigned depth_ = 0;
+};
+
+}
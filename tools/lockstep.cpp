@@ -0,0 +1,382 @@
+#include "flat.h"
+
+#include <device/sm83/disassembler.h>
+
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+
+#include <random>
+#include <chrono>
+#include <memory>
+#include <optional>
+#include <vector>
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+using namespace brgb;
+using namespace brgb::tools;
+
+using Engine = sm83::Processor::Engine;
+using RunState = sm83::Processor::RunState;
+
+// Default upper bound on the number of instructions passed to a
+//   single execute() call - the actual number is picked at random
+//   so the engines get stopped at all kinds of points
+static constexpr unsigned DefaultMaxSlice = 64;
+
+// Returns the 'until' passed to execute() along with 'slice', which
+//   is also picked at random - so about as many slices end because
+//   of it as because of the number of instructions
+static auto random_until(std::mt19937& rng, const FlatProcessor& p, unsigned slice) -> u64
+{
+  return p.cycles() + rng() % (4*slice);
+}
+
+// An instruction executed by the reference engine, with it's
+//   bytes as they were right before it was executed
+struct Step {
+  u16 pc;
+  u8 code[3];
+};
+
+static auto load_rom(const char *file_name) -> std::optional<std::vector<u8>>
+{
+  auto fd = open(file_name, O_RDONLY);
+  if(fd < 0) return std::nullopt;
+
+  struct stat st;
+  if(fstat(fd, &st) < 0) {
+    close(fd);
+    return std::nullopt;
+  }
+
+  std::vector<u8> rom(st.st_size);
+  if(read(fd, rom.data(), rom.size()) < 0) {
+    close(fd);
+    return std::nullopt;
+  }
+
+  close(fd);
+  return rom;
+}
+
+static auto print_state(const char *name, const sm83::Processor::State& s, u64 cycles) -> void
+{
+  printf("  %-9s af=%04x bc=%04x de=%04x hl=%04x sp=%04x pc=%04x ime=%u ei=%u run=%u cycles=%llu\n",
+      name, s.af, s.bc, s.de, s.hl, s.sp, s.pc, s.ime, s.ei_delay, (unsigned)s.run_state,
+      (unsigned long long)cycles);
+}
+
+// Returns a random (but valid) Processor state
+static auto random_state(std::mt19937& rng) -> sm83::Processor::State
+{
+  sm83::Processor::State s = { };
+
+  s.af = rng() & 0xFFF0;
+  s.bc = rng(); s.de = rng(); s.hl = rng();
+  s.sp = rng(); s.pc = rng();
+
+  s.run_state = RunState::Running;
+
+  return s;
+}
+
+static auto disassemble(const u8 *bytes) -> std::string
+{
+  u8 code[3] = { bytes[0], bytes[1], bytes[2] };
+
+  // Illegal opcodes come out as a 'db'
+  sm83disasm::Instruction instruction(code);
+
+  u8 *ptr = code;
+  instruction.decode(ptr, code + sizeof(code));
+
+  return instruction.toStr();
+}
+
+// Executes (at most) 'slice' instructions one at a time, which ends
+//   up exactly like a single execute(slice, until) call, while recording
+//   each one of them in 'steps' (for the disassembly of a divergence)
+static auto step(FlatProcessor& p, unsigned slice, u64 until, std::vector<Step>& steps) -> unsigned
+{
+  steps.clear();
+
+  sm83::Processor::State start;
+  p.saveState(start);
+
+  // execute() stops right after an instruction which changed
+  //   IME or the RunState, compared to after the 'ei' delay
+  //   got applied (the first thing it does)
+  auto initial = start;
+  if(initial.ei_delay) {
+    initial.ime = 1;
+    initial.ei_delay = 0;
+  }
+
+  unsigned executed = 0;
+  while(executed < slice) {
+    // Only the first instruction gets started past 'until'
+    if(executed && p.cycles() > until) break;
+
+    sm83::Processor::State s;
+    p.saveState(s);
+
+    Step step = { };
+    step.pc = s.pc;
+    for(unsigned i = 0; i < 3; i++) step.code[i] = p.memory()[(u16)(s.pc + i)];
+
+    steps.push_back(step);
+    executed += p.execute(1);
+
+    // Not RunState::Running only spends a single memory cycle
+    if(start.run_state != RunState::Running) break;
+
+    p.saveState(s);
+    if(s.ime != initial.ime || s.ei_delay != initial.ei_delay || s.run_state != initial.run_state) break;
+  }
+
+  return executed;
+}
+
+// Everything needed to run an engine over the same instructions
+//   as in lockstep, captured right before it starts
+struct Setup {
+  FlatProcessor::Memory memory;
+  sm83::Processor::State initial_state;
+
+  std::mt19937 rng;
+};
+
+// Runs 'engine' alone for 'num_instructions' (in the same slices and
+//   restarted the same way as in lockstep) and returns the number
+//   of instructions executed per second
+static auto throughput(Engine engine, const Setup& setup, bool rom, unsigned max_slice,
+    unsigned long long num_instructions) -> double
+{
+  auto rng = setup.rng;
+
+  auto p = std::make_unique<FlatProcessor>();
+
+  p->engine(engine);
+  p->memory() = setup.memory;
+
+  p->power();
+  p->loadState(setup.initial_state);
+
+  auto start = std::chrono::steady_clock::now();
+
+  unsigned long long executed = 0;
+  while(executed < num_instructions) {
+    unsigned slice = 1 + rng() % max_slice;
+    u64 until = random_until(rng, *p, slice);
+
+    executed += p->execute(slice, until);
+
+    if(p->runState() != RunState::Running) {
+      if(rom) break;
+
+      p->loadState(random_state(rng));
+    }
+  }
+
+  std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+
+  return executed / elapsed.count();
+}
+
+static auto usage(const char *argv0) -> int
+{
+  fprintf(stderr,
+      "usage: %s [-n instructions] [-s seed] [-e engine] [-m max slice] [-b] [rom]\n\n"
+      "Runs the table sm83::Processor engine in lockstep with another one\n"
+      "(threaded by default, cached or jit) and compares their registers, cycle\n"
+      "counts and bus writes after every execute() call, which is passed a random\n"
+      "number of instructions up to the max slice (64 by default, 1 compares after\n"
+      "every instruction) and a random number of cycles to stop after. The first\n"
+      "divergence is reported with a disassembly of the instructions leading up\n"
+      "to it. Without a ROM random memory contents are executed.\n\n"
+      "With -b both engines are afterwards also run on their own over the same\n"
+      "instructions, to compare their throughput.\n",
+      argv0);
+
+  return -1;
+}
+
+int main(int argc, char *argv[])
+{
+  unsigned long long num_instructions = 10'000'000;
+  unsigned seed = 1;
+  Engine subject_engine = Engine::Threaded;
+  unsigned max_slice = DefaultMaxSlice;
+  bool benchmark = false;
+
+  int opt;
+  while((opt = getopt(argc, argv, "n:s:e:m:bh")) != -1) {
+    switch(opt) {
+    case 'n': num_instructions = strtoull(optarg, nullptr, 0); break;
+    case 's': seed = strtoul(optarg, nullptr, 0); break;
+    case 'b': benchmark = true; break;
+
+    case 'm':
+      max_slice = strtoul(optarg, nullptr, 0);
+      if(max_slice) break;
+
+      fprintf(stderr, "the max slice must be at least 1!\n");
+      return usage(argv[0]);
+
+    case 'e':
+      if(auto engine = engine_from_name(optarg)) {
+        subject_engine = *engine;
+        break;
+      }
+
+      fprintf(stderr, "unknown engine `%s'!\n", optarg);
+      [[fallthrough]];
+
+    default: return usage(argv[0]);
+    }
+  }
+
+  const char *rom_name = optind < argc ? argv[optind] : nullptr;
+
+  std::mt19937 rng(seed);
+
+  // Allocated on the heap as each one holds the whole 64KiB memory
+  auto reference = std::make_unique<FlatProcessor>();
+  auto subject   = std::make_unique<FlatProcessor>();
+
+  reference->engine(Engine::Table);
+  subject->engine(subject_engine);
+
+  sm83::Processor::State initial_state = { };
+  if(rom_name) {
+    auto rom = load_rom(rom_name);
+    if(!rom) {
+      fprintf(stderr, "couldn't load ROM `%s'!\n", rom_name);
+      return -1;
+    }
+
+    auto size = std::min<size_t>(rom->size(), 0x8000);
+    memcpy(reference->memory().data(), rom->data(), size);
+
+    // Match the state after the boot ROM
+    initial_state.af = 0x01B0; initial_state.bc = 0x0013;
+    initial_state.de = 0x00D8; initial_state.hl = 0x014D;
+    initial_state.sp = 0xFFFE; initial_state.pc = 0x0100;
+  } else {
+    for(auto& b : reference->memory()) b = rng();
+
+    initial_state = random_state(rng);
+  }
+
+  subject->memory() = reference->memory();
+
+  // For the throughput comparison
+  std::unique_ptr<Setup> setup;
+  if(benchmark) setup.reset(new Setup{ reference->memory(), initial_state, rng });
+
+  reference->power(); reference->loadState(initial_state);
+  subject->power();   subject->loadState(initial_state);
+
+  std::vector<FlatProcessor::BusWrite> reference_writes, subject_writes;
+  reference->logWrites(&reference_writes);
+  subject->logWrites(&subject_writes);
+
+  std::vector<Step> steps;
+
+  unsigned long long executed = 0;
+  while(executed < num_instructions) {
+    unsigned slice = 1 + rng() % max_slice;
+    u64 until = random_until(rng, *reference, slice);
+
+    sm83::Processor::State before;
+    reference->saveState(before);
+
+    reference_writes.clear();
+    subject_writes.clear();
+
+    // The reference is stepped one instruction at a time, which
+    //   only records which ones were executed
+    auto reference_executed = step(*reference, slice, until, steps);
+    auto subject_executed   = subject->execute(slice, until);
+
+    sm83::Processor::State a, b;
+    reference->saveState(a);
+    subject->saveState(b);
+
+    bool diverged =
+      reference_executed != subject_executed ||
+      memcmp(&a, &b, sizeof(a)) ||
+      reference->cycles() != subject->cycles() ||
+      reference->lastPc() != subject->lastPc() ||
+      reference_writes != subject_writes;
+
+    if(diverged) {
+      printf("divergence after %llu instructions (slice of %u until cycle %llu starting at pc=%04x):\n",
+          executed, slice, (unsigned long long)until, before.pc);
+
+      printf("  executed: %s=%u %s=%u\n",
+          engine_name(reference->engine()), reference_executed,
+          engine_name(subject->engine()), subject_executed);
+      printf("  last pc:  %s=%04x %s=%04x\n",
+          engine_name(reference->engine()), reference->lastPc(),
+          engine_name(subject->engine()), subject->lastPc());
+
+      printf("  instructions executed by %s:\n", engine_name(reference->engine()));
+      for(const auto& step : steps) {
+        printf("    %04x  %02x %02x %02x  %s\n", step.pc, step.code[0], step.code[1], step.code[2],
+            disassemble(step.code).data());
+      }
+
+      print_state("before", before, 0);
+      print_state(engine_name(reference->engine()), a, reference->cycles());
+      print_state(engine_name(subject->engine()), b, subject->cycles());
+
+      auto num_writes = std::max(reference_writes.size(), subject_writes.size());
+      for(size_t i = 0; i < num_writes; i++) {
+        auto print_write = [&](const std::vector<FlatProcessor::BusWrite>& writes) {
+          if(i >= writes.size()) return (void)printf("%-24s", "-");
+
+          printf("(%04x)=%02x @%-10llu ", writes[i].addr, writes[i].data,
+              (unsigned long long)writes[i].cycle);
+        };
+
+        printf("  write %zu: ", i);
+        print_write(reference_writes);
+        print_write(subject_writes);
+        printf("\n");
+      }
+
+      return 1;
+    }
+
+    executed += reference_executed;
+
+    if(a.run_state != RunState::Running) {
+      // A ROM which halts is done, random code gets restarted
+      //   from a different random state
+      if(rom_name) break;
+
+      auto s = random_state(rng);
+
+      reference->loadState(s);
+      subject->loadState(s);
+    }
+  }
+
+  printf("OK: %llu instructions executed in lockstep (seed=%u)\n", executed, seed);
+
+  if(benchmark) {
+    for(auto engine : { Engine::Table, subject_engine }) {
+      auto ips = throughput(engine, *setup, rom_name, max_slice, executed);
+
+      printf("  %-9s %8.1fM instructions/s\n", engine_name(engine), ips / 1e6);
+    }
+  }
+
+  return 0;
+}
@@ -0,0 +1,96 @@
+#include <system/gb/gb.h>
+#include <device/sm83/profiler.h>
+
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+
+#include <optional>
+#include <vector>
+
+#include <cstdio>
+#include <cstdlib>
+
+using namespace brgb;
+
+static auto load_rom(const char *file_name) -> std::optional<std::vector<u8>>
+{
+  auto fd = open(file_name, O_RDONLY);
+  if(fd < 0) return std::nullopt;
+
+  struct stat st;
+  if(fstat(fd, &st) < 0) {
+    close(fd);
+    return std::nullopt;
+  }
+
+  std::vector<u8> rom(st.st_size);
+  if(read(fd, rom.data(), rom.size()) < 0) {
+    close(fd);
+    return std::nullopt;
+  }
+
+  close(fd);
+  return rom;
+}
+
+static auto usage(const char *argv0) -> int
+{
+  fprintf(stderr,
+      "usage: %s [-f frames] [-w warmup frames] [-n lines] rom\n\n"
+      "Runs the ROM headless for the given number of frames (600 by default)\n"
+      "with an sm83::Profiler attached to the CPU and prints it's report - the\n"
+      "hottest instructions, functions and their call graph.\n",
+      argv0);
+
+  return -1;
+}
+
+int main(int argc, char *argv[])
+{
+  unsigned frames = 600;
+  unsigned warmup_frames = 0;
+  unsigned lines = sm83::Profiler::DefaultReportLines;
+
+  int opt;
+  while((opt = getopt(argc, argv, "f:w:n:h")) != -1) {
+    switch(opt) {
+    case 'f': frames = strtoul(optarg, nullptr, 0); break;
+    case 'w': warmup_frames = strtoul(optarg, nullptr, 0); break;
+    case 'n': lines = strtoul(optarg, nullptr, 0); break;
+
+    default: return usage(argv[0]);
+    }
+  }
+
+  if(optind >= argc) return usage(argv[0]);
+
+  const char *rom_name = argv[optind];
+
+  auto rom = load_rom(rom_name);
+  if(!rom) {
+    fprintf(stderr, "couldn't load ROM `%s'!\n", rom_name);
+    return -1;
+  }
+
+  // Allocated on the heap as it holds all of the system's memory
+  auto gb = std::make_unique<Gameboy>();
+
+  gb->loadCartridge(*rom)
+    .init()
+    .power();
+
+  for(unsigned i = 0; i < warmup_frames; i++) gb->runFrame(false);
+
+  sm83::Profiler profiler;
+  gb->cpuProfiler(&profiler);
+
+  for(unsigned i = 0; i < frames; i++) gb->runFrame(false);
+
+  profiler.report(stdout, gb->cpuCycles(), lines);
+
+  gb->cpuProfiler(nullptr);
+
+  return 0;
+}
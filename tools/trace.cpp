@@ -0,0 +1,205 @@
+#include <system/gb/gb.h>
+#include <device/sm83/trace.h>
+
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+
+#include <deque>
+#include <optional>
+#include <vector>
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+using namespace brgb;
+
+using sm83::TraceRecord;
+
+static auto load_rom(const char *file_name) -> std::optional<std::vector<u8>>
+{
+  auto fd = open(file_name, O_RDONLY);
+  if(fd < 0) return std::nullopt;
+
+  struct stat st;
+  if(fstat(fd, &st) < 0) {
+    close(fd);
+    return std::nullopt;
+  }
+
+  std::vector<u8> rom(st.st_size);
+  if(read(fd, rom.data(), rom.size()) < 0) {
+    close(fd);
+    return std::nullopt;
+  }
+
+  close(fd);
+  return rom;
+}
+
+// Prints the record in a format close to the logs of other
+//   emulators (ex. for diffing them with text tools)
+static auto print_record(FILE *out, const char *prefix, u64 index, const TraceRecord& r) -> void
+{
+  fprintf(out, "%s%-10llu A:%02X F:%02X B:%02X C:%02X D:%02X E:%02X H:%02X L:%02X SP:%04X PC:%04X OP:%02X IME:%u CYC:%llu\n",
+      prefix, (unsigned long long)index,
+      r.af >> 8, r.af & 0xFF, r.bc >> 8, r.bc & 0xFF, r.de >> 8, r.de & 0xFF, r.hl >> 8, r.hl & 0xFF,
+      r.sp, r.pc, r.opcode, r.ime, (unsigned long long)r.cycle);
+}
+
+static auto same_record(const TraceRecord& a, const TraceRecord& b) -> bool
+{
+  return a.cycle == b.cycle && a.pc == b.pc && a.sp == b.sp &&
+    a.af == b.af && a.bc == b.bc && a.de == b.de && a.hl == b.hl &&
+    a.opcode == b.opcode && a.ime == b.ime;
+}
+
+static auto record(const char *rom_name, const char *trace_name, unsigned frames) -> int
+{
+  auto rom = load_rom(rom_name);
+  if(!rom) {
+    fprintf(stderr, "couldn't load ROM `%s'!\n", rom_name);
+    return -1;
+  }
+
+  sm83::TraceWriter writer;
+  if(!writer.open(trace_name)) {
+    fprintf(stderr, "couldn't create `%s'!\n", trace_name);
+    return -1;
+  }
+
+  // Allocated on the heap as it holds all of the system's memory
+  auto gb = std::make_unique<Gameboy>();
+
+  gb->loadCartridge(*rom)
+    .init()
+    .power();
+
+  gb->cpuTracer(&writer);
+  for(unsigned i = 0; i < frames; i++) gb->runFrame(false);
+  gb->cpuTracer(nullptr);
+
+  auto records = writer.records();
+  if(!writer.close()) {
+    fprintf(stderr, "writing `%s' failed!\n", trace_name);
+    return -1;
+  }
+
+  struct stat st;
+  stat(trace_name, &st);
+
+  printf("%llu instructions traced, %.2f bytes per record\n",
+      (unsigned long long)records, records ? (double)st.st_size / records : 0.0);
+
+  return 0;
+}
+
+static auto dump(const char *trace_name) -> int
+{
+  sm83::TraceReader reader;
+  if(!reader.open(trace_name)) {
+    fprintf(stderr, "couldn't open trace `%s'!\n", trace_name);
+    return -1;
+  }
+
+  TraceRecord r;
+  for(u64 index = 0; reader.next(r); index++) print_record(stdout, "", index, r);
+
+  return 0;
+}
+
+static auto diff(const char *a_name, const char *b_name, unsigned context) -> int
+{
+  sm83::TraceReader a, b;
+  if(!a.open(a_name)) {
+    fprintf(stderr, "couldn't open trace `%s'!\n", a_name);
+    return -1;
+  }
+  if(!b.open(b_name)) {
+    fprintf(stderr, "couldn't open trace `%s'!\n", b_name);
+    return -1;
+  }
+
+  // The last 'context' records both traces agreed on
+  std::deque<TraceRecord> history;
+
+  u64 index = 0;
+  while(true) {
+    TraceRecord ra, rb;
+    bool has_a = a.next(ra), has_b = b.next(rb);
+
+    if(!has_a && !has_b) break;
+
+    if(has_a != has_b || !same_record(ra, rb)) {
+      printf("traces diverge at record %llu:\n", (unsigned long long)index);
+
+      auto first = index - history.size();
+      for(const auto& r : history) print_record(stdout, "  ", first++, r);
+
+      if(has_a) print_record(stdout, "- ", index, ra);
+      else      printf("- <end of trace>\n");
+
+      if(has_b) print_record(stdout, "+ ", index, rb);
+      else      printf("+ <end of trace>\n");
+
+      return 1;
+    }
+
+    history.push_back(ra);
+    if(history.size() > context) history.pop_front();
+
+    index++;
+  }
+
+  printf("traces match (%llu records)\n", (unsigned long long)index);
+
+  return 0;
+}
+
+static auto usage(const char *argv0) -> int
+{
+  fprintf(stderr,
+      "usage: %s record [-f frames] rom trace\n"
+      "       %s dump trace\n"
+      "       %s diff [-c context] trace-a trace-b\n\n"
+      "Records a binary trace of every instruction the CPU executes while\n"
+      "running the ROM headless (600 frames by default), prints a trace\n"
+      "as text or finds the first record where two traces diverge.\n",
+      argv0, argv0, argv0);
+
+  return -1;
+}
+
+int main(int argc, char *argv[])
+{
+  if(argc < 2) return usage(argv[0]);
+
+  const char *command = argv[1];
+
+  unsigned frames = 600;
+  unsigned context = 8;
+
+  // Parse the options following the command
+  optind = 2;
+
+  int opt;
+  while((opt = getopt(argc, argv, "f:c:h")) != -1) {
+    switch(opt) {
+    case 'f': frames = strtoul(optarg, nullptr, 0); break;
+    case 'c': context = strtoul(optarg, nullptr, 0); break;
+
+    default: return usage(argv[0]);
+    }
+  }
+
+  int args = argc - optind;
+  char **arg = argv + optind;
+
+  if(!strcmp(command, "record") && args == 2) return record(arg[0], arg[1], frames);
+  if(!strcmp(command, "dump") && args == 1)   return dump(arg[0]);
+  if(!strcmp(command, "diff") && args == 2)   return diff(arg[0], arg[1], context);
+
+  return usage(argv[0]);
+}